@@ -27,8 +27,8 @@
 
 #include <functional>
 #include <array>
-#include <random>
 #include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <glm/detail/func_common.hpp>
 #include <glm/geometric.hpp>
@@ -72,6 +72,10 @@ glm::vec4 dnoise( const glm::vec3 &v );
 typedef std::array<float,5> vec5;
 //! Returns a 4D simplex noise with analytical derivatives
 vec5	dnoise( const glm::vec4 &v );
+//! Returns a 2D simplex noise with analytical derivatives and the second derivatives (xx, xy, yy) in hessian
+glm::vec3 dnoise( const glm::vec2 &v, glm::vec3 &hessian );
+//! Returns a 2D simplex noise with analytical derivatives, the value matches noise( const glm::vec2 &v )
+glm::vec3 noiseDerivatives( const glm::vec2 &v );
 	
 //! Returns a 2D simplex cellular/worley noise
 float worleyNoise( const glm::vec2 &v );
@@ -81,6 +85,8 @@ float worleyNoise( const glm::vec3 &v );
 float worleyNoise( const glm::vec2 &v, float falloff );
 //! Returns a 3D simplex smooth cellular/worley noise
 float worleyNoise( const glm::vec3 &v, float falloff );
+//! Returns a 2D simplex cellular/worley noise with analytical derivatives
+glm::vec3 dWorleyNoise( const glm::vec2 &v );
 
 //! Returns a 2D simplex noise with rotating gradients
 float flowNoise( const glm::vec2 &v, float angle );
@@ -109,6 +115,29 @@ glm::vec3 curlNoise( const glm::vec3 &v, uint8_t octaves, float lacunarity, floa
 glm::vec2 curl( const glm::vec2 &v, const std::function<float(const glm::vec2&)> &potential, float delta = 1e-4f );
 //! Returns the curl of a custom 3D potential using finite difference approximation
 glm::vec3 curl( const glm::vec3 &v, const std::function<glm::vec3(const glm::vec3&)> &potential, float delta = 1e-4f );
+//! Returns the curl of a custom 2D potential using finite difference approximation, potential is any callable
+//! taking a glm::vec2 and returning a float. It is called directly, so it can be inlined
+template<typename Potential>
+glm::vec2 curl( const glm::vec2 &v, const Potential &potential, float delta = 1e-4f );
+//! Returns the curl of a custom 3D potential using finite difference approximation, potential is any callable
+//! taking a glm::vec3 and returning a glm::vec3. Each of the six taps is evaluated once
+template<typename Potential>
+glm::vec3 curl( const glm::vec3 &v, const Potential &potential, float delta = 1e-4f );
+//! Writes the curl of a custom 2D potential at count positions to out
+template<typename Potential>
+void curl( const glm::vec2 *v, size_t count, glm::vec2 *out, const Potential &potential, float delta = 1e-4f );
+//! Writes the curl of a custom 3D potential at count positions to out
+template<typename Potential>
+void curl( const glm::vec3 *v, size_t count, glm::vec3 *out, const Potential &potential, float delta = 1e-4f );
+
+//! Writes the curl of a 2D simplex noise at count positions to out
+void curlNoise( const glm::vec2 *v, size_t count, glm::vec2 *out );
+//! Writes the curl of a 2D simplex noise fractal brownian motion sum at count positions to out
+void curlNoise( const glm::vec2 *v, size_t count, glm::vec2 *out, uint8_t octaves, float lacunarity, float gain );
+//! Writes the curl of a 3D simplex noise at count positions to out
+void curlNoise( const glm::vec3 *v, size_t count, glm::vec3 *out );
+//! Writes the curl approximation of a 3D simplex noise fractal brownian motion sum at count positions to out
+void curlNoise( const glm::vec3 *v, size_t count, glm::vec3 *out, uint8_t octaves, float lacunarity, float gain );
 
 //! Returns a 1D simplex noise fractal brownian motion sum
 float fBm( float x, uint8_t octaves = 4, float lacunarity = 2.0f, float gain = 0.5f );
@@ -154,7 +183,7 @@ float iqfBm( const glm::vec3 &v, uint8_t octaves = 4, float lacunarity = 2.0f, f
 //! Returns the 2D simplex noise fractal brownian motion sum variation by Iñigo Quilez that use a mat2 to transform each octave
 float iqMatfBm( const glm::vec2 &v, uint8_t octaves = 4, const glm::mat2 &mat = glm::mat2( 1.6, -1.2, 1.2, 1.6 ), float gain = 0.5f );
 
-//! Seeds the permutation table with new random values
+//! Seeds the permutation table of the calling thread, the same table for a seed on every platform
 void seed( uint32_t s );
 	
 // implementation
@@ -178,6 +207,8 @@ namespace details {
 	 * This array is accessed a *lot* by the noise functions.
 	 * A vector-valued noise over 3D accesses it 96 times, and a
 	 * float-valued 4D noise 64 times. We want this to fit in the cache!
+	 *
+	 * Each thread has its own copy, so threads can run with different seeds.
 	 */
 #ifdef SIMPLEX_INTEGER_LUTS
 	typedef uint8_t LutType;
@@ -185,7 +216,7 @@ namespace details {
 	typedef unsigned char LutType;
 #endif
 	
-	static LutType perm[512] = {151,160,137,91,90,15,
+	static thread_local LutType perm[512] = {151,160,137,91,90,15,
 		131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,21,10,23,
 		190, 6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,
 		88,237,149,56,87,174,20,125,136,171,168, 68,175,74,165,71,134,139,48,27,166,
@@ -1824,23 +1855,71 @@ glm::vec3 curlNoise( const glm::vec3 &v, uint8_t octaves, float lacunarity, floa
 }
 
 glm::vec2 curl( const glm::vec2 &v, const std::function<float(const glm::vec2&)> &potential, float delta )
+{
+	return curl<std::function<float(const glm::vec2&)>>( v, potential, delta );
+}
+glm::vec3 curl( const glm::vec3 &v, const std::function<glm::vec3(const glm::vec3&)> &potential, float delta )
+{
+	return curl<std::function<glm::vec3(const glm::vec3&)>>( v, potential, delta );
+}
+
+template<typename Potential>
+glm::vec2 curl( const glm::vec2 &v, const Potential &potential, float delta )
 {
 	const glm::vec2 deltaX = glm::vec2( delta, 0.0f );
 	const glm::vec2 deltaY = glm::vec2( 0.0f, delta );
 	return glm::vec2( -( potential( v + deltaY ) - potential( v - deltaY ) ),
 					 ( potential( v + deltaX ) - potential( v - deltaX ) ) ) / ( 2.0f * delta );
 }
-glm::vec3 curl( const glm::vec3 &v, const std::function<glm::vec3(const glm::vec3&)> &potential, float delta )
+template<typename Potential>
+glm::vec3 curl( const glm::vec3 &v, const Potential &potential, float delta )
 {
 	const glm::vec3 deltaX = glm::vec3( delta, 0.0f, 0.0f );
 	const glm::vec3 deltaY = glm::vec3( 0.0f, delta, 0.0f );
 	const glm::vec3 deltaZ = glm::vec3( 0.0f, 0.0f, delta );
-	return glm::vec3( ( ( potential( v + deltaY ).z - potential( v - deltaY ).z )
-					   -( potential( v + deltaZ ).y - potential( v - deltaZ ).y ) ),
-					 ( ( potential( v + deltaZ ).x - potential( v - deltaZ ).x )
-					  -( potential( v + deltaX ).z - potential( v - deltaX ).z ) ),
-					 ( ( potential( v + deltaX ).y - potential( v - deltaX ).y )
-					  -( potential( v + deltaY ).x - potential( v - deltaY ).x ) ) ) / ( 2.0f * delta );
+	// Every tap feeds two components
+	const glm::vec3 px = potential( v + deltaX );
+	const glm::vec3 nx = potential( v - deltaX );
+	const glm::vec3 py = potential( v + deltaY );
+	const glm::vec3 ny = potential( v - deltaY );
+	const glm::vec3 pz = potential( v + deltaZ );
+	const glm::vec3 nz = potential( v - deltaZ );
+	return glm::vec3( ( ( py.z - ny.z ) - ( pz.y - nz.y ) ),
+					 ( ( pz.x - nz.x ) - ( px.z - nx.z ) ),
+					 ( ( px.y - nx.y ) - ( py.x - ny.x ) ) ) / ( 2.0f * delta );
+}
+template<typename Potential>
+void curl( const glm::vec2 *v, size_t count, glm::vec2 *out, const Potential &potential, float delta )
+{
+	for( size_t i = 0; i < count; i++ )
+		out[i] = curl( v[i], potential, delta );
+}
+template<typename Potential>
+void curl( const glm::vec3 *v, size_t count, glm::vec3 *out, const Potential &potential, float delta )
+{
+	for( size_t i = 0; i < count; i++ )
+		out[i] = curl( v[i], potential, delta );
+}
+
+void curlNoise( const glm::vec2 *v, size_t count, glm::vec2 *out )
+{
+	for( size_t i = 0; i < count; i++ )
+		out[i] = curlNoise( v[i] );
+}
+void curlNoise( const glm::vec2 *v, size_t count, glm::vec2 *out, uint8_t octaves, float lacunarity, float gain )
+{
+	for( size_t i = 0; i < count; i++ )
+		out[i] = curlNoise( v[i], octaves, lacunarity, gain );
+}
+void curlNoise( const glm::vec3 *v, size_t count, glm::vec3 *out )
+{
+	for( size_t i = 0; i < count; i++ )
+		out[i] = curlNoise( v[i] );
+}
+void curlNoise( const glm::vec3 *v, size_t count, glm::vec3 *out, uint8_t octaves, float lacunarity, float gain )
+{
+	for( size_t i = 0; i < count; i++ )
+		out[i] = curlNoise( v[i], octaves, lacunarity, gain );
 }
 
 namespace details {
@@ -2139,14 +2218,158 @@ float iqMatfBmEx(const glm::vec2 &v, uint8_t octaves, const glm::mat2 &mat, floa
     return sum;
 }
 
+glm::vec3 dnoise( const glm::vec2 &v, glm::vec3 &hessian )
+{
+	const glm::vec3 n = dnoise( v );
+
+	// Same simplex corners as dnoise( const glm::vec2 &v )
+	float s = (v.x+v.y)*F2;
+	float xs = v.x + s;
+	float ys = v.y + s;
+	int i = FASTFLOOR(xs);
+	int j = FASTFLOOR(ys);
+	float t = (float)(i+j)*G2;
+	float x0 = v.x-(i-t);
+	float y0 = v.y-(j-t);
+	int i1, j1;
+	if(x0>y0) {i1=1; j1=0;}
+	else {i1=0; j1=1;}
+	int ii = i & 0xff;
+	int jj = j & 0xff;
+
+	float x1 = x0 - i1 + G2;
+	float y1 = y0 - j1 + G2;
+	float x2 = x0 - 1.0f + 2.0f * G2;
+	float y2 = y0 - 1.0f + 2.0f * G2;
+
+	const float cx[3] = { x0, x1, x2 };
+	const float cy[3] = { y0, y1, y2 };
+	const int hash[3] = { details::perm[ii + details::perm[jj]],
+						  details::perm[ii + i1 + details::perm[jj + j1]],
+						  details::perm[ii + 1 + details::perm[jj + 1]] };
+
+	/* d2/dxi dxj of t^4 * (g.p), t = 0.5 - p.p:
+	 * 48 t^2 xi xj (g.p) - 8 t^3 dij (g.p) - 8 t^3 (xi gj + xj gi) */
+	float hxx = 0.0f, hxy = 0.0f, hyy = 0.0f;
+	for( int c = 0; c < 3; c++ ) {
+		const float tc = 0.5f - cx[c] * cx[c] - cy[c] * cy[c];
+		if( tc < 0.0f ) continue;
+		float gx, gy;
+		details::grad2( hash[c], &gx, &gy );
+		const float gp = gx * cx[c] + gy * cy[c];
+		const float t2 = tc * tc;
+		const float t3 = t2 * tc;
+		hxx += 48.0f * t2 * cx[c] * cx[c] * gp - 8.0f * t3 * gp - 16.0f * t3 * cx[c] * gx;
+		hxy += 48.0f * t2 * cx[c] * cy[c] * gp - 8.0f * t3 * ( cx[c] * gy + cy[c] * gx );
+		hyy += 48.0f * t2 * cy[c] * cy[c] * gp - 8.0f * t3 * gp - 16.0f * t3 * cy[c] * gy;
+	}
+	hessian = glm::vec3( hxx, hxy, hyy ) * 40.0f; /* Scale to match the derivative scaling */
+	return n;
+}
+
+glm::vec3 noiseDerivatives( const glm::vec2 &v )
+{
+	// Same operations as noise( const glm::vec2 &v ) for the value
+	float s = (v.x+v.y)*F2;
+	float xs = v.x + s;
+	float ys = v.y + s;
+	int i = FASTFLOOR(xs);
+	int j = FASTFLOOR(ys);
+	
+	float t = (float)(i+j)*G2;
+	float X0 = i-t;
+	float Y0 = j-t;
+	float x0 = v.x-X0;
+	float y0 = v.y-Y0;
+	
+	int i1, j1;
+	if(x0>y0) {i1=1; j1=0;}
+	else {i1=0; j1=1;}
+	
+	float x1 = x0 - i1 + G2;
+	float y1 = y0 - j1 + G2;
+	float x2 = x0 - 1.0f + 2.0f * G2;
+	float y2 = y0 - 1.0f + 2.0f * G2;
+	
+	int ii = i & 0xff;
+	int jj = j & 0xff;
+	
+	const float cx[3] = { x0, x1, x2 };
+	const float cy[3] = { y0, y1, y2 };
+	const int hash[3] = { details::perm[ii+details::perm[jj]],
+						  details::perm[ii+i1+details::perm[jj+j1]],
+						  details::perm[ii+1+details::perm[jj+1]] };
+	float n[3];
+	float dx = 0.0f, dy = 0.0f;
+	for( int c = 0; c < 3; c++ ) {
+		float tc = 0.5f - cx[c]*cx[c]-cy[c]*cy[c];
+		if(tc < 0.0f) n[c] = 0.0f;
+		else {
+			// Gradient used by grad( int hash, float x, float y )
+			const int h = hash[c] & 7;
+			const float gu = (h&1) ? -1.0f : 1.0f;
+			const float gv = (h&2) ? -2.0f : 2.0f;
+			const float gx = h<4 ? gu : gv;
+			const float gy = h<4 ? gv : gu;
+			const float gp = details::grad(hash[c], cx[c], cy[c]);
+			const float t3 = tc * tc * tc;
+			dx += -8.0f * t3 * cx[c] * gp + t3 * tc * gx;
+			dy += -8.0f * t3 * cy[c] * gp + t3 * tc * gy;
+			tc *= tc;
+			n[c] = tc * tc * gp;
+		}
+	}
+	return glm::vec3( 40.0f * (n[0] + n[1] + n[2]), 40.0f * dx, 40.0f * dy );
+}
+
+glm::vec3 dWorleyNoise( const glm::vec2 &v )
+{
+	glm::vec2 p = glm::floor( v );
+	glm::vec2 f = glm::fract( v );
+	
+	// Same search as worleyNoise( const glm::vec2 &v ), the feature point is constant within the cell
+	float res = 8.0;
+	glm::vec2 nearest = glm::vec2( 0.0f );
+	for( int j=-1; j<=1; j++ ) {
+		for( int i=-1; i<=1; i++ ) {
+			glm::vec2 b = glm::vec2( i, j );
+			glm::vec2  r = b - f + ( Simplex::noise( p + b ) * 0.5f + 0.5f );
+			float d = glm::dot( r, r );
+			if( d < res ) {
+				res = d;
+				nearest = r;
+			}
+		}
+	}
+	const float dist = sqrt( res );
+	if( dist <= 0.0f )
+		return glm::vec3( dist, 0.0f, 0.0f );
+	return glm::vec3( dist, -nearest.x / dist, -nearest.y / dist );
+}
+
 
 void seed( uint32_t s ) {
-    std::random_device rd;
-    std::mt19937 gen( rd() );
-    gen.seed( s );
-    std::uniform_int_distribution<> distribution( 1, 255 );
-    for( size_t i = 0; i < 256; ++i ) {
-        details::perm[i] = details::perm[i + 256] = distribution( gen );
+    // Fisher-Yates shuffle of 0 - 255 driven by SplitMix64. Every step is specified here instead of
+    // left to the standard library, so a seed gives the same table with every compiler and platform
+    uint64_t state = s;
+    uint8_t table[256];
+    for( int i = 0; i < 256; ++i ) {
+        table[i] = uint8_t( i );
+    }
+    for( int i = 255; i > 0; --i ) {
+        state += 0x9e3779b97f4a7c15ULL;
+        uint64_t z = state;
+        z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+        z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+        z ^= z >> 31;
+        // Multiply-shift of the high 32 bits onto 0 - i
+        const int j = int( ( ( z >> 32 ) * uint64_t( i + 1 ) ) >> 32 );
+        const uint8_t swapped = table[i];
+        table[i] = table[j];
+        table[j] = swapped;
+    }
+    for( int i = 0; i < 256; ++i ) {
+        details::perm[i] = details::perm[i + 256] = table[i];
     }
 }
 	
@@ -0,0 +1,259 @@
+/****************************************************************
+* Name:       heightblock.cpp
+* Purpose:    BC4 / BC5 block compression of heights and normals
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heightblock.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+
+// Least squares refits of the end points after the min / max fit
+static const int BLOCK_REFITS = 2;
+
+// Runs part(first, end) for count items split into bands, one band per thread
+template<typename Part>
+static void ForBands(const int count, const int threads, const Part &part)
+{
+	if (threads == 1) {
+		part(0, count);
+		return;
+	}
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t) {
+		const int first = count * t / threads;
+		const int end = count * (t + 1) / threads;
+		workers.push_back(std::thread([&part, first, end]() { part(first, end); }));
+	}
+	for (auto & worker : workers)
+		worker.join();
+}
+
+static inline int Blocks(const int resolution)
+{
+	return (resolution + 3) / 4;
+}
+
+static inline float ClampEndPoint(const float n)
+{
+	return std::min(std::max(std::floor(n + 0.5f), 0.0f), 255.0f);
+}
+
+// Steps of the texels from r0 (0) to r1 (7) of the 8 value palette, r0 > r1, and the squared error
+static inline float FitSteps(const float *texels, const float r0, const float r1, float *steps)
+{
+	const float scale = 7.0f / (r0 - r1);
+	float error = 0.0f;
+	for (int k = 0; k < 16; ++k) {
+		const float step = std::min(std::max(std::floor((r0 - texels[k]) * scale + 0.5f), 0.0f), 7.0f);
+		const float decoded = r0 + (r1 - r0) * step * (1.0f / 7.0f);
+		steps[k] = step;
+		error += (decoded - texels[k]) * (decoded - texels[k]);
+	}
+	return error;
+}
+
+// Palette indices of the 6 value palette, r0 <= r1, with 0 and 255 as indices 6 and 7, and the squared
+// error. Fits blocks on the coast, the sea is exactly 0
+static inline float FitIndices6(const float *texels, const float r0, const float r1, int *indices)
+{
+	const float scale = r1 > r0 ? 5.0f / (r1 - r0) : 0.0f;
+	float error = 0.0f;
+	for (int k = 0; k < 16; ++k) {
+		const float step = std::min(std::max(std::floor((texels[k] - r0) * scale + 0.5f), 0.0f), 5.0f);
+		const float decoded = r0 + (r1 - r0) * step * (1.0f / 5.0f);
+		const float ramp = (decoded - texels[k]) * (decoded - texels[k]);
+		const float zero = texels[k] * texels[k];
+		const float full = (255.0f - texels[k]) * (255.0f - texels[k]);
+		const int index = step == 0.0f ? 0 : (step == 5.0f ? 1 : (int)step + 1);
+		indices[k] = zero < ramp && zero <= full ? 6 : (full < ramp ? 7 : index);
+		error += std::min(ramp, std::min(zero, full));
+	}
+	return error;
+}
+
+size_t HeightBlockCompression::BC4Bytes(const int resolution)
+{
+	return size_t(Blocks(resolution)) * size_t(Blocks(resolution)) * 8;
+}
+
+size_t HeightBlockCompression::BC5Bytes(const int resolution)
+{
+	return size_t(Blocks(resolution)) * size_t(Blocks(resolution)) * 16;
+}
+
+void HeightBlockCompression::EncodeBC4Block(const float *texels, unsigned char *block)
+{
+	float lo = texels[0], hi = texels[0];
+	for (int k = 1; k < 16; ++k) {
+		lo = std::min(lo, texels[k]);
+		hi = std::max(hi, texels[k]);
+	}
+	float r0 = ClampEndPoint(hi), r1 = ClampEndPoint(lo);
+	memset(block, 0, 8);
+	block[0] = (unsigned char)r0;
+	block[1] = (unsigned char)r1;
+	// Flat block, every index 0 is r0
+	if (r0 <= r1)
+		return;
+
+	float steps[16], best[16];
+	float bestError = FitSteps(texels, r0, r1, best);
+	float bestR0 = r0, bestR1 = r1;
+	for (int refit = 0; refit < BLOCK_REFITS && bestError > 0.0f; ++refit) {
+		// Texel = r0 * (1 - w) + r1 * w, normal equations of the two end points
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f, av = 0.0f, bv = 0.0f;
+		for (int k = 0; k < 16; ++k) {
+			const float w = best[k] * (1.0f / 7.0f);
+			aa += (1.0f - w) * (1.0f - w);
+			ab += (1.0f - w) * w;
+			bb += w * w;
+			av += (1.0f - w) * texels[k];
+			bv += w * texels[k];
+		}
+		const float determinant = aa * bb - ab * ab;
+		if (std::fabs(determinant) < 1e-6f)
+			break;
+		r0 = ClampEndPoint((av * bb - bv * ab) / determinant);
+		r1 = ClampEndPoint((bv * aa - av * ab) / determinant);
+		if (r0 <= r1)
+			break;
+		const float error = FitSteps(texels, r0, r1, steps);
+		if (error >= bestError)
+			break;
+		bestError = error;
+		bestR0 = r0;
+		bestR1 = r1;
+		memcpy(best, steps, sizeof(best));
+	}
+
+	// Blocks touching 0 or 255 may fit better with the 6 value palette over the texels between
+	int indices[16];
+	bool sixValues = false;
+	if (lo < 0.5f || hi > 254.5f) {
+		float innerLo = 255.0f, innerHi = 0.0f;
+		for (int k = 0; k < 16; ++k) {
+			const bool inner = texels[k] >= 0.5f && texels[k] <= 254.5f;
+			innerLo = inner ? std::min(innerLo, texels[k]) : innerLo;
+			innerHi = inner ? std::max(innerHi, texels[k]) : innerHi;
+		}
+		if (innerLo <= innerHi) {
+			const float s0 = ClampEndPoint(innerLo), s1 = ClampEndPoint(innerHi);
+			if (FitIndices6(texels, s0, s1, indices) < bestError) {
+				sixValues = true;
+				bestR0 = s0;
+				bestR1 = s1;
+			}
+		}
+	}
+	if (!sixValues) {
+		// Palette index of a step: r0, r1, then the six values between from r0 on
+		for (int k = 0; k < 16; ++k) {
+			const int step = (int)best[k];
+			indices[k] = step == 0 ? 0 : (step == 7 ? 1 : step + 1);
+		}
+	}
+
+	block[0] = (unsigned char)bestR0;
+	block[1] = (unsigned char)bestR1;
+	unsigned long long bits = 0;
+	for (int k = 0; k < 16; ++k)
+		bits |= (unsigned long long)indices[k] << (3 * k);
+	for (int b = 0; b < 6; ++b)
+		block[2 + b] = (unsigned char)(bits >> (8 * b));
+}
+
+void HeightBlockCompression::DecodeBC4Block(const unsigned char *block, unsigned char *texels)
+{
+	const int r0 = block[0], r1 = block[1];
+	int palette[8] = { r0, r1, 0, 0, 0, 0, 0, 255 };
+	if (r0 > r1) {
+		for (int i = 2; i < 8; ++i)
+			palette[i] = ((8 - i) * r0 + (i - 1) * r1 + 3) / 7;
+	}
+	else {
+		for (int i = 2; i < 6; ++i)
+			palette[i] = ((6 - i) * r0 + (i - 1) * r1 + 2) / 5;
+	}
+	unsigned long long bits = 0;
+	for (int b = 0; b < 6; ++b)
+		bits |= (unsigned long long)block[2 + b] << (8 * b);
+	for (int k = 0; k < 16; ++k)
+		texels[k] = (unsigned char)palette[(bits >> (3 * k)) & 7];
+}
+
+bool HeightBlockCompression::EncodeBC4(const void *samples, const HeightGenerator::SampleFormat format,
+									   const int resolution, unsigned char *out, const int threadCount)
+{
+	if (!samples || !out || resolution < 1 || !HeightGenerator::SampleFormatBytes(format))
+		return false;
+
+	const int blocks = Blocks(resolution);
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, blocks));
+	ForBands(blocks, threads, [&](const int first, const int end) {
+		// Four rows of texels, the last row and column repeat past the map
+		const int width = blocks * 4;
+		std::vector<float> rows(size_t(width) * 4);
+		float texels[16];
+		for (int by = first; by < end; ++by) {
+			for (int r = 0; r < 4; ++r) {
+				const size_t row = size_t(std::min(by * 4 + r, resolution - 1)) * size_t(resolution);
+				float *texelRow = &rows[size_t(r) * width];
+				for (int x = 0; x < width; ++x)
+					texelRow[x] = HeightGenerator::SampleHeight(format, samples, row + size_t(std::min(x, resolution - 1))) * 255.0f;
+			}
+			unsigned char *block = out + size_t(by) * size_t(blocks) * 8;
+			for (int bx = 0; bx < blocks; ++bx, block += 8) {
+				for (int r = 0; r < 4; ++r)
+					memcpy(&texels[r * 4], &rows[size_t(r) * width + size_t(bx) * 4], 4 * sizeof(float));
+				EncodeBC4Block(texels, block);
+			}
+		}
+	});
+	return true;
+}
+
+bool HeightBlockCompression::EncodeBC5(const unsigned char *pairs, const bool sixteenBit, const int resolution,
+									   unsigned char *out, const int threadCount)
+{
+	if (!pairs || !out || resolution < 1)
+		return false;
+
+	const int blocks = Blocks(resolution);
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, blocks));
+	ForBands(blocks, threads, [&](const int first, const int end) {
+		float texels[2][16];
+		for (int by = first; by < end; ++by) {
+			unsigned char *block = out + size_t(by) * size_t(blocks) * 16;
+			for (int bx = 0; bx < blocks; ++bx, block += 16) {
+				for (int k = 0; k < 16; ++k) {
+					const size_t pixel = size_t(std::min(bx * 4 + (k & 3), resolution - 1)) +
+										 size_t(std::min(by * 4 + (k >> 2), resolution - 1)) * size_t(resolution);
+					for (int c = 0; c < 2; ++c) {
+						if (sixteenBit) {
+							unsigned short value;
+							memcpy(&value, pairs + pixel * 4 + c * 2, sizeof(value));
+							texels[c][k] = float(value) * (255.0f / 65535.0f);
+						}
+						else {
+							texels[c][k] = float(pairs[pixel * 2 + c]);
+						}
+					}
+				}
+				EncodeBC4Block(texels[0], block);
+				EncodeBC4Block(texels[1], block + 8);
+			}
+		}
+	});
+	return true;
+}
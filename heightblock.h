@@ -0,0 +1,42 @@
+/****************************************************************
+* Name:       heightblock.h
+* Purpose:    BC4 / BC5 block compression of heights and normals
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_BLOCK_H
+#define HEIGHT_BLOCK_H
+
+#include "heightgenerator.h"
+
+// GPU block compressed textures without a texture tool pass. BC4 stores one channel in 8 bytes per
+// 4 x 4 texels (heights, 1/2 of 8 bit and 1/4 of 16 bit samples), BC5 two channels in 16 bytes (the
+// normal output, 1/2 and 1/4). Blocks are row major, blocks past the map edge repeat its last texels.
+//
+// A block takes its range as end points, picks every texel index arithmetically and refits the end
+// points by least squares, keeping the fit with the lower squared error. The per texel loops are
+// branch free over the 16 texels of a block. Rows of blocks run on separate threads
+class HeightBlockCompression
+{
+public:
+	// Bytes of a map compressed to BC4 / BC5
+	static size_t BC4Bytes(const int resolution);
+	static size_t BC5Bytes(const int resolution);
+
+	// Samples in any format to BC4, out holds BC4Bytes(resolution). threadCount 0 uses every hardware thread
+	static bool EncodeBC4(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+						  unsigned char *out, const int threadCount = 0);
+	// Pairs of 8 or 16 bit values per texel (the normal output) to BC5, out holds BC5Bytes(resolution)
+	static bool EncodeBC5(const unsigned char *pairs, const bool sixteenBit, const int resolution,
+						  unsigned char *out, const int threadCount = 0);
+
+	// One block, 16 row major texels in 0 - 255
+	static void EncodeBC4Block(const float *texels, unsigned char *block);
+	static void DecodeBC4Block(const unsigned char *block, unsigned char *texels);
+};
+
+#endif
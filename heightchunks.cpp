@@ -0,0 +1,237 @@
+/****************************************************************
+* Name:       heightchunks.cpp
+* Purpose:    Per chunk LOD meshes with skirts for streaming
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heightchunks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+
+static const unsigned char HEIGHT_CHUNK_FILE_VERSION = 1;
+static const char HEIGHT_CHUNK_FILE_MAGIC[3] = { 'H','C','F' };
+
+// Version and magic, chunk x, y, lod count
+static const size_t CHUNK_HEADER_BYTES = 16;
+// Max error, vertex count, index count, first skirt index, data offset
+static const size_t CHUNK_LOD_BYTES = 20;
+
+typedef struct chunk_lod_t {
+	float maxError;
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int skirtFirstIndex;
+	unsigned int offset;
+}chunk_lod_t;
+
+typedef struct edge_t {
+	unsigned int lo, hi;
+	// Start and end in the winding of the triangle
+	unsigned int from, to;
+	inline bool operator<(const edge_t &other) const {
+		return lo != other.lo ? lo < other.lo : hi < other.hi;
+	}
+}edge_t;
+
+// Appends a skirt to the mesh: a lowered copy of each border vertex and two triangles per border edge.
+// Border edges belong to a single triangle
+static void AddSkirt(HeightMesh::mesh_t &mesh, const float depth)
+{
+	const size_t triangles = mesh.triangleCount();
+	std::vector<edge_t> edges;
+	edges.reserve(triangles * 3);
+	for (size_t t = 0; t < triangles; ++t) {
+		const unsigned int *v = &mesh.indices[t * 3];
+		for (int k = 0; k < 3; ++k) {
+			edge_t edge;
+			edge.from = v[k];
+			edge.to = v[(k + 1) % 3];
+			edge.lo = std::min(edge.from, edge.to);
+			edge.hi = std::max(edge.from, edge.to);
+			edges.push_back(edge);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	std::vector<int> lowered(mesh.vertexCount(), -1);
+	auto lower = [&](const unsigned int v) {
+		if (lowered[v] < 0) {
+			lowered[v] = int(mesh.vertexCount());
+			mesh.positions.push_back(mesh.positions[v * 3]);
+			mesh.positions.push_back(mesh.positions[v * 3 + 1]);
+			mesh.positions.push_back(mesh.positions[v * 3 + 2] - depth);
+		}
+		return unsigned(lowered[v]);
+	};
+	for (size_t e = 0; e < edges.size(); ) {
+		size_t same = e + 1;
+		while (same < edges.size() && edges[same].lo == edges[e].lo && edges[same].hi == edges[e].hi)
+			++same;
+		if (same == e + 1) {
+			// Triangles are counter clockwise, the outside is right of from -> to
+			const unsigned int p = edges[e].from, q = edges[e].to;
+			const unsigned int pl = lower(p), ql = lower(q);
+			mesh.indices.push_back(p);
+			mesh.indices.push_back(ql);
+			mesh.indices.push_back(q);
+			mesh.indices.push_back(p);
+			mesh.indices.push_back(pl);
+			mesh.indices.push_back(ql);
+		}
+		e = same;
+	}
+}
+
+HeightChunks::HeightChunks() : m_chunksPerSide(0)
+{
+}
+
+bool HeightChunks::build(HeightGenerator &generator, const chunk_param_t &params, const int threadCount)
+{
+	return build(generator.generatedSamples(), generator.generatedSampleFormat(), generator.generatedParam().resolution,
+				 params, threadCount);
+}
+
+bool HeightChunks::build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+						 const chunk_param_t &params, const int threadCount)
+{
+	clear();
+	const int size = params.chunkSize;
+	if (!samples || resolution < 2 || !HeightGenerator::SampleFormatBytes(format) || size < 1 || size > 128 ||
+		(size & (size - 1)) || params.lodCount < 1 || params.lodCount > 32)
+		return false;
+
+	m_params = params;
+	const int perSide = (resolution - 1 + size - 1) / size;
+	const int chunks = perSide * perSide;
+	m_blobs.resize(size_t(chunks));
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, chunks));
+
+	// Threads take the next chunk
+	std::atomic<int> next(0);
+	auto bake = [&]() {
+		HeightMesh mesh;
+		for (int c = next++; c < chunks; c = next++) {
+			const int x = c % perSide, y = c / perSide;
+			mesh.build(samples, format, resolution, x * size, y * size, size, 1);
+			bakeChunk(mesh, x, y, m_blobs[size_t(c)]);
+		}
+	};
+	std::vector<std::thread> pool;
+	for (int t = 1; t < threads; ++t)
+		pool.push_back(std::thread(bake));
+	bake();
+	for (auto & worker : pool)
+		worker.join();
+
+	m_chunksPerSide = perSide;
+	return true;
+}
+
+void HeightChunks::clear()
+{
+	m_blobs.clear();
+	m_chunksPerSide = 0;
+}
+
+void HeightChunks::bakeChunk(const HeightMesh &mesh, const int x, const int y, std::vector<unsigned char> &blob) const
+{
+	const int lodCount = m_params.lodCount;
+	std::vector<HeightMesh::mesh_t> meshes(lodCount);
+	std::vector<chunk_lod_t> lods(lodCount);
+	size_t bytes = CHUNK_HEADER_BYTES + CHUNK_LOD_BYTES * size_t(lodCount);
+	for (int lod = 0; lod < lodCount; ++lod) {
+		chunk_lod_t &entry = lods[lod];
+		entry.maxError = m_params.baseError * std::pow(m_params.errorGrowth, float(lod));
+		mesh.extract(entry.maxError, meshes[lod]);
+		entry.skirtFirstIndex = (unsigned int)meshes[lod].indices.size();
+		AddSkirt(meshes[lod], m_params.skirtDepth);
+		entry.vertexCount = (unsigned int)meshes[lod].vertexCount();
+		entry.indexCount = (unsigned int)meshes[lod].indices.size();
+		entry.offset = (unsigned int)bytes;
+		bytes += (size_t(entry.vertexCount) * 3 * sizeof(float) + size_t(entry.indexCount) * sizeof(unsigned short) + 3) & ~size_t(3);
+	}
+
+	blob.assign(bytes, 0);
+	unsigned char *out = blob.data();
+	const int header[3] = { x, y, lodCount };
+	memcpy(out, &HEIGHT_CHUNK_FILE_VERSION, 1);
+	memcpy(out + 1, HEIGHT_CHUNK_FILE_MAGIC, 3);
+	memcpy(out + 4, header, sizeof(header));
+	for (int lod = 0; lod < lodCount; ++lod) {
+		const chunk_lod_t &entry = lods[lod];
+		unsigned char *table = out + CHUNK_HEADER_BYTES + CHUNK_LOD_BYTES * size_t(lod);
+		memcpy(table, &entry.maxError, 4);
+		memcpy(table + 4, &entry.vertexCount, 4);
+		memcpy(table + 8, &entry.indexCount, 4);
+		memcpy(table + 12, &entry.skirtFirstIndex, 4);
+		memcpy(table + 16, &entry.offset, 4);
+
+		memcpy(out + entry.offset, meshes[lod].positions.data(), meshes[lod].positions.size() * sizeof(float));
+		unsigned short *indices = reinterpret_cast<unsigned short *>(out + entry.offset + meshes[lod].positions.size() * sizeof(float));
+		for (size_t i = 0; i < meshes[lod].indices.size(); ++i)
+			indices[i] = (unsigned short)meshes[lod].indices[i];
+	}
+}
+
+bool HeightChunks::save(const std::string &prefix) const
+{
+	if (!built())
+		return false;
+	for (int y = 0; y < m_chunksPerSide; ++y) {
+		for (int x = 0; x < m_chunksPerSide; ++x) {
+			const std::vector<unsigned char> &data = blob(x, y);
+			const std::string path = prefix + std::to_string(x) + "_" + std::to_string(y) + ".chunk";
+			FILE *fp = fopen(path.c_str(), "wb");
+			if (!fp)
+				return false;
+			const bool written = fwrite(data.data(), data.size(), 1, fp) == 1;
+			fclose(fp);
+			if (!written)
+				return false;
+		}
+	}
+	return true;
+}
+
+int HeightChunks::LodCount(const unsigned char *blob, const size_t size)
+{
+	if (!blob || size < CHUNK_HEADER_BYTES || blob[0] != HEIGHT_CHUNK_FILE_VERSION ||
+		memcmp(blob + 1, HEIGHT_CHUNK_FILE_MAGIC, 3) != 0)
+		return 0;
+	int lodCount = 0;
+	memcpy(&lodCount, blob + 12, 4);
+	if (lodCount < 1 || CHUNK_HEADER_BYTES + CHUNK_LOD_BYTES * size_t(lodCount) > size)
+		return 0;
+	return lodCount;
+}
+
+bool HeightChunks::ReadLod(const unsigned char *blob, const size_t size, const int lod, lod_view_t &view)
+{
+	if (lod < 0 || lod >= LodCount(blob, size))
+		return false;
+	const unsigned char *table = blob + CHUNK_HEADER_BYTES + CHUNK_LOD_BYTES * size_t(lod);
+	unsigned int offset = 0;
+	memcpy(&view.maxError, table, 4);
+	memcpy(&view.vertexCount, table + 4, 4);
+	memcpy(&view.indexCount, table + 8, 4);
+	memcpy(&view.skirtFirstIndex, table + 12, 4);
+	memcpy(&offset, table + 16, 4);
+	const size_t positionBytes = size_t(view.vertexCount) * 3 * sizeof(float);
+	if (size_t(offset) + positionBytes + size_t(view.indexCount) * sizeof(unsigned short) > size ||
+		view.skirtFirstIndex > view.indexCount || (offset & 3))
+		return false;
+	view.positions = reinterpret_cast<const float *>(blob + offset);
+	view.indices = reinterpret_cast<const unsigned short *>(blob + offset + positionBytes);
+	return true;
+}
@@ -0,0 +1,92 @@
+/****************************************************************
+* Name:       heightchunks.h
+* Purpose:    Per chunk LOD meshes with skirts for streaming
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_CHUNKS_H
+#define HEIGHT_CHUNKS_H
+
+#include <string>
+#include <vector>
+
+#include "heightmesh.h"
+
+// Splits the map into square chunks and bakes a set of RTIN meshes per chunk (see HeightMesh), one per
+// level of detail with a growing error threshold. Chunks of different detail meet with T-junctions, so
+// every mesh gets a skirt: its border edges are extruded straight down, facing outward, which hides the
+// cracks without knowing the neighbours. Chunks bake in parallel, one chunk per thread at a time.
+//
+// Each chunk is one blob that a streaming thread can hand to the renderer as is:
+//	header		version, magic 'HCF', chunk x, y, lod count (4 byte fields after the magic)
+//	lod table	per lod: max error, vertex count, index count, first skirt index, byte offset of the data
+//	lod data	x, y, height floats per vertex, then 16 bit indices padded to 4 bytes
+// Positions are map pixels and 0 - 1 heights like HeightMesh, indices start at 0 per lod
+class HeightChunks
+{
+public:
+	typedef struct chunk_param_t {
+		chunk_param_t() : chunkSize(64), lodCount(4), baseError(0.0005f), errorGrowth(4.0f), skirtDepth(0.02f) {}
+		// Cells per chunk side, a power of two up to 128 (16 bit indices)
+		int chunkSize;
+		// Level of detail n drops vertices within baseError * errorGrowth^n (0 - 1 units)
+		int lodCount;
+		float baseError;
+		float errorGrowth;
+		// Skirt height below the border, 0 - 1 units
+		float skirtDepth;
+	}chunk_param_t;
+
+	// One level of detail read back from a blob, pointers into the blob
+	typedef struct lod_view_t {
+		lod_view_t() : maxError(0.0f), vertexCount(0), indexCount(0), skirtFirstIndex(0),
+			positions(nullptr), indices(nullptr) {}
+		float maxError;
+		unsigned int vertexCount;
+		unsigned int indexCount;
+		// Indices from here on are skirt triangles
+		unsigned int skirtFirstIndex;
+		const float *positions;
+		const unsigned short *indices;
+	}lod_view_t;
+
+	HeightChunks();
+
+	// Bakes every chunk of the generated samples, any sample format, on up to threadCount threads,
+	// 0 uses every hardware thread
+	bool build(HeightGenerator &generator, const chunk_param_t &params = chunk_param_t(), const int threadCount = 0);
+	bool build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+			   const chunk_param_t &params = chunk_param_t(), const int threadCount = 0);
+	void clear();
+
+	// Writes one file per chunk, prefix + "x_y.chunk"
+	bool save(const std::string &prefix) const;
+
+	inline bool built() const {
+		return m_chunksPerSide > 0;
+	}
+	// Chunks per side, the last row and column may reach past the map
+	inline int chunksPerSide() const {
+		return m_chunksPerSide;
+	}
+	inline const std::vector<unsigned char> &blob(const int x, const int y) const {
+		return m_blobs[size_t(x) + size_t(y) * size_t(m_chunksPerSide)];
+	}
+
+	// Lod count of a blob, 0 when it is not a chunk blob
+	static int LodCount(const unsigned char *blob, const size_t size);
+	static bool ReadLod(const unsigned char *blob, const size_t size, const int lod, lod_view_t &view);
+
+private:
+	void bakeChunk(const HeightMesh &mesh, const int x, const int y, std::vector<unsigned char> &blob) const;
+
+	std::vector<std::vector<unsigned char> > m_blobs;
+	chunk_param_t m_params;
+	int m_chunksPerSide;
+};
+
+#endif
@@ -0,0 +1,366 @@
+/****************************************************************
+* Name:       heightcodec.cpp
+* Purpose:    Error bounded lossy height map encoding
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heightcodec.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+static const int CODEC_STRIP_ROWS = 64;
+// Residuals per Rice parameter
+static const int CODEC_RUN = 64;
+// Rice parameter of a run of zeros
+static const unsigned int CODEC_ZERO_RUN = 15;
+// Quotients from here on are written as raw residuals
+static const unsigned int CODEC_ESCAPE = 24;
+static const int CODEC_RAW_BITS = 20;
+static const int CODEC_MAX_ERROR = 4095;
+
+// Runs part(first, end) for count items split into bands, one band per thread
+template<typename Part>
+static void ForBands(const int count, const int threads, const Part &part)
+{
+	if (threads == 1) {
+		part(0, count);
+		return;
+	}
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t) {
+		const int first = count * t / threads;
+		const int end = count * (t + 1) / threads;
+		workers.push_back(std::thread([&part, first, end]() { part(first, end); }));
+	}
+	for (auto & worker : workers)
+		worker.join();
+}
+
+static inline int TrailingZeros(const uint64_t n)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, n);
+	return int(index);
+#else
+	return __builtin_ctzll(n);
+#endif
+}
+
+// Least significant bit first
+typedef struct bit_writer_t {
+	bit_writer_t(std::vector<unsigned char> &out) : bytes(out), bits(0), count(0) {}
+	inline void put(const uint32_t value, const int width) {
+		bits |= uint64_t(value) << count;
+		count += width;
+		while (count >= 8) {
+			bytes.push_back((unsigned char)bits);
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+	inline void flush() {
+		if (count > 0)
+			bytes.push_back((unsigned char)bits);
+		bits = 0;
+		count = 0;
+	}
+	std::vector<unsigned char> &bytes;
+	uint64_t bits;
+	int count;
+}bit_writer_t;
+
+// Reads zero bits past the end, the caller checks overrun()
+typedef struct bit_reader_t {
+	bit_reader_t(const unsigned char *data, const unsigned char *end) : next(data), last(end), bits(0), count(0), past(0) {}
+	inline void refill() {
+		while (count <= 56) {
+			if (next < last)
+				bits |= uint64_t(*next++) << count;
+			else
+				++past;
+			count += 8;
+		}
+	}
+	inline uint32_t get(const int width) {
+		if (count < width)
+			refill();
+		const uint32_t value = uint32_t(bits & ((uint64_t(1) << width) - 1));
+		bits >>= width;
+		count -= width;
+		return value;
+	}
+	// Zero bits before the next one, at most limit
+	inline uint32_t zeros(const uint32_t limit) {
+		if (count < 32)
+			refill();
+		if (bits) {
+			const int run = TrailingZeros(bits);
+			if (run < count && uint32_t(run) < limit) {
+				bits >>= run + 1;
+				count -= run + 1;
+				return uint32_t(run);
+			}
+		}
+		uint32_t run = 0;
+		while (run < limit) {
+			if (count == 0)
+				refill();
+			const bool one = bits & 1;
+			bits >>= 1;
+			--count;
+			if (one)
+				return run;
+			++run;
+		}
+		return run;
+	}
+	inline bool overrun() const {
+		// Bytes read past the end that were used
+		return past * 8 > count;
+	}
+	const unsigned char *next;
+	const unsigned char *last;
+	uint64_t bits;
+	int count;
+	int past;
+}bit_reader_t;
+
+static inline uint32_t ZigZag(const int32_t n)
+{
+	return n >= 0 ? uint32_t(n) << 1 : (uint32_t(-n) << 1) - 1;
+}
+
+static inline int32_t UnZigZag(const uint32_t n)
+{
+	return (n & 1) ? -int32_t((n + 1) >> 1) : int32_t(n >> 1);
+}
+
+static void WriteRun(bit_writer_t &writer, const uint32_t *residuals, const int count)
+{
+	uint32_t any = 0;
+	for (int i = 0; i < count; ++i)
+		any |= residuals[i];
+	if (!any) {
+		writer.put(CODEC_ZERO_RUN, 4);
+		return;
+	}
+
+	// Cheapest Rice parameter
+	uint32_t bestK = 0;
+	uint64_t bestBits = UINT64_MAX;
+	for (uint32_t k = 0; k < CODEC_ZERO_RUN; ++k) {
+		uint64_t bits = 0;
+		for (int i = 0; i < count; ++i) {
+			const uint32_t quotient = residuals[i] >> k;
+			bits += quotient < CODEC_ESCAPE ? quotient + 1 + k : CODEC_ESCAPE + CODEC_RAW_BITS;
+		}
+		if (bits < bestBits) {
+			bestBits = bits;
+			bestK = k;
+		}
+	}
+	writer.put(bestK, 4);
+	for (int i = 0; i < count; ++i) {
+		const uint32_t quotient = residuals[i] >> bestK;
+		if (quotient < CODEC_ESCAPE) {
+			writer.put(0, int(quotient));
+			writer.put(1, 1);
+			writer.put(residuals[i] & ((1u << bestK) - 1), int(bestK));
+		}
+		else {
+			writer.put(0, int(CODEC_ESCAPE));
+			writer.put(residuals[i], CODEC_RAW_BITS);
+		}
+	}
+}
+
+static void ReadRun(bit_reader_t &reader, uint32_t *residuals, const int count)
+{
+	const uint32_t k = reader.get(4);
+	if (k == CODEC_ZERO_RUN) {
+		memset(residuals, 0, sizeof(uint32_t) * count);
+		return;
+	}
+	for (int i = 0; i < count; ++i) {
+		const uint32_t quotient = reader.zeros(CODEC_ESCAPE);
+		if (quotient < CODEC_ESCAPE)
+			residuals[i] = (quotient << k) | reader.get(int(k));
+		else
+			residuals[i] = reader.get(CODEC_RAW_BITS);
+	}
+}
+
+static inline int32_t Sample16(const HeightGenerator::SampleFormat format, const void *samples, const size_t index)
+{
+	if (format == HeightGenerator::SampleFormatUInt16)
+		return reinterpret_cast<const unsigned short *>(samples)[index];
+	const float h = HeightGenerator::SampleHeight(format, samples, index);
+	return (int32_t)(std::min(std::max(h, 0.0f), 1.0f) * 65535.0f + 0.5f);
+}
+
+// count 16 bit values to samples of format
+static void StoreRow(const HeightGenerator::SampleFormat format, const int32_t *values, const int count, void *samples,
+					 const size_t index)
+{
+	switch (format) {
+	case HeightGenerator::SampleFormatUInt16: {
+		unsigned short *out = reinterpret_cast<unsigned short *>(samples) + index;
+		for (int x = 0; x < count; ++x)
+			out[x] = (unsigned short)values[x];
+		break;
+	}
+	case HeightGenerator::SampleFormatUInt8: {
+		unsigned char *out = reinterpret_cast<unsigned char *>(samples) + index;
+		for (int x = 0; x < count; ++x)
+			out[x] = (unsigned char)((values[x] * 255 + 32767) / 65535);
+		break;
+	}
+	case HeightGenerator::SampleFormatFloat32: {
+		float *out = reinterpret_cast<float *>(samples) + index;
+		for (int x = 0; x < count; ++x)
+			out[x] = float(values[x]) * (1.0f / 65535.0f);
+		break;
+	}
+	case HeightGenerator::SampleFormatFloat16: {
+		unsigned short *out = reinterpret_cast<unsigned short *>(samples) + index;
+		for (int x = 0; x < count; ++x)
+			out[x] = HeightGenerator::FloatToHalf(float(values[x]) * (1.0f / 65535.0f));
+		break;
+	}
+	}
+}
+
+bool HeightCodec::Encode(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+						 const int maxError, std::vector<unsigned char> &out, const int threadCount)
+{
+	if (!samples || resolution < 1 || !HeightGenerator::SampleFormatBytes(format) || maxError < 0 ||
+		maxError > CODEC_MAX_ERROR)
+		return false;
+
+	const int32_t step = 2 * maxError + 1;
+	const int strips = (resolution + CODEC_STRIP_ROWS - 1) / CODEC_STRIP_ROWS;
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, strips));
+
+	std::vector<std::vector<unsigned char> > streams(strips);
+	ForBands(strips, threads, [&](const int first, const int end) {
+		std::vector<int32_t> above(resolution), row(resolution);
+		std::vector<uint32_t> residuals(resolution);
+		for (int strip = first; strip < end; ++strip) {
+			bit_writer_t writer(streams[strip]);
+			std::fill(above.begin(), above.end(), 0);
+			const int y0 = strip * CODEC_STRIP_ROWS, y1 = std::min(y0 + CODEC_STRIP_ROWS, resolution);
+			for (int y = y0; y < y1; ++y) {
+				// Reconstructed minus the row above, the left neighbour's part of the prediction
+				int32_t lean = 0;
+				const size_t index = size_t(y) * size_t(resolution);
+				for (int x = 0; x < resolution; ++x) {
+					const int32_t residual = Sample16(format, samples, index + x) - (above[x] + lean);
+					const int32_t quantized = residual >= 0 ? (residual + maxError) / step : -((maxError - residual) / step);
+					lean += quantized * step;
+					row[x] = above[x] + lean;
+					residuals[x] = ZigZag(quantized);
+				}
+				for (int x = 0; x < resolution; x += CODEC_RUN)
+					WriteRun(writer, &residuals[x], std::min(CODEC_RUN, resolution - x));
+				above.swap(row);
+			}
+			writer.flush();
+		}
+	});
+
+	// Max error, strip count, the end of every strip after the table, then the strips
+	const uint32_t header[2] = { uint32_t(maxError), uint32_t(strips) };
+	std::vector<uint32_t> ends(strips);
+	uint32_t total = 0;
+	for (int strip = 0; strip < strips; ++strip) {
+		total += uint32_t(streams[strip].size());
+		ends[strip] = total;
+	}
+	const size_t start = out.size();
+	out.resize(start + sizeof(header) + sizeof(uint32_t) * strips + total);
+	unsigned char *write = &out[start];
+	memcpy(write, header, sizeof(header));
+	write += sizeof(header);
+	memcpy(write, ends.data(), sizeof(uint32_t) * strips);
+	write += sizeof(uint32_t) * strips;
+	for (const auto & stream : streams) {
+		if (!stream.empty())
+			memcpy(write, stream.data(), stream.size());
+		write += stream.size();
+	}
+	return true;
+}
+
+bool HeightCodec::Decode(const unsigned char *data, const size_t size, const int resolution,
+						 const HeightGenerator::SampleFormat format, void *samples, const int threadCount)
+{
+	uint32_t header[2];
+	if (!data || !samples || resolution < 1 || !HeightGenerator::SampleFormatBytes(format) || size < sizeof(header))
+		return false;
+	memcpy(header, data, sizeof(header));
+	const int32_t step = 2 * int32_t(header[0]) + 1;
+	const int strips = (resolution + CODEC_STRIP_ROWS - 1) / CODEC_STRIP_ROWS;
+	if (header[0] > uint32_t(CODEC_MAX_ERROR) || header[1] != uint32_t(strips) ||
+		size < sizeof(header) + sizeof(uint32_t) * strips)
+		return false;
+	std::vector<uint32_t> ends(strips);
+	memcpy(ends.data(), data + sizeof(header), sizeof(uint32_t) * strips);
+	const unsigned char *payload = data + sizeof(header) + sizeof(uint32_t) * strips;
+	const size_t payloadSize = size - sizeof(header) - sizeof(uint32_t) * strips;
+	for (int strip = 0; strip < strips; ++strip) {
+		if (ends[strip] > payloadSize || (strip && ends[strip] < ends[strip - 1]))
+			return false;
+	}
+
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, strips));
+	// A sample the encoder reconstructed is at most maxError off a 16 bit value, anything further out is a
+	// corrupt stream. Checking every row value also keeps the running sum small, a raw residual times the
+	// step alone needs more than 32 bits
+	const int64_t lowest = -int64_t(header[0]), highest = 65535 + int64_t(header[0]);
+	std::vector<char> failed(strips, 0);
+	ForBands(strips, threads, [&](const int first, const int end) {
+		std::vector<int32_t> above(resolution), row(resolution), clamped(resolution);
+		std::vector<uint32_t> residuals(resolution);
+		for (int strip = first; strip < end; ++strip) {
+			bit_reader_t reader(payload + (strip ? ends[strip - 1] : 0), payload + ends[strip]);
+			std::fill(above.begin(), above.end(), 0);
+			const int y0 = strip * CODEC_STRIP_ROWS, y1 = std::min(y0 + CODEC_STRIP_ROWS, resolution);
+			for (int y = y0; y < y1; ++y) {
+				for (int x = 0; x < resolution; x += CODEC_RUN)
+					ReadRun(reader, &residuals[x], std::min(CODEC_RUN, resolution - x));
+				// Row above plus the running sum of the dequantized residuals
+				int64_t lean = 0;
+				for (int x = 0; x < resolution; ++x) {
+					lean += int64_t(UnZigZag(residuals[x])) * step;
+					const int64_t value = above[x] + lean;
+					if (value < lowest || value > highest) {
+						failed[strip] = 1;
+						break;
+					}
+					row[x] = int32_t(value);
+				}
+				if (failed[strip])
+					break;
+				for (int x = 0; x < resolution; ++x)
+					clamped[x] = std::min(std::max(row[x], 0), 65535);
+				StoreRow(format, clamped.data(), resolution, samples, size_t(y) * size_t(resolution));
+				above.swap(row);
+			}
+			failed[strip] = failed[strip] || reader.overrun();
+		}
+	});
+	return std::find(failed.begin(), failed.end(), 1) == failed.end();
+}
@@ -0,0 +1,40 @@
+/****************************************************************
+* Name:       heightcodec.h
+* Purpose:    Error bounded lossy height map encoding
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_CODEC_H
+#define HEIGHT_CODEC_H
+
+#include <vector>
+
+#include "heightgenerator.h"
+
+// Near lossless predictive coding of 16 bit heights. Each sample is predicted from its reconstructed left,
+// upper and upper left neighbours (left + up - upper left), the residual is quantized in steps of
+// 2 * maxError + 1 so no decoded sample is more than maxError 16 bit steps off, 0 is lossless. Residuals
+// are Rice coded in runs of 64 with a code parameter per run, runs of zeros (the sea) cost 4 bits.
+//
+// The prediction makes a decoded row the row above plus a running sum of the dequantized residuals, so
+// after the bit stream a row is rebuilt by a prefix sum and a clamp. The map is coded in strips of 64
+// rows that start over from a zero row, strips encode and decode on separate threads.
+//
+// Samples in other formats are quantized to 16 bit first and decoded back to their format, which adds
+// up to half a step of error
+class HeightCodec
+{
+public:
+	// Appends the encoding of samples to out. threadCount 0 uses every hardware thread
+	static bool Encode(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+					   const int maxError, std::vector<unsigned char> &out, const int threadCount = 0);
+	// Decodes size bytes to resolution^2 samples in format. False on a truncated or corrupt stream
+	static bool Decode(const unsigned char *data, const size_t size, const int resolution,
+					   const HeightGenerator::SampleFormat format, void *samples, const int threadCount = 0);
+};
+
+#endif
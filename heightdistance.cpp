@@ -0,0 +1,138 @@
+/****************************************************************
+* Name:       heightdistance.cpp
+* Purpose:    Euclidean distance to the nearest water pixel
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heightdistance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <thread>
+
+
+// Runs part(first, end) for count items split into bands, one band per thread
+template<typename Part>
+static void ForBands(const int count, const int threads, const Part &part)
+{
+	if (threads == 1) {
+		part(0, count);
+		return;
+	}
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t) {
+		const int first = count * t / threads;
+		const int end = count * (t + 1) / threads;
+		workers.push_back(std::thread([&part, first, end]() { part(first, end); }));
+	}
+	for (auto & worker : workers)
+		worker.join();
+}
+
+HeightDistance::HeightDistance() : m_resolution(0)
+{
+}
+
+bool HeightDistance::build(HeightGenerator &generator, const float waterLevel, const int threadCount)
+{
+	return build(generator.generatedSamples(), generator.generatedSampleFormat(), generator.generatedParam().resolution,
+				 waterLevel, threadCount);
+}
+
+bool HeightDistance::build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+						   const float waterLevel, const int threadCount)
+{
+	clear();
+	if (!samples || resolution <= 0 || !HeightGenerator::SampleFormatBytes(format))
+		return false;
+
+	m_resolution = resolution;
+	const size_t stride = size_t(resolution);
+	const size_t pixels = stride * stride;
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, resolution));
+
+	// Farther than any pixel of the map, marks a column without water
+	const int32_t far = resolution * 2;
+
+	// Distance to the nearest water in the same column: 0 on water, then each band of columns sweeps
+	// the rows down and back up, the inner loops run along rows
+	std::vector<int32_t> column(pixels);
+	ForBands(resolution, threads, [&](const int first, const int end) {
+		for (size_t i = size_t(first) * stride; i < size_t(end) * stride; ++i)
+			column[i] = HeightGenerator::SampleHeight(format, samples, i) <= waterLevel ? 0 : far;
+	});
+	ForBands(resolution, threads, [&](const int first, const int end) {
+		for (int y = 1; y < resolution; ++y) {
+			int32_t *row = &column[size_t(y) * stride];
+			const int32_t *above = row - stride;
+			for (int x = first; x < end; ++x)
+				row[x] = std::min(row[x], above[x] + 1);
+		}
+		for (int y = resolution - 2; y >= 0; --y) {
+			int32_t *row = &column[size_t(y) * stride];
+			const int32_t *below = row + stride;
+			for (int x = first; x < end; ++x)
+				row[x] = std::min(row[x], below[x] + 1);
+		}
+	});
+
+	// Along each row the squared distance is the lower envelope of the parabolas
+	// f(x) = (x - i)^2 + column(i)^2. Envelope segment k belongs to parabola site[k] from start[k]
+	m_distances.resize(pixels);
+	ForBands(resolution, threads, [&](const int first, const int end) {
+		std::vector<int> site(resolution), start(resolution);
+		for (int y = first; y < end; ++y) {
+			const int32_t *g = &column[size_t(y) * stride];
+			float *out = &m_distances[size_t(y) * stride];
+
+			// x where the parabola of v gets lower than the one of u, u < v
+			auto separation = [g](const int u, const int v) {
+				const int64_t gu = g[u], gv = g[v];
+				return int((int64_t(v) * v - int64_t(u) * u + gv * gv - gu * gu) / (2 * int64_t(v - u)));
+			};
+			auto parabola = [g](const int x, const int i) {
+				const int64_t gi = g[i];
+				return int64_t(x - i) * (x - i) + gi * gi;
+			};
+
+			int k = 0;
+			site[0] = 0;
+			start[0] = 0;
+			for (int u = 1; u < resolution; ++u) {
+				while (k >= 0 && parabola(start[k], site[k]) > parabola(start[k], u))
+					--k;
+				if (k < 0) {
+					k = 0;
+					site[0] = u;
+				}
+				else {
+					const int w = 1 + separation(site[k], u);
+					if (w < resolution) {
+						++k;
+						site[k] = u;
+						start[k] = w;
+					}
+				}
+			}
+			for (int x = resolution - 1; x >= 0; --x) {
+				const int64_t squared = parabola(x, site[k]);
+				out[x] = g[site[k]] >= far ? std::numeric_limits<float>::infinity() : (float)std::sqrt((double)squared);
+				if (x == start[k])
+					--k;
+			}
+		}
+	});
+	return true;
+}
+
+void HeightDistance::clear()
+{
+	m_distances.clear();
+	m_resolution = 0;
+}
@@ -0,0 +1,56 @@
+/****************************************************************
+* Name:       heightdistance.h
+* Purpose:    Euclidean distance to the nearest water pixel
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_DISTANCE_H
+#define HEIGHT_DISTANCE_H
+
+#include <vector>
+
+#include "heightgenerator.h"
+
+// Exact Euclidean distance transform, the distance of every pixel to the nearest water pixel, a pixel
+// at or below the water level. generate() clamps the sea to 0, so the default level finds the coast.
+//
+// Linear time and separable (Meijster et al.): a pass down and up the columns finds the distance to
+// the nearest water in the same column, a pass along each row takes the lower envelope of the
+// parabolas of those column distances. Both passes are integer and exact, bands of columns and then
+// bands of rows run on separate threads.
+class HeightDistance
+{
+public:
+	HeightDistance();
+
+	// Builds from the generated samples, any sample format, on up to threadCount threads, 0 uses every
+	// hardware thread
+	bool build(HeightGenerator &generator, const float waterLevel = 0.0f, const int threadCount = 0);
+	bool build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+			   const float waterLevel = 0.0f, const int threadCount = 0);
+	void clear();
+
+	inline bool built() const {
+		return m_resolution > 0;
+	}
+	inline int resolution() const {
+		return m_resolution;
+	}
+	// Distances in pixels, row major like the samples. 0 on water, infinity on a map without water
+	inline const float *distances() const {
+		return m_distances.data();
+	}
+	inline float distance(const int x, const int y) const {
+		return m_distances[size_t(x) + size_t(y) * size_t(m_resolution)];
+	}
+
+private:
+	std::vector<float> m_distances;
+	int m_resolution;
+};
+
+#endif
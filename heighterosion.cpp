@@ -0,0 +1,583 @@
+/****************************************************************
+* Name:       heighterosion.cpp
+* Purpose:    Erosion post-processing of generated height maps
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heighterosion.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+static const float EROSION_GRAVITY = 9.81f;
+// Pixels per kernel batch. The kernels write a batch to local arrays first, the compiler knows those
+// alias nothing and vectorizes the math without runtime overlap checks between all the layers
+static const size_t EROSION_BATCH = 64;
+// Thermal tiles are THERMAL_TILE pixels square and run up to THERMAL_STEPS steps per visit, a tile
+// with its halo is 80 x 80 floats, both copies of it stay in L2
+static const int THERMAL_TILE = 64;
+static const int THERMAL_STEPS = 8;
+
+// Threads of a stage meet here between passes, a pass only reads what earlier passes wrote
+class ErosionBarrier
+{
+public:
+	explicit ErosionBarrier(const int count) : m_count(count), m_waiting(0), m_generation(0) {}
+
+	void wait() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		const int generation = m_generation;
+		if (++m_waiting == m_count) {
+			m_waiting = 0;
+			++m_generation;
+			m_condition.notify_all();
+			return;
+		}
+		m_condition.wait(lock, [this, generation]() { return generation != m_generation; });
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	const int m_count;
+	int m_waiting;
+	int m_generation;
+};
+
+static int ErosionThreads(const int threadCount, const int resolution)
+{
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	// Bands of at least 16 rows
+	return std::max(1, std::min(threads, resolution / 16));
+}
+
+// Runs pass(firstRow, endRow) for every band of rows on its own thread, the band of the last thread
+// runs on the calling thread
+template<typename Bands>
+static void RunBands(const int resolution, const int threads, const Bands &bands)
+{
+	if (threads == 1) {
+		bands(0, resolution);
+		return;
+	}
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads - 1; ++t) {
+		const int first = resolution * t / threads;
+		const int end = resolution * (t + 1) / threads;
+		workers.push_back(std::thread([&bands, first, end]() { bands(first, end); }));
+	}
+	bands(resolution * (threads - 1) / threads, resolution);
+	for (auto & worker : workers)
+		worker.join();
+}
+
+// The row kernels below avoid float compares, std::min / std::max on floats and std::sqrt, none of
+// which vectorize under the default floating point flags (trapping math, errno)
+static inline int32_t Bits(const float n)
+{
+	int32_t bits;
+	memcpy(&bits, &n, sizeof(bits));
+	return bits;
+}
+
+static inline float FromBits(const int32_t bits)
+{
+	float n;
+	memcpy(&n, &bits, sizeof(n));
+	return n;
+}
+
+// max(0, n), exact
+static inline float PositivePart(const float n)
+{
+	return 0.5f * (n + std::fabs(n));
+}
+
+// Non negative floats order like their bit patterns
+static inline float MaxNonNegative(const float a, const float b)
+{
+	return FromBits(std::max(Bits(a), Bits(b)));
+}
+
+static inline float MinNonNegative(const float a, const float b)
+{
+	return FromBits(std::min(Bits(a), Bits(b)));
+}
+
+// negative (or -0) ? a : b
+static inline float SelectNegative(const float n, const float a, const float b)
+{
+	const int32_t mask = Bits(n) >> 31;
+	return FromBits((Bits(a) & mask) | (Bits(b) & ~mask));
+}
+
+// Square root of n >= 0 from the reciprocal square root estimate and two Newton steps, ~1e-6 relative
+static inline float SqrtNonNegative(const float n)
+{
+	float y = FromBits(0x5f375a86 - (Bits(n) >> 1));
+	y = y * (1.5f - 0.5f * n * y * y);
+	y = y * (1.5f - 0.5f * n * y * y);
+	return n * y;
+}
+
+// Shallow water state, terrain and water in pixels. Outflow flux per pixel towards x - 1, x + 1, y - 1, y + 1
+typedef struct hydraulic_state_t {
+	int resolution;
+	float *terrain;
+	float *water;
+	float *sediment[2];
+	float *flux[4];
+	// Slope (sine) between the flux and the erosion pass
+	float *tilt;
+	std::vector<float> storage;
+}hydraulic_state_t;
+
+enum FluxDirection {
+	FluxLeft = 0,
+	FluxRight,
+	FluxUp,
+	FluxDown
+};
+
+// A run of pixels [begin, end) of one row with the same neighbour offsets. At the map border the
+// offset is 0, the pixel is its own neighbour, which keeps the flux out of the map at 0. The masks
+// drop the inflow from a missing neighbour
+typedef struct row_run_t {
+	size_t begin;
+	size_t end;
+	// First pixel of the row and the row
+	size_t row;
+	int y;
+	ptrdiff_t left, right, up, down;
+	float leftMask, rightMask, upMask, downMask;
+}row_run_t;
+
+static void HydraulicFlux(const hydraulic_state_t &state, const HeightErosion::hydraulic_param_t &params, const row_run_t &run)
+{
+	const float *terrain = state.terrain;
+	const float *water = state.water;
+	float *fluxLeft = state.flux[FluxLeft];
+	float *fluxRight = state.flux[FluxRight];
+	float *fluxUp = state.flux[FluxUp];
+	float *fluxDown = state.flux[FluxDown];
+	float *tilt = state.tilt;
+	const float pressure = params.timeStep * EROSION_GRAVITY;
+	const float dt = params.timeStep;
+	const float minTilt = params.minTilt;
+	const ptrdiff_t left = run.left, right = run.right, up = run.up, down = run.down;
+
+	const int count = int(run.end - run.begin);
+	float outLeft[EROSION_BATCH], outRight[EROSION_BATCH], outUp[EROSION_BATCH], outDown[EROSION_BATCH], outTilt[EROSION_BATCH];
+	for (int k = 0; k < count; ++k) {
+		const size_t i = run.begin + k;
+		const float level = terrain[i] + water[i];
+		const float fl = PositivePart(fluxLeft[i] + pressure * (level - terrain[i + left] - water[i + left]));
+		const float fr = PositivePart(fluxRight[i] + pressure * (level - terrain[i + right] - water[i + right]));
+		const float fu = PositivePart(fluxUp[i] + pressure * (level - terrain[i + up] - water[i + up]));
+		const float fd = PositivePart(fluxDown[i] + pressure * (level - terrain[i + down] - water[i + down]));
+		// No more water leaves than the pixel holds, min(1, water / outflow)
+		const float outflow = (fl + fr + fu + fd) * dt;
+		const float scale = water[i] / MaxNonNegative(MaxNonNegative(outflow, water[i]), 1e-20f);
+		outLeft[k] = fl * scale;
+		outRight[k] = fr * scale;
+		outUp[k] = fu * scale;
+		outDown[k] = fd * scale;
+
+		const float gx = (terrain[i + right] - terrain[i + left]) * 0.5f;
+		const float gy = (terrain[i + down] - terrain[i + up]) * 0.5f;
+		const float g2 = gx * gx + gy * gy;
+		outTilt[k] = MaxNonNegative(SqrtNonNegative(g2 / (1.0f + g2)), minTilt);
+	}
+	for (int k = 0; k < count; ++k) {
+		const size_t i = run.begin + k;
+		fluxLeft[i] = outLeft[k];
+		fluxRight[i] = outRight[k];
+		fluxUp[i] = outUp[k];
+		fluxDown[i] = outDown[k];
+		tilt[i] = outTilt[k];
+	}
+}
+
+// Water levels from the fluxes, then dissolving below and deposition above the capacity of the water
+static void HydraulicErode(const hydraulic_state_t &state, const HeightErosion::hydraulic_param_t &params,
+						   float *sediment, const row_run_t &run)
+{
+	float *terrain = state.terrain;
+	float *water = state.water;
+	const float *fluxLeft = state.flux[FluxLeft];
+	const float *fluxRight = state.flux[FluxRight];
+	const float *fluxUp = state.flux[FluxUp];
+	const float *fluxDown = state.flux[FluxDown];
+	const float *tilt = state.tilt;
+	const float dt = params.timeStep;
+	const float capacityScale = params.capacity;
+	const float invFullDepth = 1.0f / params.fullDepth;
+	const float dissolving = params.dissolving * dt;
+	const float deposition = params.deposition * dt;
+	const ptrdiff_t left = run.left, right = run.right, up = run.up, down = run.down;
+	const float leftMask = run.leftMask, rightMask = run.rightMask, upMask = run.upMask, downMask = run.downMask;
+
+	const int count = int(run.end - run.begin);
+	float outWater[EROSION_BATCH], outTerrain[EROSION_BATCH], outSediment[EROSION_BATCH];
+	for (int k = 0; k < count; ++k) {
+		const size_t i = run.begin + k;
+		const float fromLeft = fluxRight[i + left] * leftMask;
+		const float fromRight = fluxLeft[i + right] * rightMask;
+		const float fromUp = fluxDown[i + up] * upMask;
+		const float fromDown = fluxUp[i + down] * downMask;
+		const float inflow = fromLeft + fromRight + fromUp + fromDown;
+		const float outflow = fluxLeft[i] + fluxRight[i] + fluxUp[i] + fluxDown[i];
+		const float before = water[i];
+		const float after = PositivePart(before + (inflow - outflow) * dt);
+		outWater[k] = after;
+
+		// Velocity from the water passing through, over the mean depth
+		const float vx = (fromLeft - fluxLeft[i] + fluxRight[i] - fromRight) * 0.5f;
+		const float vy = (fromUp - fluxUp[i] + fluxDown[i] - fromDown) * 0.5f;
+		const float depth = (before + after) * 0.5f;
+		const float speed = SqrtNonNegative(vx * vx + vy * vy) / MaxNonNegative(depth, 1e-4f);
+		const float capacity = capacityScale * tilt[i] * speed * MinNonNegative(depth * invFullDepth, 1.0f);
+
+		const float difference = capacity - sediment[i];
+		const float amount = difference * SelectNegative(difference, deposition, dissolving);
+		outTerrain[k] = terrain[i] - amount;
+		outSediment[k] = sediment[i] + amount;
+	}
+	for (int k = 0; k < count; ++k) {
+		const size_t i = run.begin + k;
+		water[i] = outWater[k];
+		terrain[i] = outTerrain[k];
+		sediment[i] = outSediment[k];
+	}
+}
+
+// Semi-Lagrangian sediment transport, then evaporation and the rain of the next step
+static void HydraulicTransport(const hydraulic_state_t &state, const HeightErosion::hydraulic_param_t &params,
+							   const float *sediment, float *transported, const row_run_t &run)
+{
+	float *water = state.water;
+	const float *fluxLeft = state.flux[FluxLeft];
+	const float *fluxRight = state.flux[FluxRight];
+	const float *fluxUp = state.flux[FluxUp];
+	const float *fluxDown = state.flux[FluxDown];
+	const int resolution = state.resolution;
+	const float last = float(resolution - 1);
+	const float dt = params.timeStep;
+	const float keep = 1.0f - params.evaporation * dt;
+	const float rain = params.rain * dt;
+	const float y = float(run.y);
+	const float x = float(int(run.begin - run.row));
+	const ptrdiff_t left = run.left, right = run.right, up = run.up, down = run.down;
+	const float leftMask = run.leftMask, rightMask = run.rightMask, upMask = run.upMask, downMask = run.downMask;
+
+	const int count = int(run.end - run.begin);
+	float outWater[EROSION_BATCH], outSediment[EROSION_BATCH];
+	// Source texel offset relative to the row and weights, gathered corners, like the bilinear sampler
+	int offset[EROSION_BATCH];
+	float wx[EROSION_BATCH], wy[EROSION_BATCH];
+	float s00[EROSION_BATCH], s10[EROSION_BATCH], s01[EROSION_BATCH], s11[EROSION_BATCH];
+	for (int k = 0; k < count; ++k) {
+		const size_t i = run.begin + k;
+		const float vx = (fluxRight[i + left] * leftMask - fluxLeft[i] + fluxRight[i] - fluxLeft[i + right] * rightMask) * 0.5f;
+		const float vy = (fluxDown[i + up] * upMask - fluxUp[i] + fluxDown[i] - fluxUp[i + down] * downMask) * 0.5f;
+		const float depth = water[i];
+		const float scale = dt / MaxNonNegative(depth, 1e-4f);
+
+		// Where the water came from, at most a pixel away (CFL) and inside the map
+		const float dx = 1.0f - PositivePart(1.0f - (PositivePart(vx * scale + 1.0f) - 1.0f));
+		const float dy = 1.0f - PositivePart(1.0f - (PositivePart(vy * scale + 1.0f) - 1.0f));
+		const float sx = last - PositivePart(last - PositivePart(x + float(k) - dx));
+		const float sy = last - PositivePart(last - PositivePart(y - dy));
+		const int ix = std::min((int)sx, resolution - 2);
+		const int iy = std::min((int)sy, resolution - 2);
+		wx[k] = sx - ix;
+		wy[k] = sy - iy;
+		offset[k] = ix + (iy - run.y) * resolution;
+		outWater[k] = depth * keep + rain;
+	}
+	const float *row = sediment + run.row;
+	for (int k = 0; k < count; ++k) {
+		const float *s = row + offset[k];
+		s00[k] = s[0];
+		s10[k] = s[1];
+		s01[k] = s[resolution];
+		s11[k] = s[resolution + 1];
+	}
+	for (int k = 0; k < count; ++k) {
+		const float top = s00[k] + (s10[k] - s00[k]) * wx[k];
+		const float bottom = s01[k] + (s11[k] - s01[k]) * wx[k];
+		outSediment[k] = top + (bottom - top) * wy[k];
+	}
+	for (int k = 0; k < count; ++k) {
+		const size_t i = run.begin + k;
+		transported[i] = outSediment[k];
+		water[i] = outWater[k];
+	}
+}
+
+// Calls kernel(run) for batches of at most EROSION_BATCH pixels of the run
+template<typename Kernel>
+static inline void ForBatches(row_run_t run, const size_t end, const Kernel &kernel)
+{
+	for (; run.begin < end; run.begin = run.end) {
+		run.end = std::min(run.begin + EROSION_BATCH, end);
+		kernel(run);
+	}
+}
+
+// Calls kernel(run) for the runs of row y: the left border pixel, the interior and the right border pixel
+template<typename Kernel>
+static inline void ForRowRuns(const int resolution, const int y, const Kernel &kernel)
+{
+	row_run_t run;
+	run.row = size_t(y) * size_t(resolution);
+	run.y = y;
+	run.up = y > 0 ? -ptrdiff_t(resolution) : 0;
+	run.down = y < resolution - 1 ? ptrdiff_t(resolution) : 0;
+	run.upMask = y > 0 ? 1.0f : 0.0f;
+	run.downMask = y < resolution - 1 ? 1.0f : 0.0f;
+
+	run.begin = run.row;
+	run.end = run.row + 1;
+	run.left = 0;
+	run.right = 1;
+	run.leftMask = 0.0f;
+	run.rightMask = 1.0f;
+	kernel(run);
+
+	run.begin = run.row + 1;
+	run.left = -1;
+	run.leftMask = 1.0f;
+	ForBatches(run, run.row + resolution - 1, kernel);
+
+	run.begin = run.row + resolution - 1;
+	run.end = run.row + resolution;
+	run.right = 0;
+	run.rightMask = 0.0f;
+	kernel(run);
+}
+
+// Material moving from a pixel to a neighbour d lower, minus what comes back from a neighbour d
+// higher, beyond the talus difference t. Antisymmetric, so every transfer is exact in mass
+static inline float TalusFlow(const float d, const float t)
+{
+	return PositivePart(d - t) - PositivePart(-d - t);
+}
+
+// One thermal step over pixels [begin, end) of row y of a tile. Diagonal neighbours are sqrt(2)
+// away, their talus difference is that much larger and they take half the weight
+static void ThermalRow(const float *src, float *dst, const int width, const int y, const int begin, const int end,
+					   const float talus, const float diagonalTalus, const float rate)
+{
+	const float *up = src + size_t(y - 1) * width;
+	const float *mid = src + size_t(y) * width;
+	const float *down = src + size_t(y + 1) * width;
+	float *out = dst + size_t(y) * width;
+	for (int x = begin; x < end; ++x) {
+		const float h = mid[x];
+		const float straight = TalusFlow(h - mid[x - 1], talus) + TalusFlow(h - mid[x + 1], talus) +
+							   TalusFlow(h - up[x], talus) + TalusFlow(h - down[x], talus);
+		const float diagonal = TalusFlow(h - up[x - 1], diagonalTalus) + TalusFlow(h - up[x + 1], diagonalTalus) +
+							   TalusFlow(h - down[x - 1], diagonalTalus) + TalusFlow(h - down[x + 1], diagonalTalus);
+		out[x] = h - rate * (straight + 0.5f * diagonal);
+	}
+}
+
+// Clamps a tile coordinate with halo to the map
+static inline int ThermalClamp(const int n, const int resolution)
+{
+	return std::min(std::max(n, 0), resolution - 1);
+}
+
+// steps thermal steps of the tile at x0, y0, tileWidth x tileHeight, from src into dst. The tile is
+// loaded with a halo of steps pixels, every step updates one pixel less into the halo and after steps
+// steps exactly the tile is valid. Outside the map the halo repeats the edge, its flow to the edge
+// pixel is matched by the flow back from a real neighbour, so the map keeps its mass
+static void ThermalTile(const float *src, float *dst, const int resolution, const int x0, const int y0,
+						const int tileWidth, const int tileHeight, const int steps, const float talus,
+						const float diagonalTalus, const float rate, std::vector<float> &a, std::vector<float> &b)
+{
+	const int border = steps;
+	const int width = tileWidth + border * 2;
+	const int height = tileHeight + border * 2;
+	a.resize(size_t(width) * height);
+	b.resize(size_t(width) * height);
+
+	for (int y = 0; y < height; ++y) {
+		const float *row = src + size_t(ThermalClamp(y0 - border + y, resolution)) * resolution;
+		float *local = &a[size_t(y) * width];
+		for (int x = 0; x < width; ++x)
+			local[x] = row[ThermalClamp(x0 - border + x, resolution)];
+	}
+
+	// Halo pixels outside the map, re-copied from the edge after every step
+	const int left = std::max(border - x0, 0);
+	const int right = std::max(x0 + tileWidth + border - resolution, 0);
+	const int top = std::max(border - y0, 0);
+	const int bottom = std::max(y0 + tileHeight + border - resolution, 0);
+
+	float *from = a.data();
+	float *to = b.data();
+	for (int step = 0; step < steps; ++step) {
+		const int ring = steps - 1 - step;
+		for (int y = border - ring; y < border + tileHeight + ring; ++y)
+			ThermalRow(from, to, width, y, border - ring, border + tileWidth + ring, talus, diagonalTalus, rate);
+		for (int y = 1; y < height - 1; ++y) {
+			float *row = to + size_t(y) * width;
+			for (int x = 0; x < left; ++x)
+				row[x] = row[left];
+			for (int x = width - right; x < width; ++x)
+				row[x] = row[width - right - 1];
+		}
+		for (int y = 0; y < top; ++y)
+			memcpy(to + size_t(y) * width, to + size_t(top) * width, sizeof(float) * width);
+		for (int y = height - bottom; y < height; ++y)
+			memcpy(to + size_t(y) * width, to + size_t(height - bottom - 1) * width, sizeof(float) * width);
+		std::swap(from, to);
+	}
+
+	for (int y = 0; y < tileHeight; ++y)
+		memcpy(dst + size_t(y0 + y) * resolution + x0, from + size_t(y + border) * width + border, sizeof(float) * tileWidth);
+}
+
+HeightErosion::HeightErosion() : m_hydraulicEnabled(false), m_thermalEnabled(false)
+{
+}
+
+void HeightErosion::setHydraulic(const hydraulic_param_t &params)
+{
+	m_hydraulic = params;
+	m_hydraulicEnabled = true;
+}
+
+void HeightErosion::setThermal(const thermal_param_t &params)
+{
+	m_thermal = params;
+	m_thermalEnabled = true;
+}
+
+void HeightErosion::clearStages()
+{
+	m_hydraulicEnabled = false;
+	m_thermalEnabled = false;
+}
+
+bool HeightErosion::apply(float *heights, const int resolution, const int threadCount) const
+{
+	if (!heights || resolution < 2)
+		return false;
+	if (m_hydraulicEnabled && !Hydraulic(heights, resolution, m_hydraulic, threadCount))
+		return false;
+	if (m_thermalEnabled && !Thermal(heights, resolution, m_thermal, threadCount))
+		return false;
+	return true;
+}
+
+bool HeightErosion::Hydraulic(float *heights, const int resolution, const hydraulic_param_t &params, const int threadCount)
+{
+	if (!heights || resolution < 2 || params.iterations < 0 || params.timeStep <= 0.0f || params.heightScale <= 0.0f ||
+		params.fullDepth <= 0.0f)
+		return false;
+	// Gather offsets are int
+	if (size_t(resolution) * size_t(resolution) > size_t(INT_MAX))
+		return false;
+
+	const size_t pixels = size_t(resolution) * size_t(resolution);
+	hydraulic_state_t state;
+	state.resolution = resolution;
+	state.terrain = heights;
+	state.storage.assign(pixels * 8, 0.0f);
+	state.water = state.storage.data();
+	state.sediment[0] = state.water + pixels;
+	state.sediment[1] = state.sediment[0] + pixels;
+	for (int d = 0; d < 4; ++d)
+		state.flux[d] = state.sediment[1] + pixels * (d + 1);
+	state.tilt = state.flux[3] + pixels;
+	std::fill(state.water, state.water + pixels, params.rain * params.timeStep);
+
+	const int threads = ErosionThreads(threadCount, resolution);
+	ErosionBarrier barrier(threads);
+	RunBands(resolution, threads, [&](const int first, const int end) {
+		const size_t stride = size_t(resolution);
+		for (size_t i = first * stride; i < end * stride; ++i)
+			heights[i] *= params.heightScale;
+		barrier.wait();
+
+		for (int iteration = 0; iteration < params.iterations; ++iteration) {
+			float *sediment = state.sediment[iteration & 1];
+			float *transported = state.sediment[(iteration + 1) & 1];
+
+			// Flux out of each pixel, from the levels of the previous step
+			for (int y = first; y < end; ++y)
+				ForRowRuns(resolution, y, [&](const row_run_t &run) { HydraulicFlux(state, params, run); });
+			barrier.wait();
+
+			// Water levels, dissolving and deposition, from the fluxes of the whole map
+			for (int y = first; y < end; ++y)
+				ForRowRuns(resolution, y, [&](const row_run_t &run) { HydraulicErode(state, params, sediment, run); });
+			barrier.wait();
+
+			// Sediment moves with the water
+			for (int y = first; y < end; ++y)
+				ForRowRuns(resolution, y, [&](const row_run_t &run) { HydraulicTransport(state, params, sediment, transported, run); });
+			barrier.wait();
+		}
+
+		// Sediment still in the water settles where it is
+		const float *sediment = state.sediment[params.iterations & 1];
+		for (size_t i = first * stride; i < end * stride; ++i)
+			heights[i] = (heights[i] + sediment[i]) / params.heightScale;
+	});
+	return true;
+}
+
+bool HeightErosion::Thermal(float *heights, const int resolution, const thermal_param_t &params, const int threadCount)
+{
+	if (!heights || resolution < 2 || params.iterations < 0 || params.talus < 0.0f || params.heightScale <= 0.0f ||
+		params.strength < 0.0f || params.strength > 1.0f)
+		return false;
+
+	// In sample units. The weights add up to 6, at most the whole excess leaves a pixel per step
+	const float talus = params.talus / params.heightScale;
+	const float diagonalTalus = talus * 1.41421356f;
+	const float rate = params.strength / 6.0f;
+
+	const size_t pixels = size_t(resolution) * size_t(resolution);
+	std::vector<float> scratch(pixels);
+	const int threads = ErosionThreads(threadCount, resolution);
+	ErosionBarrier barrier(threads);
+	RunBands(resolution, threads, [&](const int first, const int end) {
+		// Tile copies of this thread
+		std::vector<float> a, b;
+		float *src = heights;
+		float *dst = scratch.data();
+		for (int done = 0; done < params.iterations; done += THERMAL_STEPS) {
+			const int steps = std::min(THERMAL_STEPS, params.iterations - done);
+			for (int y0 = first; y0 < end; y0 += THERMAL_TILE) {
+				const int tileHeight = std::min(THERMAL_TILE, end - y0);
+				for (int x0 = 0; x0 < resolution; x0 += THERMAL_TILE)
+					ThermalTile(src, dst, resolution, x0, y0, std::min(THERMAL_TILE, resolution - x0), tileHeight,
+								steps, talus, diagonalTalus, rate, a, b);
+			}
+			// Every band reads the halo of its tiles from the neighbour bands
+			barrier.wait();
+			std::swap(src, dst);
+		}
+		if (src != heights) {
+			const size_t stride = size_t(resolution);
+			memcpy(heights + first * stride, src + first * stride, sizeof(float) * (end - first) * stride);
+		}
+	});
+	return true;
+}
@@ -0,0 +1,103 @@
+/****************************************************************
+* Name:       heighterosion.h
+* Purpose:    Erosion post-processing of generated height maps
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_EROSION_H
+#define HEIGHT_EROSION_H
+
+// Erosion stages run on a row major float map in place. Set height_map_param_t::erosion to run the
+// enabled stages inside generate(), before the samples are converted to the sample format, or call
+// apply() on any float map.
+//
+// Hydraulic erosion is the grid based shallow water (virtual pipe) model: rain fills a water layer,
+// water flows through pipes to the four neighbours, fast water dissolves terrain into sediment,
+// slow water deposits it, the sediment moves with the water and the water evaporates. Every step is
+// a few stencil passes over rows, threads take bands of rows and meet at a barrier between passes,
+// so the result does not depend on the thread count.
+//
+// Thermal erosion moves material down wherever the slope to one of the eight neighbours exceeds the
+// talus slope, which rounds off cliffs and spikes into scree. Each step is one stencil sweep; tiles
+// of the map run several steps back to back while they are in cache, on a copy with a halo as wide
+// as the steps (overlapped tiling), so the result equals one full sweep per step.
+class HeightErosion
+{
+public:
+	typedef struct hydraulic_param_t {
+		hydraulic_param_t() : iterations(200), timeStep(0.05f), rain(0.01f), capacity(1.5f),
+			dissolving(0.3f), deposition(0.3f), evaporation(0.02f), minTilt(0.02f), fullDepth(1.0f), heightScale(256.0f) {}
+		int iterations;
+		float timeStep;
+		// Water added per pixel and time unit, in pixels
+		float rain;
+		// Sediment a unit of water carries per unit of speed and sine of the slope
+		float capacity;
+		// Share of the capacity difference dissolved or deposited per time unit
+		float dissolving;
+		float deposition;
+		// Share of the water evaporating per time unit
+		float evaporation;
+		// Flat ground still carries sediment, as if it had this slope (sine)
+		float minTilt;
+		// Water shallower than this carries proportionally less, in pixels
+		float fullDepth;
+		// Height of a 1.0 sample in pixels
+		float heightScale;
+	}hydraulic_param_t;
+
+	typedef struct thermal_param_t {
+		thermal_param_t() : iterations(50), talus(2.0f), strength(0.5f), heightScale(256.0f) {}
+		int iterations;
+		// Steepest stable slope, height over distance in pixels (tangent of the angle of repose)
+		float talus;
+		// Share of the excess moved per step, 0 - 1
+		float strength;
+		// Height of a 1.0 sample in pixels
+		float heightScale;
+	}thermal_param_t;
+
+	HeightErosion();
+
+	// Enable the stage with the given params. Hydraulic runs before thermal
+	void setHydraulic(const hydraulic_param_t &params);
+	void setThermal(const thermal_param_t &params);
+	void clearStages();
+
+	inline bool enabled() const {
+		return m_hydraulicEnabled || m_thermalEnabled;
+	}
+	inline bool hydraulicEnabled() const {
+		return m_hydraulicEnabled;
+	}
+	inline bool thermalEnabled() const {
+		return m_thermalEnabled;
+	}
+	inline const hydraulic_param_t &hydraulic() const {
+		return m_hydraulic;
+	}
+	inline const thermal_param_t &thermal() const {
+		return m_thermal;
+	}
+
+	// Runs the enabled stages on resolution x resolution heights in 0 - 1, on up to threadCount threads,
+	// 0 uses every hardware thread. False when a stage rejects its params or the map: hydraulic needs a
+	// positive timeStep, fullDepth and heightScale and at most INT_MAX pixels, thermal a positive
+	// heightScale, talus of 0 or more and strength in 0 - 1. The heights are then left partly eroded
+	bool apply(float *heights, const int resolution, const int threadCount = 0) const;
+
+	static bool Hydraulic(float *heights, const int resolution, const hydraulic_param_t &params, const int threadCount = 0);
+	static bool Thermal(float *heights, const int resolution, const thermal_param_t &params, const int threadCount = 0);
+
+private:
+	bool m_hydraulicEnabled;
+	hydraulic_param_t m_hydraulic;
+	bool m_thermalEnabled;
+	thermal_param_t m_thermal;
+};
+
+#endif
@@ -0,0 +1,586 @@
+/****************************************************************
+* Name:       heightfarm.cpp
+* Purpose:    Tile farm generating a map on worker processes
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heightfarm.h"
+#include "heightgraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET SocketType;
+#define CloseSocket closesocket
+#define FARM_SHUTDOWN SD_BOTH
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+typedef int SocketType;
+#define CloseSocket ::close
+#define INVALID_SOCKET (-1)
+#define FARM_SHUTDOWN SHUT_RDWR
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define FARM_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define FARM_SEND_FLAGS 0
+#endif
+
+
+static const unsigned int FARM_PROTOCOL_VERSION = 1;
+static const char FARM_MAGIC[3] = { 'H','T','F' };
+static const unsigned char FARM_FILE_VERSION = 1;
+static const char FARM_FILE_MAGIC[3] = { 'H','T','M' };
+// Version, magic, resolution, tile size, format and seed, the offset table follows
+static const long long FARM_FILE_HEADER = 1 + 3 + 4 + 4 + 2 + 4;
+// Largest message payload accepted
+static const unsigned int FARM_MAX_MESSAGE = 1u << 30;
+// Interval the coordinator checks for new workers and the end of the run
+static const int FARM_POLL_MS = 100;
+
+enum FarmMessage : unsigned int {
+	FarmMessageHello = 0,
+	FarmMessageJob,
+	FarmMessageResult,
+	FarmMessageDone
+};
+
+static void StartSockets()
+{
+#ifdef _WIN32
+	static const bool started = []() {
+		WSADATA data;
+		return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	}();
+	(void)started;
+#endif
+}
+
+static void SetTimeout(const SocketType socket, const int seconds)
+{
+#ifdef _WIN32
+	const DWORD ms = DWORD(seconds) * 1000;
+	setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&ms), sizeof(ms));
+	setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char *>(&ms), sizeof(ms));
+#else
+	timeval tv;
+	tv.tv_sec = seconds;
+	tv.tv_usec = 0;
+	setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#endif
+}
+
+static void SetNoDelay(const SocketType socket)
+{
+	const int on = 1;
+	setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&on), sizeof(on));
+#ifdef SO_NOSIGPIPE
+	setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, reinterpret_cast<const char *>(&on), sizeof(on));
+#endif
+}
+
+static bool SendAll(const SocketType socket, const unsigned char *data, size_t size)
+{
+	while (size) {
+		const int sent = (int)send(socket, reinterpret_cast<const char *>(data), (int)std::min(size, size_t(1) << 20), FARM_SEND_FLAGS);
+		if (sent <= 0)
+			return false;
+		data += sent;
+		size -= size_t(sent);
+	}
+	return true;
+}
+
+static bool RecvAll(const SocketType socket, unsigned char *data, size_t size)
+{
+	while (size) {
+		const int received = (int)recv(socket, reinterpret_cast<char *>(data), (int)std::min(size, size_t(1) << 20), 0);
+		if (received <= 0)
+			return false;
+		data += received;
+		size -= size_t(received);
+	}
+	return true;
+}
+
+static bool SendMessage(const SocketType socket, const FarmMessage type, const std::vector<unsigned char> &payload)
+{
+	unsigned int header[2] = { (unsigned int)type, (unsigned int)payload.size() };
+	return SendAll(socket, reinterpret_cast<const unsigned char *>(header), sizeof(header)) &&
+		   (payload.empty() || SendAll(socket, payload.data(), payload.size()));
+}
+
+static bool RecvMessage(const SocketType socket, unsigned int &type, std::vector<unsigned char> &payload)
+{
+	unsigned int header[2];
+	if (!RecvAll(socket, reinterpret_cast<unsigned char *>(header), sizeof(header)) || header[1] > FARM_MAX_MESSAGE)
+		return false;
+	type = header[0];
+	payload.resize(header[1]);
+	return payload.empty() || RecvAll(socket, payload.data(), payload.size());
+}
+
+template<typename T>
+static void Put(std::vector<unsigned char> &out, const T &value)
+{
+	const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+static bool Get(const std::vector<unsigned char> &in, size_t &at, T &value)
+{
+	if (in.size() < sizeof(T) || at > in.size() - sizeof(T))
+		return false;
+	memcpy(&value, in.data() + at, sizeof(T));
+	at += sizeof(T);
+	return true;
+}
+
+// The params that reach generateRegion(), the graph by its nodes
+static void PutParams(std::vector<unsigned char> &out, const HeightGenerator::height_map_param_t &params)
+{
+	Put(out, params.resolution);
+	Put(out, params.gain);
+	Put(out, params.octaves);
+	Put(out, params.scale);
+	Put(out, params.ridgedGainOffset);
+	Put(out, params.worleyGainOffset);
+	Put(out, params.warpStrength);
+	Put(out, params.warpFrequency);
+	Put(out, params.warpOctaves);
+	Put(out, (short)params.sampleFormat);
+	const int nodeCount = params.graph ? (int)params.graph->nodes().size() : 0;
+	Put(out, nodeCount);
+	if (params.graph) {
+		Put(out, params.graph->output());
+		for (const HeightGraph::node_t &node : params.graph->nodes()) {
+			Put(out, (short)node.type);
+			for (int i = 0; i < 3; ++i)
+				Put(out, node.inputs[i]);
+			Put(out, node.frequency);
+			Put(out, node.gainOffset);
+			Put(out, node.lacunarity);
+			Put(out, node.ridgeOffset);
+			Put(out, node.octaves);
+			Put(out, node.a);
+			Put(out, node.b);
+		}
+	}
+}
+
+static bool GetParams(const std::vector<unsigned char> &in, size_t &at, HeightGenerator::height_map_param_t &params,
+					  HeightGraph &graph)
+{
+	short format = 0;
+	int nodeCount = 0;
+	bool ok = Get(in, at, params.resolution) && Get(in, at, params.gain) && Get(in, at, params.octaves) &&
+			  Get(in, at, params.scale) && Get(in, at, params.ridgedGainOffset) && Get(in, at, params.worleyGainOffset) &&
+			  Get(in, at, params.warpStrength) && Get(in, at, params.warpFrequency) && Get(in, at, params.warpOctaves) &&
+			  Get(in, at, format) && Get(in, at, nodeCount);
+	params.sampleFormat = (HeightGenerator::SampleFormat)format;
+	params.graph = nullptr;
+	if (!ok || nodeCount < 0 || !HeightGenerator::SampleFormatBytes(params.sampleFormat))
+		return false;
+	if (!nodeCount)
+		return true;
+
+	int output = -1;
+	graph = HeightGraph();
+	ok = Get(in, at, output);
+	for (int n = 0; ok && n < nodeCount; ++n) {
+		HeightGraph::node_t node;
+		short type = 0;
+		ok = Get(in, at, type) && Get(in, at, node.inputs[0]) && Get(in, at, node.inputs[1]) && Get(in, at, node.inputs[2]) &&
+			 Get(in, at, node.frequency) && Get(in, at, node.gainOffset) && Get(in, at, node.lacunarity) &&
+			 Get(in, at, node.ridgeOffset) && Get(in, at, node.octaves) && Get(in, at, node.a) && Get(in, at, node.b);
+		node.type = (HeightGraph::NodeType)type;
+		if (ok)
+			graph.addNode(node);
+	}
+	if (!ok)
+		return false;
+	graph.setOutput(output);
+	if (!graph.compile())
+		return false;
+	params.graph = &graph;
+	return true;
+}
+
+static bool Seek(FILE *fp, const long long offset)
+{
+#ifdef _MSC_VER
+	return _fseeki64(fp, offset, SEEK_SET) == 0;
+#else
+	return fseeko(fp, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static long long FileEnd(FILE *fp)
+{
+#ifdef _MSC_VER
+	return _fseeki64(fp, 0, SEEK_END) == 0 ? _ftelli64(fp) : -1;
+#else
+	return fseeko(fp, 0, SEEK_END) == 0 ? (long long)ftello(fp) : -1;
+#endif
+}
+
+HeightTileFarm::HeightTileFarm() : m_listener((long long)INVALID_SOCKET), m_port(0)
+{
+}
+
+HeightTileFarm::~HeightTileFarm()
+{
+	close();
+}
+
+void HeightTileFarm::close()
+{
+	if (m_listener != (long long)INVALID_SOCKET)
+		CloseSocket((SocketType)m_listener);
+	m_listener = (long long)INVALID_SOCKET;
+	m_port = 0;
+}
+
+bool HeightTileFarm::listen(const unsigned short port)
+{
+	close();
+	StartSockets();
+	const SocketType listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listener == INVALID_SOCKET)
+		return false;
+	const int on = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&on), sizeof(on));
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	socklen_t length = sizeof(address);
+	if (bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0 ||
+		getsockname(listener, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+		CloseSocket(listener);
+		return false;
+	}
+	m_listener = (long long)listener;
+	m_port = ntohs(address.sin_port);
+	return true;
+}
+
+bool HeightTileFarm::run(const unsigned int seed, const HeightGenerator::height_map_param_t &params, const int tileSize,
+						 const std::string &path, const int workerTimeout, const int maxAttempts)
+{
+	m_stats = stats_t();
+	const int bytes = HeightGenerator::SampleFormatBytes(params.sampleFormat);
+	if (m_listener == (long long)INVALID_SOCKET || params.resolution < 1 || tileSize < 1 || !bytes || workerTimeout < 1 ||
+		maxAttempts < 1)
+		return false;
+	const int tilesPerSide = (params.resolution - 1) / tileSize + 1;
+	if ((long long)tilesPerSide * tilesPerSide > (1 << 24))
+		return false;
+	const int tiles = tilesPerSide * tilesPerSide;
+
+	FILE *fp = fopen(path.c_str(), "wb");
+	if (!fp)
+		return false;
+	const short format = (short)params.sampleFormat;
+	int errors = fwrite(&FARM_FILE_VERSION, sizeof(FARM_FILE_VERSION), 1, fp) != 1;
+	if (!errors) errors += fwrite(FARM_FILE_MAGIC, sizeof(FARM_FILE_MAGIC), 1, fp) != 1;
+	if (!errors) errors += fwrite(&params.resolution, sizeof(params.resolution), 1, fp) != 1;
+	if (!errors) errors += fwrite(&tileSize, sizeof(tileSize), 1, fp) != 1;
+	if (!errors) errors += fwrite(&format, sizeof(format), 1, fp) != 1;
+	if (!errors) errors += fwrite(&seed, sizeof(seed), 1, fp) != 1;
+	const std::vector<unsigned long long> offsets(tiles, 0);
+	if (!errors) errors += fwrite(offsets.data(), sizeof(unsigned long long) * offsets.size(), 1, fp) != 1;
+	if (errors) {
+		fclose(fp);
+		return false;
+	}
+
+	// Every job is the tile and its rectangle followed by the same seed and params
+	std::vector<unsigned char> jobParams;
+	Put(jobParams, seed);
+	PutParams(jobParams, params);
+
+	std::mutex lock;
+	std::condition_variable changed;
+	std::deque<int> pending;
+	for (int t = 0; t < tiles; ++t)
+		pending.push_back(t);
+	std::vector<int> attempts(tiles, 0);
+	bool failed = false, finished = false;
+	int connected = 0;
+	std::vector<SocketType> live;
+	m_stats.tiles = tiles;
+
+	auto serve = [&](const SocketType socket) {
+		std::vector<unsigned char> message;
+		unsigned int type = 0;
+		size_t at = 0;
+		char magic[3] = { 0, 0, 0 };
+		unsigned int version = 0;
+		bool ok = RecvMessage(socket, type, message) && type == FarmMessageHello && Get(message, at, magic) &&
+				  Get(message, at, version) && !memcmp(magic, FARM_MAGIC, sizeof(magic)) && version == FARM_PROTOCOL_VERSION;
+		while (ok) {
+			int tile = -1;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				changed.wait(guard, [&]() { return finished || failed || !pending.empty(); });
+				if (finished || failed)
+					break;
+				tile = pending.front();
+				pending.pop_front();
+				m_stats.redispatched += attempts[tile] > 0;
+				++m_stats.dispatched;
+				++attempts[tile];
+			}
+
+			const int tx = tile % tilesPerSide, ty = tile / tilesPerSide;
+			const int x = tx * tileSize, y = ty * tileSize;
+			const int width = std::min(tileSize, params.resolution - x), height = std::min(tileSize, params.resolution - y);
+			message.clear();
+			Put(message, tile);
+			Put(message, x);
+			Put(message, y);
+			Put(message, width);
+			Put(message, height);
+			message.insert(message.end(), jobParams.begin(), jobParams.end());
+
+			int resultTile = -1, resultWidth = 0, resultHeight = 0;
+			short resultFormat = -1;
+			at = 0;
+			ok = SendMessage(socket, FarmMessageJob, message) && RecvMessage(socket, type, message) &&
+				 type == FarmMessageResult && Get(message, at, resultTile) && Get(message, at, resultWidth) &&
+				 Get(message, at, resultHeight) && Get(message, at, resultFormat) && resultTile == tile &&
+				 resultWidth == width && resultHeight == height && resultFormat == format &&
+				 message.size() - at == size_t(width) * size_t(height) * size_t(bytes);
+
+			std::lock_guard<std::mutex> guard(lock);
+			if (!ok) {
+				// The tile goes to the next worker first
+				++m_stats.workersLost;
+				if (attempts[tile] >= maxAttempts)
+					failed = true;
+				else
+					pending.push_front(tile);
+				changed.notify_all();
+				break;
+			}
+			const unsigned long long offset = (unsigned long long)FileEnd(fp);
+			int writeErrors = offset == ~0ULL;
+			if (!writeErrors) writeErrors += fwrite(message.data() + at, message.size() - at, 1, fp) != 1;
+			if (!writeErrors) writeErrors += !Seek(fp, FARM_FILE_HEADER + (long long)tile * (long long)sizeof(offset));
+			if (!writeErrors) writeErrors += fwrite(&offset, sizeof(offset), 1, fp) != 1;
+			if (!writeErrors) writeErrors += fflush(fp) != 0;
+			failed = failed || writeErrors;
+			++m_stats.completed;
+			changed.notify_all();
+		}
+
+		if (ok)
+			SendMessage(socket, FarmMessageDone, std::vector<unsigned char>());
+		std::lock_guard<std::mutex> guard(lock);
+		live.erase(std::find(live.begin(), live.end(), socket));
+		CloseSocket(socket);
+		--connected;
+		changed.notify_all();
+	};
+
+	std::vector<std::thread> workers;
+	std::chrono::steady_clock::time_point lastWorker = std::chrono::steady_clock::now();
+	const SocketType listener = (SocketType)m_listener;
+	for (;;) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if (connected)
+				lastWorker = now;
+			if (m_stats.completed == tiles || failed ||
+				std::chrono::duration_cast<std::chrono::seconds>(now - lastWorker).count() >= workerTimeout) {
+				failed = failed || m_stats.completed != tiles;
+				finished = true;
+				// Unblocks workers still waiting on a result, idle ones are told they are done
+				if (failed) {
+					for (const SocketType socket : live)
+						shutdown(socket, FARM_SHUTDOWN);
+				}
+				changed.notify_all();
+				break;
+			}
+		}
+
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET(listener, &readable);
+		timeval wait;
+		wait.tv_sec = 0;
+		wait.tv_usec = FARM_POLL_MS * 1000;
+		if (select((int)listener + 1, &readable, nullptr, nullptr, &wait) <= 0)
+			continue;
+		const SocketType socket = accept(listener, nullptr, nullptr);
+		if (socket == INVALID_SOCKET)
+			continue;
+		SetTimeout(socket, workerTimeout);
+		SetNoDelay(socket);
+		std::lock_guard<std::mutex> guard(lock);
+		live.push_back(socket);
+		++connected;
+		++m_stats.workersConnected;
+		workers.push_back(std::thread(serve, socket));
+	}
+	for (auto & worker : workers)
+		worker.join();
+	errors = fclose(fp) != 0;
+	return !failed && !errors;
+}
+
+bool HeightTileFarm::Work(const std::string &host, const unsigned short port)
+{
+	StartSockets();
+	addrinfo hints, *found = nullptr;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0)
+		return false;
+	SocketType socket = INVALID_SOCKET;
+	for (addrinfo *candidate = found; candidate && socket == INVALID_SOCKET; candidate = candidate->ai_next) {
+		socket = ::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+		if (socket != INVALID_SOCKET && connect(socket, candidate->ai_addr, (int)candidate->ai_addrlen) != 0) {
+			CloseSocket(socket);
+			socket = INVALID_SOCKET;
+		}
+	}
+	freeaddrinfo(found);
+	if (socket == INVALID_SOCKET)
+		return false;
+	SetNoDelay(socket);
+
+	std::vector<unsigned char> message;
+	message.insert(message.end(), FARM_MAGIC, FARM_MAGIC + sizeof(FARM_MAGIC));
+	Put(message, FARM_PROTOCOL_VERSION);
+	bool ok = SendMessage(socket, FarmMessageHello, message);
+
+	// The graph is compiled again only when the params change between jobs
+	HeightGenerator::height_map_param_t params;
+	HeightGraph graph;
+	std::vector<unsigned char> lastParams, samples;
+	bool done = false;
+	while (ok && !done) {
+		unsigned int type = 0;
+		ok = RecvMessage(socket, type, message);
+		if (!ok || type == FarmMessageDone) {
+			done = ok;
+			break;
+		}
+		int tile = 0, x = 0, y = 0, width = 0, height = 0;
+		unsigned int seed = 0;
+		size_t at = 0;
+		ok = type == FarmMessageJob && Get(message, at, tile) && Get(message, at, x) && Get(message, at, y) &&
+			 Get(message, at, width) && Get(message, at, height) && Get(message, at, seed) && width > 0 && height > 0;
+		if (ok && (lastParams.size() != message.size() - at || memcmp(lastParams.data(), message.data() + at, lastParams.size()))) {
+			lastParams.assign(message.begin() + at, message.end());
+			ok = GetParams(message, at, params, graph);
+			if (!ok)
+				lastParams.clear();
+		}
+		if (!ok)
+			break;
+
+		samples.resize(size_t(width) * size_t(height) * HeightGenerator::SampleFormatBytes(params.sampleFormat));
+		ok = HeightGenerator::generateRegion(seed, params, x, y, width, height, samples.data());
+		message.clear();
+		Put(message, tile);
+		Put(message, width);
+		Put(message, height);
+		Put(message, (short)params.sampleFormat);
+		message.insert(message.end(), samples.begin(), samples.end());
+		ok = ok && SendMessage(socket, FarmMessageResult, message);
+	}
+	CloseSocket(socket);
+	return done;
+}
+
+// Header of a farm output file, tilesPerSide from it
+static FILE *OpenFarmFile(const std::string &path, int &resolution, int &tileSize, short &format)
+{
+	FILE *fp = fopen(path.c_str(), "rb");
+	if (!fp)
+		return nullptr;
+	unsigned char version = 0;
+	char magic[3] = { 0, 0, 0 };
+	unsigned int seed = 0;
+	int errors = fread(&version, sizeof(version), 1, fp) != 1;
+	if (!errors) errors += fread(magic, sizeof(magic), 1, fp) != 1;
+	if (!errors) errors += fread(&resolution, sizeof(resolution), 1, fp) != 1;
+	if (!errors) errors += fread(&tileSize, sizeof(tileSize), 1, fp) != 1;
+	if (!errors) errors += fread(&format, sizeof(format), 1, fp) != 1;
+	if (!errors) errors += fread(&seed, sizeof(seed), 1, fp) != 1;
+	if (errors || version != FARM_FILE_VERSION || memcmp(magic, FARM_FILE_MAGIC, sizeof(magic)) || resolution < 1 ||
+		tileSize < 1 || !HeightGenerator::SampleFormatBytes((HeightGenerator::SampleFormat)format)) {
+		fclose(fp);
+		return nullptr;
+	}
+	return fp;
+}
+
+bool HeightTileFarm::ReadInfo(const std::string &path, int &resolution, int &tileSize, HeightGenerator::SampleFormat &format)
+{
+	short fileFormat = 0;
+	FILE *fp = OpenFarmFile(path, resolution, tileSize, fileFormat);
+	if (!fp)
+		return false;
+	format = (HeightGenerator::SampleFormat)fileFormat;
+	fclose(fp);
+	return true;
+}
+
+bool HeightTileFarm::ReadTile(const std::string &path, const int tx, const int ty, HeightTileCache::tile_t &tile)
+{
+	int resolution = 0, tileSize = 0;
+	short format = 0;
+	FILE *fp = OpenFarmFile(path, resolution, tileSize, format);
+	if (!fp)
+		return false;
+	const int tilesPerSide = (resolution - 1) / tileSize + 1;
+	unsigned long long offset = 0;
+	int errors = tx < 0 || ty < 0 || tx >= tilesPerSide || ty >= tilesPerSide;
+	if (!errors) errors += !Seek(fp, FARM_FILE_HEADER + ((long long)tx + (long long)ty * tilesPerSide) * (long long)sizeof(offset));
+	if (!errors) errors += fread(&offset, sizeof(offset), 1, fp) != 1;
+	if (!errors) errors += !offset || !Seek(fp, (long long)offset);
+	if (!errors) {
+		tile.x = tx * tileSize;
+		tile.y = ty * tileSize;
+		tile.width = std::min(tileSize, resolution - tile.x);
+		tile.height = std::min(tileSize, resolution - tile.y);
+		tile.format = (HeightGenerator::SampleFormat)format;
+		tile.samples.resize(size_t(tile.width) * size_t(tile.height) * HeightGenerator::SampleFormatBytes(tile.format));
+		errors += fread(tile.samples.data(), tile.samples.size(), 1, fp) != 1;
+	}
+	fclose(fp);
+	return !errors;
+}
@@ -0,0 +1,82 @@
+/****************************************************************
+* Name:       heightfarm.h
+* Purpose:    Tile farm generating a map on worker processes
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_FARM_H
+#define HEIGHT_FARM_H
+
+#include <string>
+
+#include "heightgenerator.h"
+#include "heighttilecache.h"
+
+// Generates a map too large for one machine on worker processes. The coordinator listens on a TCP port,
+// workers on this or other hosts connect with Work() and are handed one tile at a time. A worker sends
+// the tile back (HeightGenerator::generateRegion()) and gets the next one until the map is done. A
+// worker that disconnects or does not answer in time is dropped and its tile handed to another, a tile
+// that fails maxAttempts times fails the run.
+//
+// Messages are a type and a byte count followed by the payload, in the byte order of the hosts (little
+// endian). Floats travel as their bits and seeding is portable, so every worker writes the same samples
+// as a local generateRegion().
+//
+// Tiles are written to one file as they arrive: a header, a table of file offsets, one per tile, and the
+// row major samples of each tile in arrival order. An offset stays 0 until its tile is written
+class HeightTileFarm
+{
+public:
+	typedef struct stats_t {
+		stats_t() : tiles(0), completed(0), dispatched(0), redispatched(0), workersConnected(0), workersLost(0) {}
+		int tiles;
+		int completed;
+		// Jobs sent, redispatched of them for tiles that were sent before
+		int dispatched;
+		int redispatched;
+		int workersConnected;
+		// Disconnected or timed out with a tile
+		int workersLost;
+	}stats_t;
+
+	HeightTileFarm();
+	~HeightTileFarm();
+
+	// Coordinator. Listens on every interface, port 0 picks a free port, see port()
+	bool listen(const unsigned short port = 0);
+	inline unsigned short port() const {
+		return m_port;
+	}
+	// Hands every tile of the map to the connected workers and writes them to path, blocks until done.
+	// Fails when a tile failed maxAttempts times, a worker has not answered a job in workerTimeout
+	// seconds counts as failed. Also fails after workerTimeout seconds without any worker connected.
+	// Erosion, normals and channels are not applied, see generateRegion()
+	bool run(const unsigned int seed, const HeightGenerator::height_map_param_t &params, const int tileSize,
+			 const std::string &path, const int workerTimeout = 60, const int maxAttempts = 4);
+	inline const stats_t &stats() const {
+		return m_stats;
+	}
+
+	// Worker. Generates the tiles of the coordinator at host, port until it is done. False when the
+	// connection failed or broke
+	static bool Work(const std::string &host, const unsigned short port);
+
+	// Reads the size of a farm output file
+	static bool ReadInfo(const std::string &path, int &resolution, int &tileSize, HeightGenerator::SampleFormat &format);
+	// Reads tile tx, ty of a farm output file, false while it is missing
+	static bool ReadTile(const std::string &path, const int tx, const int ty, HeightTileCache::tile_t &tile);
+
+private:
+	void close();
+
+	// Listening socket, a SOCKET on Windows
+	long long m_listener;
+	unsigned short m_port;
+	stats_t m_stats;
+};
+
+#endif
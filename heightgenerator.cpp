@@ -8,6 +8,12 @@
 ****************************************************************/
 
 #include "heightgenerator.h"
+#include "heightgraph.h"
+#include "heightquadtree.h"
+#include "heighterosion.h"
+#include "heightblock.h"
+#include "heightcodec.h"
+#include "heighttilecache.h"
 
 #define GLM_FORCE_SWIZZLE 
 #pragma warning(push, 0)
@@ -15,13 +21,20 @@
 #include "Simplex.h"
 #pragma warning(pop)
 
+#include <algorithm>
 #include <chrono>
 #include <climits>
+#include <cstring>
 #include <random>
 
 
-static const unsigned char HEIGHT_DATA_FILE_VERSION = 1;
+static const unsigned char HEIGHT_DATA_FILE_VERSION = 2;
+// HeightCodec encoded samples
+static const unsigned char HEIGHT_DATA_FILE_VERSION_CODEC = 3;
 static const char HEIGHT_DATA_FILE_MAGIC[3] = { 'H','D','F' };
+// Checkpoint journal: a header, then a record of each finished band of rows in the order they finished
+static const unsigned char CHECKPOINT_FILE_VERSION = 1;
+static const char CHECKPOINT_FILE_MAGIC[3] = { 'H','C','J' };
 
 //#define USE_DEVIL_LIBRARY
 
@@ -37,7 +50,7 @@ static const char HEIGHT_DATA_FILE_MAGIC[3] = { 'H','D','F' };
 #endif
 
 static std::random_device EntropySrc;
-static std::mt19937 RandGen(EntropySrc());
+static std::mt19937 RandGen(EntropySrc());
 
 // If you already uses the image library somewhere else in the code, uncomment this line
 // #define DEVIL_INIT_ELSEWHERE
@@ -67,12 +80,809 @@ static inline void Wait(const int duration, const DurationType durationType = Du
 	}
 }
 
+// Stride of the cached per pixel layer state, in floats
+static const int LAYER_STATE_STRIDE[3] = { 3, 2, 1 };
+
+// Resumable versions of the three terrain layers. Each evaluates octaves [fromOctave, toOctave)
+// on top of the partial sums in state, the float operations match Simplex::iqMatfBmEx,
+// Simplex::ridgedMF and Simplex::worleyfBm so resumed sums are bit identical to a full evaluation
+
+// state: sum, accumulated derivative x, y
+static inline void IqLayerOctaves(const glm::vec2 &v, const int fromOctave, const int toOctave,
+								  const glm::mat2 &mat, const float gain, float *state)
+{
+	const float lacunarity = 0.9;
+	glm::vec2 pos = v;
+	float amp = 1.0;
+	for (int i = 0; i < fromOctave; i++) {
+		amp *= gain;
+		pos *= lacunarity;
+		pos = mat * pos;
+	}
+	float sum = state[0];
+	glm::vec2 d = glm::vec2(state[1], state[2]);
+	for (int i = fromOctave; i < toOctave; i++) {
+		glm::vec3 n = Simplex::dnoise(pos);
+		d += glm::vec2(n.xy);
+		sum += n.z*amp / (1.0 + glm::dot(d, d));
+		amp *= gain;
+		pos *= lacunarity;
+		pos = mat * pos;
+	}
+	state[0] = sum;
+	state[1] = d.x;
+	state[2] = d.y;
+}
+
+// state: sum, previous octave
+static inline void RidgedLayerOctaves(const glm::vec2 &v, const int fromOctave, const int toOctave,
+									  const float ridgeOffset, const float lacunarity, const float gain, float *state)
+{
+	float freq = 1.0;
+	float amp = 0.5;
+	for (int i = 0; i < fromOctave; i++) {
+		freq *= lacunarity;
+		amp *= gain;
+	}
+	float sum = state[0];
+	float prev = state[1];
+	for (int i = fromOctave; i < toOctave; i++) {
+		float n = Simplex::details::ridge(Simplex::noise(v * freq), ridgeOffset);
+		sum += n*amp*prev;
+		prev = n;
+		freq *= lacunarity;
+		amp *= gain;
+	}
+	state[0] = sum;
+	state[1] = prev;
+}
+
+// state: sum
+static inline void WorleyLayerOctaves(const glm::vec2 &v, const int fromOctave, const int toOctave,
+									  const float lacunarity, const float gain, float *state)
+{
+	float freq = 1.0f;
+	float amp = 0.5f;
+	for (int i = 0; i < fromOctave; i++) {
+		freq *= lacunarity;
+		amp *= gain;
+	}
+	float sum = state[0];
+	for (int i = fromOctave; i < toOctave; i++) {
+		float n = Simplex::worleyNoise(v * freq);
+		sum += n*amp;
+		freq *= lacunarity;
+		amp *= gain;
+	}
+	state[0] = sum;
+}
+
+// Pixels evaluated per graph program pass, the registers of a tile stay in L1
+static const int GRAPH_TILE_PIXELS = 64;
+
+static inline glm::mat2 IqMatrix()
+{
+	return glm::mat2(2.3f, -1.5f, 1.5f, 2.3f);
+}
+
+static void GraphSourceTile(const HeightGraph::node_t &node, const HeightGenerator::height_map_param_t &hmp,
+							const glm::vec2 *positions, const int count, float *out)
+{
+	const float gain = hmp.gain + node.gainOffset;
+	const uint8_t octaves = (uint8_t)(node.octaves > 0 ? node.octaves : hmp.octaves);
+	const glm::mat2 iqMat = IqMatrix();
+
+	switch (node.type) {
+	case HeightGraph::NodeIq:
+		for (int k = 0; k < count; ++k)
+			out[k] = Simplex::iqMatfBmEx(positions[k] * node.frequency, octaves, iqMat, gain);
+		break;
+	case HeightGraph::NodeRidged:
+		for (int k = 0; k < count; ++k)
+			out[k] = Simplex::ridgedMF(positions[k] * node.frequency, node.ridgeOffset, octaves, node.lacunarity, gain);
+		break;
+	case HeightGraph::NodeWorley:
+		for (int k = 0; k < count; ++k)
+			out[k] = Simplex::worleyfBm(positions[k] * node.frequency, octaves, node.lacunarity, gain);
+		break;
+	case HeightGraph::NodeFbm:
+		for (int k = 0; k < count; ++k)
+			out[k] = Simplex::fBm(positions[k] * node.frequency, octaves, node.lacunarity, gain);
+		break;
+	default:
+		break;
+	}
+}
+
+// Sources evaluated in the current tile under the current seed. Programs sharing a source,
+// like the channels of one seed, evaluate it once
+static const int SOURCE_TILE_CACHE_ENTRIES = 8;
+
+typedef struct source_tile_cache_t {
+	int used;
+	HeightGraph::node_t nodes[SOURCE_TILE_CACHE_ENTRIES];
+	float values[SOURCE_TILE_CACHE_ENTRIES][GRAPH_TILE_PIXELS];
+}source_tile_cache_t;
+
+static inline bool SameSource(const HeightGraph::node_t &a, const HeightGraph::node_t &b, const int octaves)
+{
+	return a.type == b.type && a.frequency == b.frequency && a.gainOffset == b.gainOffset &&
+		   a.lacunarity == b.lacunarity && a.ridgeOffset == b.ridgeOffset &&
+		   (a.octaves > 0 ? a.octaves : octaves) == (b.octaves > 0 ? b.octaves : octaves);
+}
+
+static void SharedSourceTile(const HeightGraph::node_t &node, const HeightGenerator::height_map_param_t &hmp,
+							 const glm::vec2 *positions, const int count, float *out, source_tile_cache_t &sources)
+{
+	for (int i = 0; i < sources.used; ++i) {
+		if (SameSource(sources.nodes[i], node, hmp.octaves)) {
+			memcpy(out, sources.values[i], sizeof(float) * count);
+			return;
+		}
+	}
+	GraphSourceTile(node, hmp, positions, count, out);
+	if (sources.used < SOURCE_TILE_CACHE_ENTRIES) {
+		sources.nodes[sources.used] = node;
+		memcpy(sources.values[sources.used++], out, sizeof(float) * count);
+	}
+}
+
+// Runs the whole program over one tile, returns the output register
+static const float *GraphProgramTile(const HeightGraph &graph, const HeightGenerator::height_map_param_t &hmp,
+									 const glm::vec2 *positions, const int count, float *registers,
+									 source_tile_cache_t *sources)
+{
+	for (const auto & ins : graph.program()) {
+		float *dst = registers + ins.dst * GRAPH_TILE_PIXELS;
+		const float *a = registers + (ins.src[0] >= 0 ? ins.src[0] : 0) * GRAPH_TILE_PIXELS;
+		const float *b = registers + (ins.src[1] >= 0 ? ins.src[1] : 0) * GRAPH_TILE_PIXELS;
+		const float *t = registers + (ins.src[2] >= 0 ? ins.src[2] : 0) * GRAPH_TILE_PIXELS;
+		const float ca = ins.node.a;
+		const float cb = ins.node.b;
+
+		switch (ins.node.type) {
+		case HeightGraph::NodeIq:
+		case HeightGraph::NodeRidged:
+		case HeightGraph::NodeWorley:
+		case HeightGraph::NodeFbm:
+			if (sources)
+				SharedSourceTile(ins.node, hmp, positions, count, dst, *sources);
+			else
+				GraphSourceTile(ins.node, hmp, positions, count, dst);
+			break;
+		case HeightGraph::NodeConstant:
+			for (int k = 0; k < count; ++k) dst[k] = ca;
+			break;
+		case HeightGraph::NodeAdd:
+			for (int k = 0; k < count; ++k) dst[k] = a[k] + b[k];
+			break;
+		case HeightGraph::NodeSub:
+			for (int k = 0; k < count; ++k) dst[k] = a[k] - b[k];
+			break;
+		case HeightGraph::NodeMul:
+			for (int k = 0; k < count; ++k) dst[k] = a[k] * b[k];
+			break;
+		case HeightGraph::NodeMin:
+			for (int k = 0; k < count; ++k) dst[k] = glm::min(a[k], b[k]);
+			break;
+		case HeightGraph::NodeMax:
+			for (int k = 0; k < count; ++k) dst[k] = glm::max(a[k], b[k]);
+			break;
+		case HeightGraph::NodeLerp:
+			for (int k = 0; k < count; ++k) dst[k] = a[k] + (b[k] - a[k]) * t[k];
+			break;
+		case HeightGraph::NodeRemap:
+			for (int k = 0; k < count; ++k) dst[k] = a[k] * ca + cb;
+			break;
+		case HeightGraph::NodeAbs:
+			for (int k = 0; k < count; ++k) dst[k] = glm::abs(a[k]);
+			break;
+		case HeightGraph::NodeClamp:
+			for (int k = 0; k < count; ++k) dst[k] = glm::clamp(a[k], ca, cb);
+			break;
+		default:
+			break;
+		}
+	}
+	return registers + graph.outputRegister() * GRAPH_TILE_PIXELS;
+}
+
+// HeightGraph::FastPathLayerProduct, the product of the remapped built-in layers fused per pixel
+template<bool UseIq, bool UseRidged, bool UseWorley>
+static void LayerProductTile(const HeightGraph &graph, const HeightGenerator::height_map_param_t &hmp,
+							 const glm::vec2 *positions, const int count, float *out)
+{
+	const HeightGraph::node_t &iq = graph.fastPathLayer(HeightGraph::NodeIq);
+	const HeightGraph::node_t &ridged = graph.fastPathLayer(HeightGraph::NodeRidged);
+	const HeightGraph::node_t &worley = graph.fastPathLayer(HeightGraph::NodeWorley);
+	const uint8_t iqOctaves = (uint8_t)(iq.octaves > 0 ? iq.octaves : hmp.octaves);
+	const uint8_t ridgedOctaves = (uint8_t)(ridged.octaves > 0 ? ridged.octaves : hmp.octaves);
+	const uint8_t worleyOctaves = (uint8_t)(worley.octaves > 0 ? worley.octaves : hmp.octaves);
+	const glm::mat2 iqMat = IqMatrix();
+
+	for (int k = 0; k < count; ++k) {
+		float n = 1.0f;
+		if (UseIq) {
+			n = Simplex::iqMatfBmEx(positions[k] * iq.frequency, iqOctaves, iqMat, hmp.gain + iq.gainOffset) * iq.a + iq.b;
+		}
+		if (UseRidged) {
+			const float r = Simplex::ridgedMF(positions[k] * ridged.frequency, ridged.ridgeOffset, ridgedOctaves,
+											  ridged.lacunarity, hmp.gain + ridged.gainOffset) * ridged.a + ridged.b;
+			n = UseIq ? n * r : r;
+		}
+		if (UseWorley) {
+			const float w = Simplex::worleyfBm(positions[k] * worley.frequency, worleyOctaves,
+											   worley.lacunarity, hmp.gain + worley.gainOffset) * worley.a + worley.b;
+			n = UseIq || UseRidged ? n * w : w;
+		}
+		out[k] = n;
+	}
+}
+
+// Programs reading their sources through a source cache skip the fused kernels
+static const float *GraphTile(const HeightGraph &graph, const HeightGenerator::height_map_param_t &hmp,
+							  const glm::vec2 *positions, const int count, float *registers,
+							  source_tile_cache_t *sources = nullptr)
+{
+	if (!sources && graph.fastPath() == HeightGraph::FastPathLayerProduct) {
+		typedef void(*LayerProductFunc)(const HeightGraph &, const HeightGenerator::height_map_param_t &,
+										const glm::vec2 *, const int, float *);
+		static const LayerProductFunc kernels[8] = {
+			LayerProductTile<false, false, false>, LayerProductTile<true, false, false>,
+			LayerProductTile<false, true, false>, LayerProductTile<true, true, false>,
+			LayerProductTile<false, false, true>, LayerProductTile<true, false, true>,
+			LayerProductTile<false, true, true>, LayerProductTile<true, true, true>
+		};
+		const int mask = (graph.fastPathHasLayer(HeightGraph::NodeIq) ? 1 : 0) |
+						 (graph.fastPathHasLayer(HeightGraph::NodeRidged) ? 2 : 0) |
+						 (graph.fastPathHasLayer(HeightGraph::NodeWorley) ? 4 : 0);
+		kernels[mask](graph, hmp, positions, count, registers);
+		return registers;
+	}
+	return GraphProgramTile(graph, hmp, positions, count, registers, sources);
+}
+
+// The built-in terrain formula
+static inline float TerrainHeight(const glm::vec2 &position, const HeightGenerator::height_map_param_t &hmp)
+{
+	// World move "down" 0.50 to create water plane
+	float n = Simplex::iqMatfBmEx(position, (uint8_t)hmp.octaves, IqMatrix(), hmp.gain) * 0.5f;
+
+	n *= Simplex::ridgedMF(position, 1.0f, hmp.octaves, 2.0f, hmp.gain + hmp.ridgedGainOffset) * 0.5f + 0.5f;
+	n *= Simplex::worleyfBm(position, hmp.octaves, 2.0f, hmp.gain + hmp.worleyGainOffset) * 0.5f + 0.5f;
+	return n;
+}
+
+// Offset of the second warp component, decorrelates it from the first
+static const float WARP_OFFSET_X = 5.2f;
+static const float WARP_OFFSET_Y = 1.3f;
+
+static inline bool WarpEnabled(const HeightGenerator::height_map_param_t &hmp)
+{
+	return hmp.warpStrength != 0.0f && (uint8_t)hmp.warpOctaves > 0;
+}
+
+// Domain warped position, the warp field is two fBm sums (lacunarity 2, gain 0.5). With Derivatives
+// the Jacobian d(warped) / d(position) is returned too, from the analytic noise derivatives
+template<bool Derivatives>
+static inline glm::vec2 WarpPosition(const glm::vec2 &position, const HeightGenerator::height_map_param_t &hmp,
+									 glm::mat2 *jacobian = nullptr)
+{
+	const uint8_t octaves = (uint8_t)hmp.warpOctaves;
+	const glm::vec2 p0 = position * hmp.warpFrequency;
+	const glm::vec2 p1 = p0 + glm::vec2(WARP_OFFSET_X, WARP_OFFSET_Y);
+	glm::vec2 warp(0.0f);
+	glm::vec2 dx(0.0f), dy(0.0f);
+	float freq = 1.0f;
+	float amp = 0.5f;
+	for (uint8_t i = 0; i < octaves; i++) {
+		if (Derivatives) {
+			const glm::vec3 n0 = Simplex::noiseDerivatives(p0 * freq);
+			const glm::vec3 n1 = Simplex::noiseDerivatives(p1 * freq);
+			warp += glm::vec2(n0.x, n1.x) * amp;
+			dx += glm::vec2(n0.y, n0.z) * (amp * freq);
+			dy += glm::vec2(n1.y, n1.z) * (amp * freq);
+		}
+		else {
+			warp.x += Simplex::noise(p0 * freq) * amp;
+			warp.y += Simplex::noise(p1 * freq) * amp;
+		}
+		freq *= 2.0f;
+		amp *= 0.5f;
+	}
+	if (Derivatives) {
+		// Columns are d/dx and d/dy of the warped position
+		const float s = hmp.warpStrength * hmp.warpFrequency;
+		*jacobian = glm::mat2(1.0f + s * dx.x, s * dy.x, s * dx.y, 1.0f + s * dy.y);
+	}
+	return position + warp * hmp.warpStrength;
+}
+
+static inline void WarpTile(const HeightGenerator::height_map_param_t &hmp, glm::vec2 *positions, const int count)
+{
+	if (!WarpEnabled(hmp))
+		return;
+	for (int k = 0; k < count; ++k)
+		positions[k] = WarpPosition<false>(positions[k], hmp);
+}
+
+// Clamp to 0 - 1 on the bit pattern, float compares are not if-converted while they may trap
+static inline float ClampUnit(const float n)
+{
+	int32_t bits;
+	memcpy(&bits, &n, sizeof(bits));
+	bits = bits < 0 ? 0 : (bits > 0x3f800000 ? 0x3f800000 : bits);
+	float c;
+	memcpy(&c, &bits, sizeof(c));
+	return c;
+}
+
+static inline uint32_t FloatBits(const float n)
+{
+	uint32_t bits;
+	memcpy(&bits, &n, sizeof(bits));
+	return bits;
+}
+
+// floor(clamp(n, 0, 1) * (scale - 1)) for a power of two scale, the same result as the double
+// (unsigned short)(glm::clamp(double(n), 0.0, 1.0) * 65535.0) but free of branches and conversions.
+// a = c * scale is exact and c * (scale - 1) = a - c only drops below floor(a) when its fraction is
+// below c. floor(a) comes from the 2^23 rounding trick, non negative floats compare as integers
+static inline uint32_t QuantizeUnit(const float n, const float scale)
+{
+	const float c = ClampUnit(n);
+	const float a = c * scale;
+	const float magic = a + 8388608.0f;
+	const float rounded = magic - 8388608.0f;
+	const uint32_t up = FloatBits(rounded) > FloatBits(a) ? 1u : 0u;
+	const uint32_t integer = FloatBits(magic) - 0x4b000000u - up;
+	const float fraction = (a - rounded) + (up ? 1.0f : 0.0f);
+	return integer - (FloatBits(fraction) < FloatBits(c) ? 1u : 0u);
+}
+
+static inline unsigned short QuantizeHeight(const float n)
+{
+	return (unsigned short)QuantizeUnit(n, 65536.0f);
+}
+
+// Branch free binary16 rounding (to nearest even) for 0 - 1. Below 2^-14 the sum with 0.5 rounds
+// to the subnormal half spacing of 2^-24, above it the low 13 mantissa bits are rounded away
+static inline unsigned short UnitFloatToHalf(const float n)
+{
+	const float c = ClampUnit(n);
+	const uint32_t bits = FloatBits(c);
+	const uint32_t subnormalBits = FloatBits(c + 0.5f);
+	const uint32_t normal = (bits - 0x38000000u + 0x0fffu + ((bits >> 13) & 1u)) >> 13;
+	const uint32_t subnormalMask = 0u - (uint32_t)(bits < 0x38800000u);
+	return (unsigned short)(((subnormalBits - 0x3f000000u) & subnormalMask) | (normal & ~subnormalMask));
+}
+
+// Conversion stage of the generating threads, the loops carry no dependencies so they vectorize
+static void ConvertSamples(const HeightGenerator::SampleFormat format, const float *heights, const int count,
+						   unsigned char *out)
+{
+	switch (format) {
+	case HeightGenerator::SampleFormatUInt16: {
+		unsigned short *dst = reinterpret_cast<unsigned short *>(out);
+		for (int k = 0; k < count; ++k)
+			dst[k] = QuantizeHeight(heights[k]);
+		break;
+	}
+	case HeightGenerator::SampleFormatUInt8:
+		for (int k = 0; k < count; ++k)
+			out[k] = (unsigned char)QuantizeUnit(heights[k], 256.0f);
+		break;
+	case HeightGenerator::SampleFormatFloat32: {
+		float *dst = reinterpret_cast<float *>(out);
+		for (int k = 0; k < count; ++k)
+			dst[k] = ClampUnit(heights[k]);
+		break;
+	}
+	case HeightGenerator::SampleFormatFloat16: {
+		unsigned short *dst = reinterpret_cast<unsigned short *>(out);
+		for (int k = 0; k < count; ++k)
+			dst[k] = UnitFloatToHalf(heights[k]);
+		break;
+	}
+	}
+}
+
+// Converts a whole buffer, ConvertSamples takes an int count
+static void ConvertSampleBuffer(const HeightGenerator::SampleFormat format, const float *heights, const size_t count,
+								unsigned char *out)
+{
+	const size_t chunk = size_t(1) << 20;
+	const int bytes = HeightGenerator::SampleFormatBytes(format);
+	for (size_t begin = 0; begin < count; begin += chunk)
+		ConvertSamples(format, heights + begin, (int)std::min(chunk, count - begin), out + begin * bytes);
+}
+
+// Recently seeded permutation tables of the calling thread. Simplex keeps its table per thread and
+// every seeding in this file goes through SeedThread, so the active entry mirrors that table
+static const int SEED_CACHE_ENTRIES = 4;
+
+typedef struct seed_cache_t {
+	// Entry in the Simplex table, -1 while it holds the built-in table
+	int active;
+	int used;
+	uint32_t clock;
+	uint32_t seeds[SEED_CACHE_ENTRIES];
+	uint32_t lastUse[SEED_CACHE_ENTRIES];
+	Simplex::details::LutType perms[SEED_CACHE_ENTRIES][512];
+}seed_cache_t;
+
+static thread_local seed_cache_t SeedCache = { -1, 0, 0, {}, {}, {} };
+
+static void SeedThread(const uint32_t seed)
+{
+	seed_cache_t &cache = SeedCache;
+	++cache.clock;
+	if (cache.active >= 0 && cache.seeds[cache.active] == seed) {
+		cache.lastUse[cache.active] = cache.clock;
+		return;
+	}
+	for (int i = 0; i < cache.used; ++i) {
+		if (cache.seeds[i] == seed) {
+			memcpy(Simplex::details::perm, cache.perms[i], sizeof(cache.perms[i]));
+			cache.active = i;
+			cache.lastUse[i] = cache.clock;
+			return;
+		}
+	}
+
+	// Miss, seed and keep the table in a free or the least recently used entry
+	Simplex::seed(seed);
+	int slot = cache.used;
+	if (cache.used < SEED_CACHE_ENTRIES) {
+		++cache.used;
+	}
+	else {
+		slot = 0;
+		for (int i = 1; i < SEED_CACHE_ENTRIES; ++i) {
+			if (cache.lastUse[i] < cache.lastUse[slot])
+				slot = i;
+		}
+	}
+	memcpy(cache.perms[slot], Simplex::details::perm, sizeof(cache.perms[slot]));
+	cache.seeds[slot] = seed;
+	cache.lastUse[slot] = cache.clock;
+	cache.active = slot;
+}
+
+static const int SAMPLE_TILE_PIXELS = 64;
+
+// Collects the heights of a work set in order and converts them a tile at a time. Work sets are
+// row major runs, so a tile is normally a single contiguous store. Pixels are stride samples
+// apart, more than one for interleaved channels
+class SampleTileWriter
+{
+public:
+	SampleTileWriter(const HeightGenerator::height_map_param_t &hmp, unsigned char *data,
+					 const std::vector<std::pair<const int, const int>> &workSet, const int stride = 1) :
+		m_format(hmp.sampleFormat), m_resolution(hmp.resolution), m_bytes(HeightGenerator::SampleFormatBytes(hmp.sampleFormat)),
+		m_stride(stride), m_data(data), m_workSet(workSet), m_begin(0), m_count(0) {}
+	~SampleTileWriter() {
+		flush();
+	}
+
+	inline void push(const float height) {
+		m_heights[m_count++] = height;
+		if (m_count == SAMPLE_TILE_PIXELS)
+			flush();
+	}
+
+	void flush() {
+		if (!m_count)
+			return;
+		const size_t first = index(m_begin);
+		bool contiguous = m_stride == 1;
+		for (int k = 1; k < m_count && contiguous; ++k)
+			contiguous = index(m_begin + k) == first + k;
+		if (contiguous) {
+			ConvertSamples(m_format, m_heights, m_count, m_data + first * m_bytes);
+		}
+		else if (m_stride > 1) {
+			unsigned char converted[SAMPLE_TILE_PIXELS * 4];
+			ConvertSamples(m_format, m_heights, m_count, converted);
+			for (int k = 0; k < m_count; ++k)
+				memcpy(m_data + index(m_begin + k) * m_stride * m_bytes, converted + k * m_bytes, m_bytes);
+		}
+		else {
+			for (int k = 0; k < m_count; ++k)
+				ConvertSamples(m_format, m_heights + k, 1, m_data + index(m_begin + k) * m_bytes);
+		}
+		m_begin += m_count;
+		m_count = 0;
+	}
+
+private:
+	inline size_t index(const size_t i) const {
+		return size_t(m_workSet[i].first) + size_t(m_workSet[i].second) * size_t(m_resolution);
+	}
+
+	const HeightGenerator::SampleFormat m_format;
+	const int m_resolution;
+	const int m_bytes;
+	const size_t m_stride;
+	unsigned char *m_data;
+	const std::vector<std::pair<const int, const int>> &m_workSet;
+	size_t m_begin;
+	int m_count;
+	float m_heights[SAMPLE_TILE_PIXELS];
+};
+
+// Gradient (in noise space) carrying versions of the built-in layers. The returned values
+// match Simplex::iqMatfBmEx, Simplex::ridgedMF and Simplex::worleyfBm exactly
+static inline float IqLayerGradient(const glm::vec2 &v, const int octaves, const glm::mat2 &mat,
+									const float gain, glm::vec2 &gradient)
+{
+	const float lacunarity = 0.9;
+	glm::vec2 pos = v;
+	// Columns of d pos / d v
+	glm::vec2 col0 = glm::vec2(1.0f, 0.0f);
+	glm::vec2 col1 = glm::vec2(0.0f, 1.0f);
+	float amp = 1.0;
+	glm::vec2 d = glm::vec2(0.0);
+	// Gradients of d.x and d.y
+	glm::vec2 gdx = glm::vec2(0.0f);
+	glm::vec2 gdy = glm::vec2(0.0f);
+	float sum = 0.0;
+	gradient = glm::vec2(0.0f);
+	for (int i = 0; i < octaves; i++) {
+		glm::vec3 h;
+		glm::vec3 n = Simplex::dnoise(pos, h);
+		d += glm::vec2(n.xy);
+		// Chain the noise space derivatives back to v
+		gdx += glm::vec2(glm::dot(col0, glm::vec2(n.y, n.z)), glm::dot(col1, glm::vec2(n.y, n.z)));
+		gdy += glm::vec2(glm::dot(col0, glm::vec2(h.x, h.y)), glm::dot(col1, glm::vec2(h.x, h.y)));
+		const glm::vec2 gz = glm::vec2(glm::dot(col0, glm::vec2(h.y, h.z)), glm::dot(col1, glm::vec2(h.y, h.z)));
+
+		const double q = 1.0 + glm::dot(d, d);
+		sum += n.z*amp / q;
+		const glm::vec2 gq = (gdx * d.x + gdy * d.y) * 2.0f;
+		gradient += (gz * (float)q - gq * n.z) * (amp / (float)(q * q));
+
+		amp *= gain;
+		pos *= lacunarity;
+		pos = mat * pos;
+		col0 = mat * (col0 * lacunarity);
+		col1 = mat * (col1 * lacunarity);
+	}
+	return sum;
+}
+
+static inline float RidgedLayerGradient(const glm::vec2 &v, const int octaves, const float ridgeOffset,
+										const float lacunarity, const float gain, glm::vec2 &gradient)
+{
+	float sum = 0;
+	float freq = 1.0;
+	float amp = 0.5;
+	float prev = 1.0;
+	glm::vec2 gprev = glm::vec2(0.0f);
+	gradient = glm::vec2(0.0f);
+	for (int i = 0; i < octaves; i++) {
+		const glm::vec3 h = Simplex::noiseDerivatives(v * freq);
+		float n = Simplex::details::ridge(h.x, ridgeOffset);
+		const glm::vec2 gn = glm::vec2(h.y, h.z) * (freq * -2.0f * (ridgeOffset - glm::abs(h.x)) * glm::sign(h.x));
+		sum += n*amp*prev;
+		gradient += (gn * prev + gprev * n) * amp;
+		prev = n;
+		gprev = gn;
+		freq *= lacunarity;
+		amp *= gain;
+	}
+	return sum;
+}
+
+static inline float WorleyLayerGradient(const glm::vec2 &v, const int octaves, const float lacunarity,
+										const float gain, glm::vec2 &gradient)
+{
+	float sum = 0.0f;
+	float freq = 1.0f;
+	float amp = 0.5f;
+	gradient = glm::vec2(0.0f);
+	for (int i = 0; i < octaves; i++) {
+		const glm::vec3 w = Simplex::dWorleyNoise(v * freq);
+		sum += w.x*amp;
+		gradient += glm::vec2(w.y, w.z) * (freq * amp);
+		freq *= lacunarity;
+		amp *= gain;
+	}
+	return sum;
+}
+
+// TerrainHeight with its gradient per pixel
+static inline float TerrainHeightGradient(const glm::vec2 &position, const HeightGenerator::height_map_param_t &hmp,
+										  glm::vec2 &gradient)
+{
+	const int octaves = (uint8_t)hmp.octaves;
+	glm::vec2 gi, gr, gw;
+	const float a = IqLayerGradient(position, octaves, IqMatrix(), hmp.gain, gi) * 0.5f;
+	const float b = RidgedLayerGradient(position, octaves, 1.0f, 2.0f, hmp.gain + hmp.ridgedGainOffset, gr) * 0.5f + 0.5f;
+	const float c = WorleyLayerGradient(position, octaves, 2.0f, hmp.gain + hmp.worleyGainOffset, gw) * 0.5f + 0.5f;
+
+	float n = a;
+	n *= b;
+	n *= c;
+	// Product rule, the clamped water plane and peaks are flat
+	if (n < 0.0f || n > 1.0f)
+		gradient = glm::vec2(0.0f);
+	else
+		gradient = (gi * (b * c) + gr * (a * c) + gw * (a * b)) * (0.5f * hmp.scale);
+	return n;
+}
+
+static inline unsigned int PackUnorm(const float v, const float maxValue)
+{
+	return (unsigned int)(glm::clamp(v, 0.0f, 1.0f) * maxValue + 0.5f);
+}
+
+// Writes the normal or slope of a pixel, gradient is in heights per pixel
+static inline void EncodeNormal(const HeightGenerator::NormalOutput format, const glm::vec2 &gradient,
+								const float heightScale, unsigned char *out)
+{
+	const float pi = 3.14159265358979f;
+	const glm::vec2 g = gradient * heightScale;
+	float u, v;
+	if (format == HeightGenerator::NormalOutputOctahedral16 || format == HeightGenerator::NormalOutputOctahedral8) {
+		// Normal (-gx, -gy, 1) projected onto the octahedron, z is never negative for a height field
+		const float l1 = glm::abs(g.x) + glm::abs(g.y) + 1.0f;
+		u = -g.x / l1 * 0.5f + 0.5f;
+		v = -g.y / l1 * 0.5f + 0.5f;
+	}
+	else {
+		u = atanf(glm::length(g)) / (pi * 0.5f);
+		float aspect = atan2f(-g.y, -g.x);
+		if (aspect < 0.0f)
+			aspect += 2.0f * pi;
+		v = aspect / (2.0f * pi);
+	}
+	if (format == HeightGenerator::NormalOutputOctahedral16 || format == HeightGenerator::NormalOutputSlope16) {
+		unsigned short packed[2] = { (unsigned short)PackUnorm(u, 65535.0f), (unsigned short)PackUnorm(v, 65535.0f) };
+		memcpy(out, packed, sizeof(packed));
+	}
+	else {
+		out[0] = (unsigned char)PackUnorm(u, 255.0f);
+		out[1] = (unsigned char)PackUnorm(v, 255.0f);
+	}
+}
+
+static inline int NormalBytesPerPixel(const HeightGenerator::NormalOutput format)
+{
+	switch (format) {
+	case HeightGenerator::NormalOutputOctahedral16:
+	case HeightGenerator::NormalOutputSlope16:
+		return 4;
+	case HeightGenerator::NormalOutputOctahedral8:
+	case HeightGenerator::NormalOutputSlope8:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+// Normal output from float heights by central differences, for heights changed after the height pass.
+// The heights are clamped to 0 - 1 like the samples, so the water plane and peaks stay flat
+static void FiniteDifferenceNormals(const HeightGenerator::height_map_param_t &hmp, const float *heights,
+									unsigned char *normals)
+{
+	const int res = hmp.resolution;
+	const int normalBytes = NormalBytesPerPixel(hmp.normalOutput);
+	for (int y = 0; y < res; ++y) {
+		const int up = std::max(y - 1, 0), down = std::min(y + 1, res - 1);
+		for (int x = 0; x < res; ++x) {
+			const int left = std::max(x - 1, 0), right = std::min(x + 1, res - 1);
+			const glm::vec2 gradient(
+				(ClampUnit(heights[size_t(right) + size_t(y) * res]) - ClampUnit(heights[size_t(left) + size_t(y) * res])) / float(right - left),
+				(ClampUnit(heights[size_t(x) + size_t(down) * res]) - ClampUnit(heights[size_t(x) + size_t(up) * res])) / float(down - up));
+			EncodeNormal(hmp.normalOutput, gradient, hmp.normalHeightScale, normals + (size_t(x) + size_t(y) * res) * normalBytes);
+		}
+	}
+}
+
+// Octaves whose frequency stays below this many lattice cells per coarse step are multi-rate evaluated
+static const float MULTI_RATE_CELLS_PER_STEP = 0.1f;
+// Pixels compared against the exact formula, per axis
+static const int MULTI_RATE_ERROR_SAMPLES = 64;
+
+// Catmull-Rom weights
+static inline void CubicWeights(const float t, float *w)
+{
+	w[0] = ((-t + 2.0f) * t - 1.0f) * t * 0.5f;
+	w[1] = ((3.0f * t - 5.0f) * t * t + 2.0f) * 0.5f;
+	w[2] = ((-3.0f * t + 4.0f) * t + 1.0f) * t * 0.5f;
+	w[3] = (t - 1.0f) * t * t * 0.5f;
+}
+
+float HeightGenerator::evaluateAt(const unsigned int seed, const height_map_param_t &params, const float x, const float y)
+{
+	const float position[2] = { x, y };
+	float height = 0.0f;
+	height_map_param_t hmp = params;
+	hmp.sampleFormat = SampleFormatFloat32;
+	evaluateAt(seed, hmp, position, 1, &height);
+	return height;
+}
+
+bool HeightGenerator::evaluateAt(const unsigned int seed, const height_map_param_t &params, const float *positions,
+								 const int count, void *samples)
+{
+	if (!positions || !samples || count < 0 || !SampleFormatBytes(params.sampleFormat))
+		return false;
+
+	height_map_param_t hmp = params;
+	HeightGraph graph;
+	if (hmp.graph && !hmp.graph->compiled()) {
+		graph = *hmp.graph;
+		if (!graph.compile())
+			return false;
+		hmp.graph = &graph;
+	}
+
+	SeedThread(seed);
+
+	// Same per pixel operations as generationHeight, a tile at a time
+	const int bytes = SampleFormatBytes(hmp.sampleFormat);
+	unsigned char *out = static_cast<unsigned char *>(samples);
+	std::vector<float> registers(hmp.graph ? std::max(hmp.graph->registerCount(), 1) * GRAPH_TILE_PIXELS : 0);
+	glm::vec2 tile[GRAPH_TILE_PIXELS];
+	float heights[GRAPH_TILE_PIXELS];
+	for (int begin = 0; begin < count; begin += GRAPH_TILE_PIXELS) {
+		const int tileCount = std::min(count - begin, GRAPH_TILE_PIXELS);
+		for (int k = 0; k < tileCount; ++k)
+			tile[k] = glm::vec2(positions[(begin + k) * 2], positions[(begin + k) * 2 + 1]) * hmp.scale;
+		WarpTile(hmp, tile, tileCount);
+
+		const float *tileHeights = heights;
+		if (hmp.graph) {
+			tileHeights = GraphTile(*hmp.graph, hmp, tile, tileCount, registers.data());
+		}
+		else {
+			for (int k = 0; k < tileCount; ++k)
+				heights[k] = TerrainHeight(tile[k], hmp);
+		}
+		ConvertSamples(hmp.sampleFormat, tileHeights, tileCount, out + size_t(begin) * bytes);
+	}
+	return true;
+}
+
+bool HeightGenerator::generateRegion(const unsigned int seed, const height_map_param_t &params, const int x, const int y,
+									 const int width, const int height, void *samples)
+{
+	if (!samples || width <= 0 || height <= 0 || !SampleFormatBytes(params.sampleFormat))
+		return false;
+
+	// Compiled once for every row
+	height_map_param_t hmp = params;
+	HeightGraph graph;
+	if (hmp.graph && !hmp.graph->compiled()) {
+		graph = *hmp.graph;
+		if (!graph.compile())
+			return false;
+		hmp.graph = &graph;
+	}
+
+	const size_t rowBytes = size_t(width) * SampleFormatBytes(hmp.sampleFormat);
+	std::vector<float> positions(size_t(width) * 2);
+	for (int row = 0; row < height; ++row) {
+		for (int k = 0; k < width; ++k) {
+			positions[size_t(k) * 2] = float(x + k);
+			positions[size_t(k) * 2 + 1] = float(y + row);
+		}
+		if (!evaluateAt(seed, hmp, positions.data(), width, static_cast<unsigned char *>(samples) + rowBytes * row))
+			return false;
+	}
+	return true;
+}
+
 unsigned int HeightGenerator::GenSeed()
 {
-	std::uniform_int_distribution<unsigned int> digit(0, UINT_MAX);	return digit(RandGen);
+	std::uniform_int_distribution<unsigned int> digit(0, UINT_MAX);
+	return digit(RandGen);
 }
 
-HeightGenerator::HeightGenerator() : m_generatedData(nullptr), m_generatedPixels(-1), m_generatedSeedUsed(0)
+HeightGenerator::HeightGenerator() : m_generatedData(nullptr), m_generatedPixels(-1), m_generatedSeedUsed(0),
+	m_layerCacheEnabled(false), m_quadTree(nullptr), m_checkpointRows(256), m_checkpointResumedRows(0), m_checkpointFailed(false)
 {
 #ifdef USE_DEVIL_LIBRARY
 #ifndef DEVIL_INIT_ELSEWHERE
@@ -88,6 +898,7 @@ HeightGenerator::HeightGenerator() : m_generatedData(nullptr), m_generatedPixels
 HeightGenerator::~HeightGenerator()
 {
 	freeGeneratedData();
+	delete m_quadTree;
 }
 
 bool HeightGenerator::generate(const unsigned int seed, const int resolution,
@@ -95,22 +906,208 @@ bool HeightGenerator::generate(const unsigned int seed, const int resolution,
 							   const float scale,
 							   const std::string &rawOutput,
 							   const std::string &pngOutput)
+{
+	return generate(seed, height_map_param_t(resolution, gain, octaves, scale), rawOutput, pngOutput);
+}
+
+bool HeightGenerator::generate(const unsigned int seed, const height_map_param_t &params,
+							   const std::string &rawOutput,
+							   const std::string &pngOutput)
 {
 	freeGeneratedData();
 
+	height_map_param_t hmp = params;
+
+	// Worker threads run a compiled private copy of the graph
+	HeightGraph graph;
+	if (hmp.graph) {
+		graph = *hmp.graph;
+		if (!graph.compile())
+			return false;
+		hmp.graph = &graph;
+	}
+
+	// Channels run compiled private copies too, the built-in formula as its graph
+	if (hmp.channelCount < 0 || (hmp.channelCount && !hmp.channels))
+		return false;
+	std::vector<HeightGraph> channelGraphs(hmp.channelCount);
+	std::vector<channel_param_t> channels(hmp.channelCount);
+	for (int i = 0; i < hmp.channelCount; ++i) {
+		channels[i] = hmp.channels[i];
+		channelGraphs[i] = channels[i].graph ? *channels[i].graph : HeightGraph::Terrain(hmp.ridgedGainOffset, hmp.worleyGainOffset);
+		if (!channelGraphs[i].compile())
+			return false;
+		channels[i].graph = &channelGraphs[i];
+	}
+	hmp.channels = hmp.channelCount ? channels.data() : nullptr;
+
+	// Set once the request is known to be valid, a failed generate leaves no params behind
     m_generatedSeedUsed = seed;
-	
-	height_map_param_t hmp(resolution, gain, octaves, scale);
-	m_generatedParam = hmp;
+	m_generatedParam = params;
 
-	
+	const bool useLayerCache = m_layerCacheEnabled && !hmp.graph && hmp.multiRateStep <= 1 && !WarpEnabled(hmp) &&
+							   hmp.normalOutput == NormalOutputNone;
+	if (useLayerCache)
+		prepareLayerCache(seed, hmp);
 
 	m_generatedPixels = hmp.resolution*hmp.resolution;
 
-	m_generatedData = new UInt16Type[m_generatedPixels];
+	// Erosion works on float heights, the samples are converted to the requested format afterwards.
+	// Graphs have no analytic derivatives, their normals come from the float heights the same way
+	const SampleFormat sampleFormat = hmp.sampleFormat;
+	const bool erode = hmp.erosion && hmp.erosion->enabled();
+	const bool graphNormals = hmp.graph && hmp.normalOutput != NormalOutputNone;
+	const bool floatPass = erode || graphNormals;
+	if (floatPass)
+		hmp.sampleFormat = SampleFormatFloat32;
+
+	m_generatedData = new unsigned char[size_t(m_generatedPixels) * SampleFormatBytes(hmp.sampleFormat)];
 	if (!m_generatedData)
 		return false;
 
+	m_generatedNormals.assign(size_t(m_generatedPixels) * NormalBytesPerPixel(hmp.normalOutput), 0);
+	m_generatedChannels.assign(size_t(m_generatedPixels) * hmp.channelCount * SampleFormatBytes(hmp.sampleFormat), 0);
+
+	m_multiRateError = multi_rate_error_t();
+	m_checkpointResumedRows = 0;
+	m_checkpointFailed = false;
+	const bool multiRate = hmp.multiRateStep > 1 && !hmp.graph && hmp.normalOutput == NormalOutputNone && !WarpEnabled(hmp);
+	const bool checkpoint = !m_checkpointPath.empty() && !multiRate && !useLayerCache;
+	if (multiRate) {
+		int step = hmp.multiRateStep;
+		while (true) {
+			prepareMultiRate(seed, hmp, step);
+			generateHeights(seed, hmp);
+			// No octave is slow enough at this step, the map was generated exactly
+			if (!m_multiRateGrid.step) {
+				m_multiRateError = multi_rate_error_t();
+				break;
+			}
+			measureMultiRateError(seed, hmp);
+			if (!hmp.multiRateMaxError || m_multiRateError.maxError <= hmp.multiRateMaxError)
+				break;
+			step /= 2;
+		}
+		m_multiRateGrid = multi_rate_grid_t();
+	}
+	else if (checkpoint) {
+		m_checkpointFailed = !generateHeightsCheckpointed(seed, hmp);
+	}
+	else {
+		generateHeights(seed, hmp);
+	}
+
+	if (useLayerCache) {
+		for (int i = 0; i < LayerCount; ++i)
+			m_layerCache[i].octaves = hmp.octaves;
+	}
+
+	if (floatPass) {
+		float *heights = reinterpret_cast<float *>(m_generatedData);
+		// A stage that rejects its params or the map size fails the map, rather than handing out
+		// heights that are not (or only partly) eroded
+		if (erode && !hmp.erosion->apply(heights, hmp.resolution)) {
+			freeGeneratedData();
+			return false;
+		}
+		if (hmp.normalOutput != NormalOutputNone)
+			FiniteDifferenceNormals(hmp, heights, m_generatedNormals.data());
+
+		hmp.sampleFormat = sampleFormat;
+		if (sampleFormat != SampleFormatFloat32) {
+			const int bytes = SampleFormatBytes(sampleFormat);
+			unsigned char *samples = new unsigned char[size_t(m_generatedPixels) * bytes];
+			ConvertSampleBuffer(sampleFormat, heights, size_t(m_generatedPixels), samples);
+			delete[] m_generatedData;
+			m_generatedData = samples;
+
+			if (!m_generatedChannels.empty()) {
+				std::vector<unsigned char> channels(size_t(m_generatedPixels) * hmp.channelCount * bytes);
+				ConvertSampleBuffer(sampleFormat, reinterpret_cast<const float *>(m_generatedChannels.data()),
+									size_t(m_generatedPixels) * hmp.channelCount, channels.data());
+				m_generatedChannels.swap(channels);
+			}
+		}
+	}
+
+	if (hmp.blockCompression) {
+		m_generatedHeightBC4.resize(HeightBlockCompression::BC4Bytes(hmp.resolution));
+		HeightBlockCompression::EncodeBC4(m_generatedData, hmp.sampleFormat, hmp.resolution, m_generatedHeightBC4.data());
+		if (hmp.normalOutput != NormalOutputNone) {
+			const bool sixteenBit = NormalBytesPerPixel(hmp.normalOutput) == 4;
+			m_generatedNormalBC5.resize(HeightBlockCompression::BC5Bytes(hmp.resolution));
+			HeightBlockCompression::EncodeBC5(m_generatedNormals.data(), sixteenBit, hmp.resolution, m_generatedNormalBC5.data());
+		}
+	}
+
+	if (m_quadTree)
+		m_quadTree->build(*this);
+
+	int errors = 0;
+
+	if (rawOutput.length()) {
+		FILE *fp = fopen(rawOutput.c_str(), "wb");
+		if (fp) {
+			// Version 1 is 16 bit, version 2 adds the sample format
+			unsigned char version = hmp.sampleFormat == SampleFormatUInt16 ? 1 : 2;
+			unsigned short res = (unsigned short)hmp.resolution;
+
+			fwrite(&version, sizeof(version), 1, fp);
+			fwrite(&res, sizeof(res), 1, fp);
+			if (version > 1) {
+				const unsigned char format = (unsigned char)hmp.sampleFormat;
+				fwrite(&format, sizeof(format), 1, fp);
+			}
+			errors += fwrite(m_generatedData, size_t(m_generatedPixels) * size_t(SampleFormatBytes(hmp.sampleFormat)), 1, fp) != 1;
+			fclose(fp);
+		}
+	}
+
+#ifdef USE_DEVIL_LIBRARY
+	if (pngOutput.length()) {
+		ILenum type = IL_UNSIGNED_SHORT;
+		switch (hmp.sampleFormat) {
+		case SampleFormatUInt8:
+			type = IL_UNSIGNED_BYTE;
+			break;
+		case SampleFormatFloat32:
+			type = IL_FLOAT;
+			break;
+		case SampleFormatFloat16:
+			type = IL_HALF;
+			break;
+		default:
+			;
+		}
+		ILuint imageID = ilGenImage();
+		ilBindImage(imageID);
+
+		ilTexImage(
+			hmp.resolution,
+			hmp.resolution,
+			0,
+			1,
+			IL_LUMINANCE,
+			type,
+			m_generatedData
+		);
+		ilEnable(IL_FILE_OVERWRITE);
+		ilSave(IL_PNG, pngOutput.c_str());
+
+        ilDeleteImage(imageID);
+	}
+#endif
+	// Finished, the journal is only needed to resume
+	if (checkpoint && !errors)
+		remove(m_checkpointPath.c_str());
+	return !errors;
+}
+
+void HeightGenerator::generateHeights(const uint32_t seed, const height_map_param_t &hmp, const int firstRow, const int endRow)
+{
+	const int firstPixel = firstRow * hmp.resolution;
+	const int endPixel = (endRow < 0 ? hmp.resolution : endRow) * hmp.resolution;
+
 	const int numCPUs = glm::clamp(std::thread::hardware_concurrency() - 1u, 1u, 64u);
 	assert(numCPUs > 0); // Asserts on outdated platform/compiler
 
@@ -128,22 +1125,15 @@ bool HeightGenerator::generate(const unsigned int seed, const int resolution,
 			;
 		}
 		std::vector<std::unique_ptr<thread_info>> threadSplits;
-		int x = 0;
-		int y = 0;
-		const auto indexesPerCPU = m_generatedPixels / useCPUCount + 1;
+		int next = firstPixel;
+		const auto indexesPerCPU = (endPixel - firstPixel) / useCPUCount + 1;
 
 		for (int i = 0; i < useCPUCount; ++i) {
 			std::vector<std::pair<const int, const int>> heightMapIndexes;
 			heightMapIndexes.reserve(indexesPerCPU);
-			for (; x < hmp.resolution; ++x) {
-				for (y = 0; y < hmp.resolution; ++y) {
-					heightMapIndexes.push_back(std::pair<const int, const int>(x, y));
-					if (static_cast<const int>(heightMapIndexes.size()) >= indexesPerCPU)
-						break;
-				}
-				if (static_cast<const int>(heightMapIndexes.size()) >= indexesPerCPU)
-					break;
-			}
+			// Row major, each thread writes one contiguous run of samples and no pixel is in two runs
+			for (; next < endPixel && static_cast<const int>(heightMapIndexes.size()) < indexesPerCPU; ++next)
+				heightMapIndexes.push_back(std::pair<const int, const int>(next % hmp.resolution, next / hmp.resolution));
 			threadSplits.push_back(std::unique_ptr<thread_info>(new thread_info(this, m_generatedData, hmp, seed, std::move(heightMapIndexes))));
 		}
 		while (true) {
@@ -167,67 +1157,209 @@ bool HeightGenerator::generate(const unsigned int seed, const int resolution,
 	else {
 		// Small height maps, use only 1 CPU thread
 		std::vector<std::pair<const int, const int>> heightMapIndexes;
-		heightMapIndexes.reserve(m_generatedPixels);
+		heightMapIndexes.reserve(endPixel - firstPixel);
 
-		for (int x = 0; x < hmp.resolution; ++x) {
-			for (int y = 0; y < hmp.resolution; ++y) {
+		for (int y = firstRow; y < endPixel / hmp.resolution; ++y) {
+			for (int x = 0; x < hmp.resolution; ++x) {
 				heightMapIndexes.push_back(std::pair<const int, const int>(x, y));
 			}
 		}
 		generationHeight(seed, hmp, m_generatedData, heightMapIndexes);
 	}
-	int errors = 0;
+}
 
-	if (rawOutput.length()) {
-		FILE *fp = fopen(rawOutput.c_str(), "wb");
-		if (fp) {
-			unsigned char version = 1;
-			unsigned short res = (unsigned short)hmp.resolution;
+static bool JournalSeek(FILE *fp, const long long offset)
+{
+#ifdef _MSC_VER
+	return _fseeki64(fp, offset, SEEK_SET) == 0;
+#else
+	return fseeko(fp, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
 
-			fwrite(&version, sizeof(version), 1, fp);
-			fwrite(&res, sizeof(res), 1, fp);
-			errors += fwrite(m_generatedData, m_generatedPixels * sizeof(UInt16Type), 1, fp) != 1;
-			fclose(fp);
+static long long JournalTell(FILE *fp)
+{
+#ifdef _MSC_VER
+	return _ftelli64(fp);
+#else
+	return (long long)ftello(fp);
+#endif
+}
+
+// FNV-1a over 8 byte words, catches records torn by a crash
+static unsigned long long JournalHash(unsigned long long hash, const unsigned char *data, const size_t bytes)
+{
+	const unsigned long long prime = 1099511628211ULL;
+	size_t i = 0;
+	for (; i + 8 <= bytes; i += 8) {
+		unsigned long long word;
+		memcpy(&word, data + i, sizeof(word));
+		hash = (hash ^ word) * prime;
+	}
+	for (; i < bytes; ++i)
+		hash = (hash ^ data[i]) * prime;
+	return hash;
+}
+
+static unsigned long long JournalHash(const unsigned long long hash, const unsigned int value)
+{
+	return JournalHash(hash, reinterpret_cast<const unsigned char *>(&value), sizeof(value));
+}
+
+bool HeightGenerator::generateHeightsCheckpointed(const uint32_t seed, const height_map_param_t &hmp)
+{
+	const int res = hmp.resolution;
+	const int rows = m_checkpointRows;
+	const int bands = (res - 1) / rows + 1;
+	const size_t bytes = SampleFormatBytes(hmp.sampleFormat);
+	const size_t normalBytes = NormalBytesPerPixel(hmp.normalOutput);
+
+	// Everything that decides the samples, a journal of other inputs starts over
+	unsigned long long key = HeightTileCache::ParamsKey(seed, hmp);
+	key = JournalHash(key, (unsigned int)res);
+	key = JournalHash(key, (unsigned int)rows);
+	key = JournalHash(key, (unsigned int)hmp.normalOutput);
+	key = JournalHash(key, reinterpret_cast<const unsigned char *>(&hmp.normalHeightScale), sizeof(hmp.normalHeightScale));
+	key = JournalHash(key, (unsigned int)hmp.channelCount);
+	key = JournalHash(key, (unsigned int)hmp.channelLayout);
+	for (int c = 0; c < hmp.channelCount; ++c) {
+		height_map_param_t channel = hmp;
+		channel.graph = hmp.channels[c].graph;
+		key = JournalHash(key, (unsigned int)(HeightTileCache::ParamsKey(seed + hmp.channels[c].seedOffset, channel) >> 32));
+		key = JournalHash(key, (unsigned int)HeightTileCache::ParamsKey(seed + hmp.channels[c].seedOffset, channel));
+	}
+
+	// Samples, normals and channels of a band
+	std::vector<std::pair<unsigned char *, size_t>> spans;
+	auto bandSpans = [&](const int band) {
+		const size_t first = size_t(band) * rows * res;
+		const size_t pixels = size_t(std::min(rows, res - band * rows)) * res;
+		spans.clear();
+		spans.push_back(std::make_pair(m_generatedData + first * bytes, pixels * bytes));
+		if (normalBytes)
+			spans.push_back(std::make_pair(m_generatedNormals.data() + first * normalBytes, pixels * normalBytes));
+		if (hmp.channelCount && hmp.channelLayout == ChannelLayoutInterleaved) {
+			spans.push_back(std::make_pair(m_generatedChannels.data() + first * hmp.channelCount * bytes,
+										   pixels * hmp.channelCount * bytes));
+		}
+		for (int c = 0; c < hmp.channelCount && hmp.channelLayout == ChannelLayoutPlanar; ++c)
+			spans.push_back(std::make_pair(m_generatedChannels.data() + (size_t(c) * m_generatedPixels + first) * bytes, pixels * bytes));
+	};
+
+	// Bands of an earlier run, up to the first torn record
+	std::vector<char> done(bands, 0);
+	long long validEnd = -1;
+	FILE *fp = fopen(m_checkpointPath.c_str(), "rb");
+	if (fp) {
+		unsigned char version = 0;
+		char magic[3] = { 0, 0, 0 };
+		unsigned long long fileKey = 0;
+		int errors = fread(&version, sizeof(version), 1, fp) != 1;
+		if (!errors) errors += fread(magic, sizeof(magic), 1, fp) != 1;
+		if (!errors) errors += fread(&fileKey, sizeof(fileKey), 1, fp) != 1;
+		if (!errors && version == CHECKPOINT_FILE_VERSION && !memcmp(magic, CHECKPOINT_FILE_MAGIC, sizeof(magic)) && fileKey == key) {
+			validEnd = JournalTell(fp);
+			while (true) {
+				int band = -1;
+				unsigned long long checksum = 0;
+				errors = fread(&band, sizeof(band), 1, fp) != 1;
+				if (!errors) errors += fread(&checksum, sizeof(checksum), 1, fp) != 1;
+				if (errors || band < 0 || band >= bands)
+					break;
+				bandSpans(band);
+				unsigned long long hash = 14695981039346656037ULL;
+				for (const auto & span : spans) {
+					errors += fread(span.first, span.second, 1, fp) != 1;
+					hash = JournalHash(hash, span.first, span.second);
+				}
+				// A torn band is generated again, over whatever was read
+				if (errors || hash != checksum)
+					break;
+				done[band] = 1;
+				validEnd = JournalTell(fp);
+			}
 		}
+		fclose(fp);
 	}
 
-#ifdef USE_DEVIL_LIBRARY
-	if (pngOutput.length()) {
-		ILuint imageID = ilGenImage();
-		ilBindImage(imageID);
+	// New records go after the last whole one
+	fp = validEnd >= 0 ? fopen(m_checkpointPath.c_str(), "r+b") : nullptr;
+	if (fp && !JournalSeek(fp, validEnd)) {
+		fclose(fp);
+		fp = nullptr;
+	}
+	if (!fp) {
+		fp = fopen(m_checkpointPath.c_str(), "wb");
+		int errors = !fp;
+		if (!errors) errors += fwrite(&CHECKPOINT_FILE_VERSION, sizeof(CHECKPOINT_FILE_VERSION), 1, fp) != 1;
+		if (!errors) errors += fwrite(CHECKPOINT_FILE_MAGIC, sizeof(CHECKPOINT_FILE_MAGIC), 1, fp) != 1;
+		if (!errors) errors += fwrite(&key, sizeof(key), 1, fp) != 1;
+		if (errors && fp) {
+			fclose(fp);
+			fp = nullptr;
+		}
+	}
 
-		ilTexImage(
-			hmp.resolution,
-			hmp.resolution,
-			0,
-			1,
-			IL_LUMINANCE,
-			IL_UNSIGNED_SHORT,
-			m_generatedData
-		);
-		ilEnable(IL_FILE_OVERWRITE);
-		ilSave(IL_PNG, pngOutput.c_str());
+	// A journal that can not be written is given up, the map is still generated
+	for (int band = 0; band < bands; ++band) {
+		const int first = band * rows, end = std::min(first + rows, res);
+		if (done[band]) {
+			m_checkpointResumedRows += end - first;
+			continue;
+		}
+		generateHeights(seed, hmp, first, end);
+		if (!fp)
+			continue;
 
-        ilDeleteImage(imageID);
+		bandSpans(band);
+		unsigned long long checksum = 14695981039346656037ULL;
+		for (const auto & span : spans)
+			checksum = JournalHash(checksum, span.first, span.second);
+		int errors = fwrite(&band, sizeof(band), 1, fp) != 1;
+		if (!errors) errors += fwrite(&checksum, sizeof(checksum), 1, fp) != 1;
+		for (const auto & span : spans) {
+			if (!errors) errors += fwrite(span.first, span.second, 1, fp) != 1;
+		}
+		if (!errors) errors += fflush(fp) != 0;
+		if (errors) {
+			fclose(fp);
+			fp = nullptr;
+		}
 	}
-#endif
-	return !errors;
+	const bool journaled = fp != nullptr;
+	if (fp)
+		fclose(fp);
+	return journaled;
+}
+
+void HeightGenerator::setCheckpoint(const std::string &journalPath, const int rowsPerCheckpoint)
+{
+	m_checkpointPath = journalPath;
+	m_checkpointRows = std::max(rowsPerCheckpoint, 1);
 }
 
-bool HeightGenerator::saveGeneratedData(const std::string &savePath)
+bool HeightGenerator::saveGeneratedData(const std::string &savePath, const int maxError)
 {
     if (m_generatedData) {
+        std::vector<unsigned char> encoded;
+        if (maxError >= 0 && !HeightCodec::Encode(m_generatedData, m_generatedParam.sampleFormat, m_generatedParam.resolution,
+                                                  maxError, encoded))
+            return false;
         FILE *fp = fopen(savePath.c_str(), "wb");
         if (fp) {
             unsigned int size = 0;
-            int errors = fwrite(&HEIGHT_DATA_FILE_VERSION, sizeof(HEIGHT_DATA_FILE_VERSION), 1, fp) != 1;
+            const unsigned char version = maxError >= 0 ? HEIGHT_DATA_FILE_VERSION_CODEC : HEIGHT_DATA_FILE_VERSION;
+            int errors = fwrite(&version, sizeof(version), 1, fp) != 1;
             if (!errors) errors += fwrite(&HEIGHT_DATA_FILE_MAGIC, sizeof(HEIGHT_DATA_FILE_MAGIC), 1, fp) != 1;
             if (!errors) errors += fwrite(&size, sizeof(size), 1, fp) != 1;
             if (!errors) errors += fwrite(&m_generatedParam.resolution, sizeof(m_generatedParam.resolution), 1, fp) != 1;
             if (!errors) errors += fwrite(&m_generatedParam.gain, sizeof(m_generatedParam.gain), 1, fp) != 1;
             if (!errors) errors += fwrite(&m_generatedParam.octaves, sizeof(m_generatedParam.octaves), 1, fp) != 1;
             if (!errors) errors += fwrite(&m_generatedSeedUsed, sizeof(m_generatedSeedUsed), 1, fp) != 1;
-            if (!errors) errors += fwrite(m_generatedData, (m_generatedParam.resolution * m_generatedParam.resolution) * 2, 1, fp) != 1;
+            const unsigned char format = (unsigned char)m_generatedParam.sampleFormat;
+            if (!errors) errors += fwrite(&format, sizeof(format), 1, fp) != 1;
+            if (!errors && maxError >= 0) errors += fwrite(encoded.data(), encoded.size(), 1, fp) != 1;
+            if (!errors && maxError < 0) errors += fwrite(m_generatedData, size_t(m_generatedParam.resolution) * size_t(m_generatedParam.resolution) * size_t(SampleFormatBytes(m_generatedParam.sampleFormat)), 1, fp) != 1;
             // Update size head
             if (!errors) {
                 size = ftell(fp);
@@ -265,10 +1397,31 @@ bool HeightGenerator::loadGeneratedData(const std::string &loadPath)
                     fread(&m_generatedParam.gain, sizeof(m_generatedParam.gain), 1, fp);
                     fread(&m_generatedParam.octaves, sizeof(m_generatedParam.octaves), 1, fp);
                     fread(&m_generatedSeedUsed, sizeof(m_generatedSeedUsed), 1, fp);
-
-                    m_generatedData = new unsigned short[m_generatedParam.resolution * m_generatedParam.resolution];
-                    fread(m_generatedData, (m_generatedParam.resolution * m_generatedParam.resolution) * 2, 1, fp);
-                    ret = true;
+                    // Version 1 files are 16 bit
+                    if (version >= 2) {
+                        unsigned char format = 0;
+                        fread(&format, sizeof(format), 1, fp);
+                        m_generatedParam.sampleFormat = (SampleFormat)format;
+                    }
+                    const int bytes = SampleFormatBytes(m_generatedParam.sampleFormat);
+                    if (bytes) {
+                        m_generatedPixels = m_generatedParam.resolution * m_generatedParam.resolution;
+                        m_generatedData = new unsigned char[size_t(m_generatedPixels) * bytes];
+                        if (version >= HEIGHT_DATA_FILE_VERSION_CODEC) {
+                            std::vector<unsigned char> encoded(size_t(fSize - ftell(fp)));
+                            ret = fread(encoded.data(), encoded.size(), 1, fp) == 1 &&
+                                  HeightCodec::Decode(encoded.data(), encoded.size(), m_generatedParam.resolution,
+                                                      m_generatedParam.sampleFormat, m_generatedData);
+                        }
+                        else {
+                            fread(m_generatedData, size_t(m_generatedPixels) * bytes, 1, fp);
+                            ret = true;
+                        }
+                        if (!ret)
+                            freeGeneratedData();
+                        else if (m_quadTree)
+                            m_quadTree->build(*this);
+                    }
                 }
             }
         }
@@ -277,39 +1430,571 @@ bool HeightGenerator::loadGeneratedData(const std::string &loadPath)
     return ret;
 }
 
+float HeightGenerator::generatedChannelHeight(const int channel, const size_t index)
+{
+	const int count = generatedChannelCount();
+	if (channel < 0 || channel >= count || index >= size_t(m_generatedPixels))
+		return 0.0f;
+	const size_t sample = m_generatedParam.channelLayout == ChannelLayoutInterleaved ?
+						  index * count + channel : size_t(channel) * size_t(m_generatedPixels) + index;
+	return SampleHeight(m_generatedParam.sampleFormat, m_generatedChannels.data(), sample);
+}
+
+int HeightGenerator::SampleFormatBytes(const SampleFormat format)
+{
+	switch (format) {
+	case SampleFormatUInt16:
+	case SampleFormatFloat16:
+		return 2;
+	case SampleFormatUInt8:
+		return 1;
+	case SampleFormatFloat32:
+		return 4;
+	}
+	return 0;
+}
+
+float HeightGenerator::SampleHeight(const SampleFormat format, const void *samples, const size_t index)
+{
+	switch (format) {
+	case SampleFormatUInt16:
+		return static_cast<const unsigned short *>(samples)[index] / 65535.0f;
+	case SampleFormatUInt8:
+		return static_cast<const unsigned char *>(samples)[index] / 255.0f;
+	case SampleFormatFloat32:
+		return static_cast<const float *>(samples)[index];
+	case SampleFormatFloat16:
+		return HalfToFloat(static_cast<const unsigned short *>(samples)[index]);
+	}
+	return 0.0f;
+}
+
+float HeightGenerator::HalfToFloat(const unsigned short half)
+{
+	const uint32_t sign = uint32_t(half & 0x8000) << 16;
+	const uint32_t exponent = (half >> 10) & 0x1f;
+	const uint32_t mantissa = half & 0x3ff;
+	uint32_t bits;
+	if (exponent == 0x1f) {
+		bits = sign | 0x7f800000u | (mantissa << 13);
+	}
+	else if (exponent) {
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	else {
+		// Zero and subnormals, mantissa * 2^-24
+		const float value = mantissa * (1.0f / 16777216.0f);
+		return sign ? -value : value;
+	}
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+unsigned short HeightGenerator::FloatToHalf(const float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	const uint32_t sign = (bits >> 16) & 0x8000;
+	const uint32_t magnitude = bits & 0x7fffffff;
+	// Infinity and NaN
+	if (magnitude >= 0x7f800000u)
+		return (unsigned short)(sign | 0x7c00 | (magnitude > 0x7f800000u ? 0x200 : 0));
+	// Overflow
+	if (magnitude >= 0x47800000u)
+		return (unsigned short)(sign | 0x7c00);
+	// Normal, round to nearest even. A mantissa carry moves into the exponent, up to infinity
+	if (magnitude >= 0x38800000u)
+		return (unsigned short)(sign | ((magnitude - 0x38000000u + 0x0fffu + ((magnitude >> 13) & 1u)) >> 13));
+	// Below half the smallest subnormal
+	if (magnitude <= 0x33000000u)
+		return (unsigned short)sign;
+	// Subnormal, round to nearest even
+	const uint32_t mantissa = (magnitude & 0x7fffff) | 0x800000;
+	const int shift = 126 - int(magnitude >> 23);
+	const uint32_t half = mantissa >> shift;
+	const uint32_t rest = mantissa & ((1u << shift) - 1);
+	const uint32_t halfway = 1u << (shift - 1);
+	return (unsigned short)(sign | (half + ((rest > halfway || (rest == halfway && (half & 1))) ? 1 : 0)));
+}
+
+void HeightGenerator::DecodeOctahedralNormal(const float u, const float v, float *normal)
+{
+	float x = u * 2.0f - 1.0f;
+	float y = v * 2.0f - 1.0f;
+	const float z = 1.0f - glm::abs(x) - glm::abs(y);
+	if (z < 0.0f) {
+		const float fx = (1.0f - glm::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		const float fy = (1.0f - glm::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = fx;
+		y = fy;
+	}
+	const float length = sqrtf(x * x + y * y + z * z);
+	normal[0] = x / length;
+	normal[1] = y / length;
+	normal[2] = z / length;
+}
+
 void HeightGenerator::freeGeneratedData()
 {
 	if (m_generatedData) {
 		delete[] m_generatedData;
 		m_generatedData = nullptr;
 	}
+	m_generatedNormals.clear();
+	m_generatedChannels.clear();
+	m_generatedHeightBC4.clear();
+	m_generatedNormalBC5.clear();
+	if (m_quadTree)
+		m_quadTree->clear();
 	m_generatedPixels = 0;
 	m_generatedParam = height_map_param_t();
     m_generatedSeedUsed = 0;
 }
 
+void HeightGenerator::setLayerCacheEnabled(const bool enable)
+{
+	m_layerCacheEnabled = enable;
+	if (!enable)
+		clearLayerCache();
+}
+
+void HeightGenerator::setQuadTreeEnabled(const bool enable)
+{
+	if (enable && !m_quadTree) {
+		m_quadTree = new HeightQuadTree();
+		if (m_generatedData)
+			m_quadTree->build(*this);
+	}
+	else if (!enable && m_quadTree) {
+		delete m_quadTree;
+		m_quadTree = nullptr;
+	}
+}
+
+void HeightGenerator::clearLayerCache()
+{
+	for (int i = 0; i < LayerCount; ++i) {
+		m_layerCache[i] = layer_cache_t();
+	}
+}
+
+void HeightGenerator::prepareLayerCache(const uint32_t seed, const height_map_param_t &hmp)
+{
+	const float gains[LayerCount] = { hmp.gain, hmp.gain + hmp.ridgedGainOffset, hmp.gain + hmp.worleyGainOffset };
+	const size_t pixels = size_t(hmp.resolution) * size_t(hmp.resolution);
+
+	for (int i = 0; i < LayerCount; ++i) {
+		layer_cache_t &lc = m_layerCache[i];
+		const bool keyMatch = lc.seed == seed && lc.resolution == hmp.resolution &&
+							  lc.scale == hmp.scale && lc.gain == gains[i] &&
+							  lc.state.size() == pixels * LAYER_STATE_STRIDE[i];
+		if (keyMatch && lc.octaves <= hmp.octaves) {
+			// Continue from the cached sums, nothing to do when the octave count is unchanged
+			lc.fromOctave = lc.octaves;
+			continue;
+		}
+		lc.seed = seed;
+		lc.resolution = hmp.resolution;
+		lc.scale = hmp.scale;
+		lc.gain = gains[i];
+		lc.octaves = 0;
+		lc.fromOctave = 0;
+		lc.state.assign(pixels * LAYER_STATE_STRIDE[i], 0.0f);
+		// Ridged sums start with a previous octave of 1
+		if (i == LayerRidged) {
+			for (size_t p = 0; p < pixels; ++p)
+				lc.state[p * 2 + 1] = 1.0f;
+		}
+	}
+}
+
+void HeightGenerator::generationHeightGraph(const HeightGenerator::height_map_param_t &hmp,
+											unsigned char *data,
+											const std::vector<std::pair<const int, const int>> &workSet)
+{
+	const HeightGraph &graph = *hmp.graph;
+	SampleTileWriter samples(hmp, data, workSet);
+	std::vector<float> registers(std::max(graph.registerCount(), 1) * GRAPH_TILE_PIXELS);
+	glm::vec2 positions[GRAPH_TILE_PIXELS];
+
+	for (size_t begin = 0; begin < workSet.size(); begin += GRAPH_TILE_PIXELS) {
+		const int count = static_cast<int>(std::min(workSet.size() - begin, size_t(GRAPH_TILE_PIXELS)));
+		for (int k = 0; k < count; ++k) {
+			const auto & i = workSet[begin + k];
+			positions[k] = (glm::vec2((float)i.first, (float)i.second)) * hmp.scale;
+		}
+		WarpTile(hmp, positions, count);
+
+		const float *heights = GraphTile(graph, hmp, positions, count, registers.data());
+
+		for (int k = 0; k < count; ++k)
+			samples.push(heights[k]);
+	}
+}
+
+void HeightGenerator::prepareMultiRate(const uint32_t seed, const height_map_param_t &hmp, const int step)
+{
+	multi_rate_grid_t &grid = m_multiRateGrid;
+	grid = multi_rate_grid_t();
+	if (step < 2)
+		return;
+
+	// Frequency growth per octave, iqMatfBmEx scales by its lacunarity and the matrix norm
+	const glm::mat2 iqMat = IqMatrix();
+	const float growth[LayerCount] = { 0.9f * sqrtf(2.3f * 2.3f + 1.5f * 1.5f), 2.0f, 2.0f };
+	const int octaves = (uint8_t)hmp.octaves;
+	int lowOctaves = 0;
+	for (int l = 0; l < LayerCount; ++l) {
+		float cellsPerStep = hmp.scale * step;
+		while (grid.cutoff[l] < octaves && cellsPerStep <= MULTI_RATE_CELLS_PER_STEP) {
+			++grid.cutoff[l];
+			cellsPerStep *= growth[l];
+		}
+		lowOctaves += grid.cutoff[l];
+	}
+	if (!lowOctaves) {
+		grid = multi_rate_grid_t();
+		return;
+	}
+
+	grid.step = step;
+	grid.width = (hmp.resolution - 1) / step + 4;
+	grid.height = grid.width;
+	grid.valuesPerNode = grid.cutoff[LayerIq] * 3 + grid.cutoff[LayerRidged] + grid.cutoff[LayerWorley];
+	grid.values.resize(size_t(grid.width) * size_t(grid.height) * grid.valuesPerNode);
+
+	// Octaves are sampled individually, the non linear octave sums are formed per pixel
+	SeedThread(seed);
+	for (int gy = 0; gy < grid.height; ++gy) {
+		for (int gx = 0; gx < grid.width; ++gx) {
+			float *values = &grid.values[(size_t(gx) + size_t(gy) * size_t(grid.width)) * grid.valuesPerNode];
+			const glm::vec2 position = (glm::vec2((float)((gx - 1) * step), (float)((gy - 1) * step))) * hmp.scale;
+
+			const float lacunarity = 0.9;
+			glm::vec2 pos = position;
+			for (int i = 0; i < grid.cutoff[LayerIq]; i++) {
+				const glm::vec3 n = Simplex::dnoise(pos);
+				*values++ = n.x;
+				*values++ = n.y;
+				*values++ = n.z;
+				pos *= lacunarity;
+				pos = iqMat * pos;
+			}
+			float freq = 1.0f;
+			for (int i = 0; i < grid.cutoff[LayerRidged]; i++) {
+				*values++ = Simplex::noise(position * freq);
+				freq *= 2.0f;
+			}
+			freq = 1.0f;
+			for (int i = 0; i < grid.cutoff[LayerWorley]; i++) {
+				*values++ = Simplex::worleyNoise(position * freq);
+				freq *= 2.0f;
+			}
+		}
+	}
+}
+
+void HeightGenerator::measureMultiRateError(const uint32_t seed, const height_map_param_t &hmp)
+{
+	multi_rate_error_t &report = m_multiRateError;
+	report = multi_rate_error_t();
+	report.step = m_multiRateGrid.step;
+
+	// Sample between the coarse nodes, where the interpolation error peaks. A stride that is a multiple
+	// of the step would otherwise only meet the nodes, which are exact
+	const int step = m_multiRateGrid.step;
+	const int stride = std::max(1, hmp.resolution / MULTI_RATE_ERROR_SAMPLES);
+	double errorSum = 0.0;
+	SeedThread(seed);
+	for (int sy = stride / 2; sy < hmp.resolution; sy += stride) {
+		const int y = std::min(sy / step * step + step / 2, hmp.resolution - 1);
+		for (int sx = stride / 2; sx < hmp.resolution; sx += stride) {
+			const int x = std::min(sx / step * step + step / 2, hmp.resolution - 1);
+			glm::vec2 position = (glm::vec2((float)x, (float)y)) * hmp.scale;
+			// In 16 bit steps, the exact height goes through the same sample format first
+			float exact = TerrainHeight(position, hmp);
+			unsigned char exactSample[4];
+			ConvertSamples(hmp.sampleFormat, &exact, 1, exactSample);
+			const float difference = SampleHeight(hmp.sampleFormat, exactSample, 0) -
+									 SampleHeight(hmp.sampleFormat, m_generatedData, size_t(x) + size_t(y) * size_t(hmp.resolution));
+			const int error = (int)(glm::abs(difference) * 65535.0f + 0.5f);
+			report.maxError = std::max(report.maxError, error);
+			errorSum += error;
+			++report.samples;
+		}
+	}
+	report.meanError = report.samples ? (float)(errorSum / report.samples) : 0.0f;
+}
+
+void HeightGenerator::generationHeightMultiRate(const HeightGenerator::height_map_param_t &hmp,
+												unsigned char *data,
+												const std::vector<std::pair<const int, const int>> &workSet)
+{
+	const multi_rate_grid_t &grid = m_multiRateGrid;
+	const glm::mat2 iqMat = IqMatrix();
+	const int octaves = (uint8_t)hmp.octaves;
+	const float ridgedGain = hmp.gain + hmp.ridgedGainOffset;
+	const float worleyGain = hmp.gain + hmp.worleyGainOffset;
+	const float invStep = 1.0f / grid.step;
+	std::vector<float> values(std::max(grid.valuesPerNode, 1));
+	SampleTileWriter samples(hmp, data, workSet);
+
+	for (const auto & i : workSet) {
+		glm::vec2 position = (glm::vec2((float)i.first, (float)i.second)) * hmp.scale;
+
+		// Bicubic reconstruction of the low octave sums
+		const int cx = i.first / grid.step;
+		const int cy = i.second / grid.step;
+		float wx[4], wy[4];
+		CubicWeights((i.first - cx * grid.step) * invStep, wx);
+		CubicWeights((i.second - cy * grid.step) * invStep, wy);
+
+		for (int v = 0; v < grid.valuesPerNode; ++v)
+			values[v] = 0.0f;
+		for (int ty = 0; ty < 4; ++ty) {
+			for (int tx = 0; tx < 4; ++tx) {
+				const float w = wx[tx] * wy[ty];
+				const float *node = &grid.values[(size_t(cx + tx) + size_t(cy + ty) * size_t(grid.width)) * grid.valuesPerNode];
+				for (int v = 0; v < grid.valuesPerNode; ++v)
+					values[v] += node[v] * w;
+			}
+		}
+
+		// Low octave sums from the reconstructed samples, same operations as the layer functions
+		const float *sample = values.data();
+		float state[LayerCount][3] = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+		float amp = 1.0f;
+		glm::vec2 d = glm::vec2(0.0f);
+		for (int o = 0; o < grid.cutoff[LayerIq]; o++, sample += 3) {
+			d += glm::vec2(sample[0], sample[1]);
+			state[LayerIq][0] += sample[2] * amp / (1.0 + glm::dot(d, d));
+			amp *= hmp.gain;
+		}
+		state[LayerIq][1] = d.x;
+		state[LayerIq][2] = d.y;
+		amp = 0.5f;
+		for (int o = 0; o < grid.cutoff[LayerRidged]; o++, sample++) {
+			const float n = Simplex::details::ridge(*sample, 1.0f);
+			state[LayerRidged][0] += n * amp * state[LayerRidged][1];
+			state[LayerRidged][1] = n;
+			amp *= ridgedGain;
+		}
+		amp = 0.5f;
+		for (int o = 0; o < grid.cutoff[LayerWorley]; o++, sample++) {
+			state[LayerWorley][0] += *sample * amp;
+			amp *= worleyGain;
+		}
+
+		// Full rate detail octaves
+		IqLayerOctaves(position, grid.cutoff[LayerIq], octaves, iqMat, hmp.gain, state[LayerIq]);
+		RidgedLayerOctaves(position, grid.cutoff[LayerRidged], octaves, 1.0f, 2.0f, ridgedGain, state[LayerRidged]);
+		WorleyLayerOctaves(position, grid.cutoff[LayerWorley], octaves, 2.0f, worleyGain, state[LayerWorley]);
+
+		float n = state[LayerIq][0] * 0.5f;
+		n *= state[LayerRidged][0] * 0.5f + 0.5f;
+		n *= state[LayerWorley][0] * 0.5f + 0.5f;
+		samples.push(n);
+	}
+}
+
+void HeightGenerator::generationHeightNormals(const HeightGenerator::height_map_param_t &hmp,
+											  unsigned char *data,
+											  const std::vector<std::pair<const int, const int>> &workSet)
+{
+	const int normalBytes = NormalBytesPerPixel(hmp.normalOutput);
+	unsigned char *normals = m_generatedNormals.data();
+	SampleTileWriter samples(hmp, data, workSet);
+
+	for (const auto & i : workSet) {
+		const size_t index = size_t(i.first) + size_t(i.second)*size_t(hmp.resolution);
+		glm::vec2 position = (glm::vec2((float)i.first, (float)i.second)) * hmp.scale;
+		glm::vec2 gradient;
+		if (WarpEnabled(hmp)) {
+			// Chain rule through the warp
+			glm::mat2 jacobian;
+			position = WarpPosition<true>(position, hmp, &jacobian);
+			samples.push(TerrainHeightGradient(position, hmp, gradient));
+			gradient = gradient * jacobian;
+		}
+		else {
+			samples.push(TerrainHeightGradient(position, hmp, gradient));
+		}
+		EncodeNormal(hmp.normalOutput, gradient, hmp.normalHeightScale, normals + index * normalBytes);
+	}
+}
+
+void HeightGenerator::generationHeightCached(const HeightGenerator::height_map_param_t &hmp,
+											 unsigned char *data,
+											 const std::vector<std::pair<const int, const int>> &workSet)
+{
+	const glm::mat2 iqMat = IqMatrix();
+	const int octaves = (uint8_t)hmp.octaves;
+	layer_cache_t &iq = m_layerCache[LayerIq];
+	layer_cache_t &ridged = m_layerCache[LayerRidged];
+	layer_cache_t &worley = m_layerCache[LayerWorley];
+	SampleTileWriter samples(hmp, data, workSet);
+
+	for (const auto & i : workSet) {
+		const size_t index = size_t(i.first) + size_t(i.second)*size_t(hmp.resolution);
+		glm::vec2 position = (glm::vec2((float)i.first, (float)i.second)) * hmp.scale;
+
+		float *iqState = &iq.state[index * 3];
+		float *ridgedState = &ridged.state[index * 2];
+		float *worleyState = &worley.state[index];
+		if (iq.fromOctave < octaves)
+			IqLayerOctaves(position, iq.fromOctave, octaves, iqMat, iq.gain, iqState);
+		if (ridged.fromOctave < octaves)
+			RidgedLayerOctaves(position, ridged.fromOctave, octaves, 1.0f, 2.0f, ridged.gain, ridgedState);
+		if (worley.fromOctave < octaves)
+			WorleyLayerOctaves(position, worley.fromOctave, octaves, 2.0f, worley.gain, worleyState);
+
+		float n = iqState[0] * 0.5f;
+		n *= ridgedState[0] * 0.5f + 0.5f;
+		n *= worleyState[0] * 0.5f + 0.5f;
+
+		samples.push(n);
+	}
+}
+
 void HeightGenerator::generationHeight(const uint32_t seed, 
                                        const HeightGenerator::height_map_param_t &hmp,
-                                       UInt16Type *data, 
+                                       unsigned char *data, 
                                        const std::vector<std::pair<const int, const int>> &workSet)
 {
-    Simplex::seed(seed);
+    SeedThread(seed);
 
+	// Channels share the tiles of the work set, and the sources of the height when it is tiled too
+	if (hmp.channelCount) {
+		const bool tiledHeight = hmp.graph || (hmp.normalOutput == NormalOutputNone && !m_multiRateGrid.step &&
+											   !(m_layerCacheEnabled && hmp.multiRateStep <= 1 && !WarpEnabled(hmp)));
+		if (!tiledHeight) {
+			height_map_param_t heightOnly = hmp;
+			heightOnly.channelCount = 0;
+			generationHeight(seed, heightOnly, data, workSet);
+		}
+		generationHeightChannels(seed, hmp, data, workSet, tiledHeight);
+		return;
+	}
+
+	if (hmp.graph) {
+		generationHeightGraph(hmp, data, workSet);
+		return;
+	}
+	if (hmp.normalOutput != NormalOutputNone) {
+		generationHeightNormals(hmp, data, workSet);
+		return;
+	}
+	if (m_multiRateGrid.step) {
+		generationHeightMultiRate(hmp, data, workSet);
+		return;
+	}
+	if (m_layerCacheEnabled && hmp.multiRateStep <= 1 && !WarpEnabled(hmp)) {
+		generationHeightCached(hmp, data, workSet);
+		return;
+	}
+
+	SampleTileWriter samples(hmp, data, workSet);
+	const bool warp = WarpEnabled(hmp);
 	for (const auto & i : workSet) {
 		glm::vec2 position = (glm::vec2((float)i.first, (float)i.second)) * hmp.scale;
-        // World move "down" 0.50 to create water plane 
-        float n = Simplex::iqMatfBmEx(position, (uint8_t)hmp.octaves, glm::mat2(2.3f, -1.5f, 1.5f, 2.3f), hmp.gain) * 0.5f ;
-       
-        n *= Simplex::ridgedMF(position, 1.0f, hmp.octaves, 2.0f, hmp.gain+0.1f) * 0.5f + 0.5f;
-        n *= Simplex::worleyfBm(position, hmp.octaves, 2.0f, hmp.gain + 0.2f) * 0.5f + 0.5f;
-        
-		data[i.first + i.second*hmp.resolution] = (UInt16Type)(glm::clamp(double(n), 0.0, 1.0) * 65535.0);
+		if (warp)
+			position = WarpPosition<false>(position, hmp);
+		samples.push(TerrainHeight(position, hmp));
+	}
+
+}
+
+void HeightGenerator::generationHeightChannels(const uint32_t seed,
+												const HeightGenerator::height_map_param_t &hmp,
+												unsigned char *data,
+												const std::vector<std::pair<const int, const int>> &workSet,
+												const bool withHeight)
+{
+	typedef struct channel_pass_t {
+		const HeightGraph *graph;
+		uint32_t seed;
+		// Has a source in common with another pass of its seed, reads the sources through the tile cache
+		bool shared;
+		std::unique_ptr<SampleTileWriter> samples;
+	}channel_pass_t;
+
+	HeightGraph terrain;
+	const HeightGraph *heightGraph = hmp.graph;
+	if (withHeight && !heightGraph) {
+		terrain = HeightGraph::Terrain(hmp.ridgedGainOffset, hmp.worleyGainOffset);
+		terrain.compile();
+		heightGraph = &terrain;
+	}
+
+	// The height first, then the channels grouped by seed so each tile seeds every group once
+	const int bytes = SampleFormatBytes(hmp.sampleFormat);
+	const bool interleaved = hmp.channelLayout == ChannelLayoutInterleaved;
+	unsigned char *channelData = m_generatedChannels.data();
+	std::vector<channel_pass_t> passes;
+	passes.reserve(hmp.channelCount + 1);
+	if (withHeight) {
+		channel_pass_t pass = { heightGraph, seed, false, std::unique_ptr<SampleTileWriter>(new SampleTileWriter(hmp, data, workSet)) };
+		passes.push_back(std::move(pass));
+	}
+	std::vector<int> order(hmp.channelCount);
+	for (int c = 0; c < hmp.channelCount; ++c)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&hmp](const int a, const int b) {
+		return hmp.channels[a].seedOffset < hmp.channels[b].seedOffset;
+	});
+	for (const int c : order) {
+		unsigned char *base = interleaved ? channelData + size_t(c) * bytes :
+											channelData + size_t(c) * size_t(m_generatedPixels) * bytes;
+		channel_pass_t pass = { hmp.channels[c].graph, seed + hmp.channels[c].seedOffset, false,
+								std::unique_ptr<SampleTileWriter>(new SampleTileWriter(hmp, base, workSet, interleaved ? hmp.channelCount : 1)) };
+		passes.push_back(std::move(pass));
 	}
 
+	int registerCount = 1;
+	for (auto & pass : passes) {
+		registerCount = std::max(registerCount, pass.graph->registerCount());
+		for (const auto & ins : pass.graph->program()) {
+			if (ins.node.type > HeightGraph::NodeFbm)
+				continue;
+			int uses = 0;
+			for (const auto & other : passes) {
+				if (other.seed != pass.seed)
+					continue;
+				for (const auto & otherIns : other.graph->program())
+					uses += otherIns.node.type <= HeightGraph::NodeFbm && SameSource(ins.node, otherIns.node, hmp.octaves);
+			}
+			pass.shared = pass.shared || uses > 1;
+		}
+	}
+
+	std::vector<float> registers(size_t(registerCount) * GRAPH_TILE_PIXELS);
+	glm::vec2 positions[GRAPH_TILE_PIXELS];
+	source_tile_cache_t sources;
+	for (size_t begin = 0; begin < workSet.size(); begin += GRAPH_TILE_PIXELS) {
+		const int count = static_cast<int>(std::min(workSet.size() - begin, size_t(GRAPH_TILE_PIXELS)));
+		for (int k = 0; k < count; ++k) {
+			const auto & i = workSet[begin + k];
+			positions[k] = (glm::vec2((float)i.first, (float)i.second)) * hmp.scale;
+		}
+		WarpTile(hmp, positions, count);
+
+		for (size_t p = 0; p < passes.size(); ++p) {
+			const channel_pass_t &pass = passes[p];
+			if (!p || pass.seed != passes[p - 1].seed) {
+				SeedThread(pass.seed);
+				sources.used = 0;
+			}
+			const float *heights = GraphTile(*pass.graph, hmp, positions, count, registers.data(),
+											 pass.shared ? &sources : nullptr);
+			for (int k = 0; k < count; ++k)
+				pass.samples->push(heights[k]);
+		}
+	}
 }
 
 void HeightGenerator::generationHeightMapMultiThread(HeightGenerator::thread_info *threadInfo, 
-                                                     UInt16Type *data, 
+                                                     unsigned char *data, 
                                                      const std::vector<std::pair<const int, const int>> &workSet)
 {
     
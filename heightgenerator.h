@@ -16,6 +16,10 @@
 #include <vector>
 #include <string>
 
+class HeightGraph;
+class HeightQuadTree;
+class HeightErosion;
+
 class HeightGenerator
 {
 private:
@@ -28,22 +32,134 @@ private:
 	};
 
 public:
+	// Sample type of generatedSamples(), heights are 0 - 1 in every format
+	enum SampleFormat : short {
+		SampleFormatUInt16 = 0,
+		SampleFormatUInt8,
+		SampleFormatFloat32,
+		// IEEE 754 binary16
+		SampleFormatFloat16
+	};
+
+	enum NormalOutput : short {
+		NormalOutputNone = 0,
+		// Octahedral encoded unit normal (x, y along the map axes, z up), 2 x 16 / 2 x 8 bit per pixel
+		NormalOutputOctahedral16,
+		NormalOutputOctahedral8,
+		// Slope angle (0 - 90 degrees) and downhill aspect (0 - 360 degrees), 2 x 16 / 2 x 8 bit per pixel
+		NormalOutputSlope16,
+		NormalOutputSlope8
+	};
+
+	enum ChannelLayout : short {
+		// Channel after channel, each a full row major map
+		ChannelLayoutPlanar = 0,
+		// All channels of a pixel next to each other
+		ChannelLayoutInterleaved
+	};
+
+	// Auxiliary channel (moisture, temperature, masks, ...) generated in the same pass as the height
+	typedef struct channel_param_t {
+		channel_param_t() : graph(nullptr), seedOffset(0) {}
+		channel_param_t(const HeightGraph *graphInp, const unsigned int seedOffsetInp) :
+			graph(graphInp), seedOffset(seedOffsetInp) {}
+		// Recipe of the channel, not owned. Null: built-in terrain formula
+		const HeightGraph *graph;
+		// Added to the generate seed. Channels with the same offset as each other or as the
+		// height (0) share the permutation table and every noise source they have in common
+		unsigned int seedOffset;
+	}channel_param_t;
+
 	typedef struct height_map_param_t {
 		height_map_param_t(const int resolutionInp,
 			const float gainInp,
 			const int octaveInput,
 			const float scaleInput) : resolution(resolutionInp),
-			gain(gainInp), octaves(octaveInput), scale(scaleInput) {}
-		height_map_param_t() : resolution(0), gain(0.0f), octaves(0), scale(0.0f) {}
+			gain(gainInp), octaves(octaveInput), scale(scaleInput),
+			ridgedGainOffset(0.1f), worleyGainOffset(0.2f), graph(nullptr),
+			multiRateStep(0), multiRateMaxError(0), warpStrength(0.0f), warpFrequency(1.0f), warpOctaves(4),
+			normalOutput(NormalOutputNone), normalHeightScale(256.0f), sampleFormat(SampleFormatUInt16),
+			channels(nullptr), channelCount(0), channelLayout(ChannelLayoutPlanar), erosion(nullptr),
+			blockCompression(false) {}
+		height_map_param_t() : resolution(0), gain(0.0f), octaves(0), scale(0.0f),
+			ridgedGainOffset(0.1f), worleyGainOffset(0.2f), graph(nullptr),
+			multiRateStep(0), multiRateMaxError(0), warpStrength(0.0f), warpFrequency(1.0f), warpOctaves(4),
+			normalOutput(NormalOutputNone), normalHeightScale(256.0f), sampleFormat(SampleFormatUInt16),
+			channels(nullptr), channelCount(0), channelLayout(ChannelLayoutPlanar), erosion(nullptr),
+			blockCompression(false) {}
 		int resolution;
 		float gain;
 		int octaves;
 		float scale;
+		// Per layer gain, relative to gain
+		float ridgedGainOffset;
+		float worleyGainOffset;
+		// Optional layer graph replacing the built-in terrain formula, not owned.
+		// Null: built-in formula
+		const HeightGraph *graph;
+		// Multi-rate evaluation of the built-in formula: octaves that vary slowly over
+		// multiRateStep pixels are sampled on a coarse grid and bicubic interpolated,
+		// the remaining octaves run per pixel. 0: Off, ~4 - 8 for ~0.001 scale
+		int multiRateStep;
+		// Max error in 16 bit steps, a sampled estimate and not a bound on every pixel: the
+		// error is measured on a grid of 64 x 64 pixels and the step halved until that sample
+		// is within it, down to exact evaluation. 0: Only measure
+		int multiRateMaxError;
+		// Domain warp, the map position p moves to p + warpStrength * (fBm(p * warpFrequency),
+		// fBm(p * warpFrequency + offset)) before any layer is sampled. In noise units, 0: Off.
+		// Applies to graphs and channels too, multi-rate and the layer cache are bypassed while it is on
+		float warpStrength;
+		float warpFrequency;
+		int warpOctaves;
+		// Normal or slope map computed in the height pass from the analytic layer derivatives.
+		// Graphs and erosion get theirs by central differences of the final float heights.
+		// Multi-rate and the layer cache are bypassed while it is on
+		NormalOutput normalOutput;
+		// Height of a 1.0 sample in pixels, for the normal and slope output
+		float normalHeightScale;
+		// Samples are converted to this format by the generating threads
+		SampleFormat sampleFormat;
+		// channelCount auxiliary channels, not owned. Stored in sampleFormat and channelLayout,
+		// see generatedChannels(). Null: none
+		const channel_param_t *channels;
+		int channelCount;
+		ChannelLayout channelLayout;
+		// Erosion stages run on the float heights before they are converted to sampleFormat, not owned.
+		// Normal output is recomputed from the eroded heights by central differences. generate()
+		// fails when a stage fails, see HeightErosion::apply(). Null: none
+		const HeightErosion *erosion;
+		// Also encode the samples to BC4 and the normal output to BC5 on worker threads, after erosion. See generatedHeightBC4() and HeightBlockCompression
+		bool blockCompression;
 	}height_map_param_t;
 
+	typedef struct multi_rate_error_t {
+		multi_rate_error_t() : step(0), samples(0), maxError(0), meanError(0.0f) {}
+		// Coarse step used, 0 when multi-rate was off or fell back to exact evaluation
+		int step;
+		int samples;
+		// Versus the exact formula, in 16 bit steps. Estimated from samples pixels, pixels between
+		// them can be further off
+		int maxError;
+		float meanError;
+	}multi_rate_error_t;
+
 
 	static unsigned int GenSeed();
 
+	// Heights of single points without generating a map, safe to call from any thread. x, y are pixel
+	// coordinates of a map with the same seed and params, the result is bit identical to its
+	// SampleFormatFloat32 sample. Multi-rate maps are approximations, these are the exact heights.
+	// A graph in params should be compiled, otherwise every call compiles a copy
+	static float evaluateAt(const unsigned int seed, const height_map_param_t &params, const float x, const float y);
+	// count x, y pairs, writes count samples in params.sampleFormat
+	static bool evaluateAt(const unsigned int seed, const height_map_param_t &params, const float *positions,
+						   const int count, void *samples);
+	// Samples of the width x height pixels from x, y of a map with the same seed and params, row major in
+	// params.sampleFormat, without generating the map. Safe to call from any thread, exact heights like
+	// evaluateAt(). Erosion, normals and channels need the whole map and are not applied
+	static bool generateRegion(const unsigned int seed, const height_map_param_t &params, const int x, const int y,
+							   const int width, const int height, void *samples);
+
 	HeightGenerator();
 	~HeightGenerator();
 
@@ -55,10 +171,58 @@ public:
 				  // Disable : Leave blank
 				  const std::string &rawOutput = "",
 				  const std::string &pngOutput = "");
+	bool generate(const unsigned int seed, const height_map_param_t &params,
+				  const std::string &rawOutput = "",
+				  const std::string &pngOutput = "");
 
+	// Keeps the partial octave sums of each built-in layer between generate calls. A layer is only
+	// recomputed when its own inputs change, added octaves continue from the cached sums.
+	// Costs 24 bytes per pixel
+	void setLayerCacheEnabled(const bool enable);
+	inline bool layerCacheEnabled() {
+		return m_layerCacheEnabled;
+	}
+	void clearLayerCache();
+
+	// Builds a min/max quadtree for ray casts over every generated or loaded map
+	void setQuadTreeEnabled(const bool enable);
+	inline bool quadTreeEnabled() {
+		return m_quadTree != nullptr;
+	}
+	// Null unless enabled
+	inline const HeightQuadTree *generatedQuadTree() {
+		return m_quadTree;
+	}
+
+	// Journals the samples (normals, channels) of every finished band of rowsPerCheckpoint rows to a
+	// sidecar file while generate runs. A generate with the same seed and params after a crash loads the
+	// bands found in the journal and only generates the rest. The journal is removed when generate
+	// succeeds. Empty path: Off. Multi-rate and layer cache runs are not journaled
+	void setCheckpoint(const std::string &journalPath, const int rowsPerCheckpoint = 256);
+	inline const std::string &checkpointPath() {
+		return m_checkpointPath;
+	}
+	// Rows the last generate loaded from the journal instead of generating them
+	inline int checkpointResumedRows() {
+		return m_checkpointResumedRows;
+	}
+	// The last generate could not write the journal. The map was still generated, but a crash during it
+	// would have started over
+	inline bool checkpointFailed() {
+		return m_checkpointFailed;
+	}
+
+	// Null unless the samples are SampleFormatUInt16, see generatedSamples()
 	inline const UInt16Type * generatedData() {
+		return m_generatedParam.sampleFormat == SampleFormatUInt16 ? reinterpret_cast<const UInt16Type *>(m_generatedData) : nullptr;
+	}
+	// Samples in generatedSampleFormat(), row major
+	inline const void * generatedSamples() {
 		return m_generatedData;
 	}
+	inline SampleFormat generatedSampleFormat() {
+		return m_generatedParam.sampleFormat;
+	}
 	inline int generatedPixels() {
 		return m_generatedPixels;
 	}
@@ -71,16 +235,90 @@ public:
         return m_generatedSeedUsed;
     }
 
-    bool saveGeneratedData(const std::string &savePath);
+	// See NormalOutput for the layout, null when no normal output was requested
+	inline const unsigned char *generatedNormalData() {
+		return m_generatedNormals.empty() ? nullptr : m_generatedNormals.data();
+	}
+	// Auxiliary channel samples in generatedSampleFormat(), laid out as generatedParam().channelLayout.
+	// Null when no channels were requested
+	inline const void *generatedChannels() {
+		return m_generatedChannels.empty() ? nullptr : m_generatedChannels.data();
+	}
+	// Block compressed samples and normal output, HeightBlockCompression::BC4Bytes() / BC5Bytes() of the
+	// resolution. Null unless blockCompression was set (and a normal output requested for BC5)
+	inline const unsigned char *generatedHeightBC4() {
+		return m_generatedHeightBC4.empty() ? nullptr : m_generatedHeightBC4.data();
+	}
+	inline const unsigned char *generatedNormalBC5() {
+		return m_generatedNormalBC5.empty() ? nullptr : m_generatedNormalBC5.data();
+	}
+	inline int generatedChannelCount() {
+		return m_generatedChannels.empty() ? 0 : m_generatedParam.channelCount;
+	}
+	// Value in 0 - 1 of channel at pixel index
+	float generatedChannelHeight(const int channel, const size_t index);
+
+	static int SampleFormatBytes(const SampleFormat format);
+	// Height in 0 - 1 of sample index
+	static float SampleHeight(const SampleFormat format, const void *samples, const size_t index);
+	static float HalfToFloat(const unsigned short half);
+	static unsigned short FloatToHalf(const float value);
+
+	// Unit normal from an octahedral encoded pair in 0 - 1
+	static void DecodeOctahedralNormal(const float u, const float v, float *normal);
+
+	inline const multi_rate_error_t &generatedMultiRateError() {
+		return m_multiRateError;
+	}
+
+    // maxError 0 or more encodes the samples with HeightCodec, lossless at 0 and at most maxError 16 bit
+    // steps off above. -1 stores them as they are
+    bool saveGeneratedData(const std::string &savePath, const int maxError = -1);
     bool loadGeneratedData(const std::string &loadPath);
 
 	void freeGeneratedData();
 
 private:
+	enum Layer {
+		LayerIq = 0,
+		LayerRidged,
+		LayerWorley,
+		LayerCount
+	};
+
+	typedef struct layer_cache_t {
+		layer_cache_t() : seed(0), resolution(0), scale(0.0f), gain(0.0f), octaves(0), fromOctave(0) {}
+		// Key
+		uint32_t seed;
+		int resolution;
+		float scale;
+		float gain;
+		// Octaves summed into state
+		int octaves;
+		// First octave the running generation has to evaluate
+		int fromOctave;
+		std::vector<float> state;
+	}layer_cache_t;
+
+	typedef struct multi_rate_grid_t {
+		multi_rate_grid_t() : step(0), width(0), height(0), valuesPerNode(0) {
+			cutoff[0] = cutoff[1] = cutoff[2] = 0;
+		}
+		int step;
+		// Nodes, with one extra node before and two after the map for the bicubic support
+		int width;
+		int height;
+		// Octaves [0, cutoff) of each layer are sampled on the grid
+		int cutoff[LayerCount];
+		// Per node: dnoise of each iq octave, then noise of each ridged octave, then each worley octave
+		int valuesPerNode;
+		std::vector<float> values;
+	}multi_rate_grid_t;
+
 	class thread_info {
 	public:
 		thread_info(HeightGenerator *self,
-			UInt16Type *data,
+			unsigned char *data,
 			const height_map_param_t paramsInp,
             const uint32_t seedInp,
 			const std::vector<std::pair<const int, const int>> &workSet) :
@@ -98,13 +336,41 @@ private:
 		std::thread *thread;
 	};
 
-	void generationHeight(const uint32_t seed, const height_map_param_t &hmp, UInt16Type *data, const std::vector<std::pair<const int, const int>> &workSet);
-	void generationHeightMapMultiThread(thread_info *threadInfo, UInt16Type *data, const std::vector<std::pair<const int, const int>> &workSet);
+	void generationHeight(const uint32_t seed, const height_map_param_t &hmp, unsigned char *data, const std::vector<std::pair<const int, const int>> &workSet);
+	void generationHeightGraph(const height_map_param_t &hmp, unsigned char *data, const std::vector<std::pair<const int, const int>> &workSet);
+	void generationHeightMultiRate(const height_map_param_t &hmp, unsigned char *data, const std::vector<std::pair<const int, const int>> &workSet);
+	void generationHeightNormals(const height_map_param_t &hmp, unsigned char *data, const std::vector<std::pair<const int, const int>> &workSet);
+	void generationHeightCached(const height_map_param_t &hmp, unsigned char *data, const std::vector<std::pair<const int, const int>> &workSet);
+	void generationHeightChannels(const uint32_t seed, const height_map_param_t &hmp, unsigned char *data, const std::vector<std::pair<const int, const int>> &workSet, const bool withHeight);
+	void generationHeightMapMultiThread(thread_info *threadInfo, unsigned char *data, const std::vector<std::pair<const int, const int>> &workSet);
+	void prepareLayerCache(const uint32_t seed, const height_map_param_t &hmp);
+	void prepareMultiRate(const uint32_t seed, const height_map_param_t &hmp, const int step);
+	void measureMultiRateError(const uint32_t seed, const height_map_param_t &hmp);
+	// Rows [firstRow, endRow), -1: to the last row
+	void generateHeights(const uint32_t seed, const height_map_param_t &hmp, const int firstRow = 0, const int endRow = -1);
+	// generateHeights() band by band through the checkpoint journal, false when the journal can not be written
+	bool generateHeightsCheckpointed(const uint32_t seed, const height_map_param_t &hmp);
 
-	UInt16Type *m_generatedData;
+	unsigned char *m_generatedData;
+	std::vector<unsigned char> m_generatedNormals;
+	std::vector<unsigned char> m_generatedChannels;
+	std::vector<unsigned char> m_generatedHeightBC4;
+	std::vector<unsigned char> m_generatedNormalBC5;
 	int m_generatedPixels;
 	height_map_param_t m_generatedParam;
     unsigned int m_generatedSeedUsed;
+
+	bool m_layerCacheEnabled;
+	HeightQuadTree *m_quadTree;
+	layer_cache_t m_layerCache[LayerCount];
+
+	multi_rate_grid_t m_multiRateGrid;
+	multi_rate_error_t m_multiRateError;
+
+	std::string m_checkpointPath;
+	int m_checkpointRows;
+	int m_checkpointResumedRows;
+	bool m_checkpointFailed;
 };
 
 #endif
\ No newline at end of file
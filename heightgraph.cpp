@@ -0,0 +1,451 @@
+/****************************************************************
+* Name:       heightgraph.cpp
+* Purpose:    Declarative noise layer graph for the height map generator
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heightgraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+
+static const char *NODE_TYPE_NAMES[HeightGraph::NodeTypeCount] = {
+	"iq", "ridged", "worley", "fbm", "const",
+	"add", "sub", "mul", "min", "max", "lerp",
+	"remap", "abs", "clamp"
+};
+
+static const int NODE_INPUT_COUNT[HeightGraph::NodeTypeCount] = {
+	0, 0, 0, 0, 0,
+	2, 2, 2, 2, 2, 3,
+	1, 1, 1
+};
+
+// Simplex takes octave counts as uint8_t
+static const int GRAPH_MAX_OCTAVES = 255;
+
+// Whether key is a parameter of nodes of type, as toString() writes them
+static bool NodeHasParameter(const HeightGraph::NodeType type, const std::string &key)
+{
+	if (key == "frequency" || key == "gain_offset" || key == "octaves" || key == "lacunarity")
+		return HeightGraph::IsSource(type) && type != HeightGraph::NodeConstant;
+	if (key == "ridge_offset")
+		return type == HeightGraph::NodeRidged;
+	if (key == "value")
+		return type == HeightGraph::NodeConstant;
+	if (key == "mul" || key == "add")
+		return type == HeightGraph::NodeRemap;
+	if (key == "min" || key == "max")
+		return type == HeightGraph::NodeClamp;
+	return false;
+}
+
+static std::string FloatToString(const float value)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.9g", value);
+	return buf;
+}
+
+HeightGraph::HeightGraph() : m_output(-1), m_compiled(false), m_registerCount(0), m_outputRegister(-1),
+	m_fastPath(FastPathNone), m_fastPathMask(0)
+{
+}
+
+HeightGraph HeightGraph::Terrain(const float ridgedGainOffset, const float worleyGainOffset)
+{
+	HeightGraph g;
+	// World move "down" 0.50 to create water plane
+	const int base = g.remap(g.iq(), 0.5f);
+	const int ridges = g.remap(g.ridged(1.0f, ridgedGainOffset), 0.5f, 0.5f);
+	const int cells = g.remap(g.worley(1.0f, worleyGainOffset), 0.5f, 0.5f);
+	g.setOutput(g.mul(g.mul(base, ridges), cells));
+	return g;
+}
+
+int HeightGraph::iq(const float frequency, const float gainOffset, const int octaves)
+{
+	node_t n;
+	n.type = NodeIq;
+	n.frequency = frequency;
+	n.gainOffset = gainOffset;
+	n.octaves = octaves;
+	return addNode(n);
+}
+
+int HeightGraph::ridged(const float frequency, const float gainOffset, const int octaves,
+						const float ridgeOffset, const float lacunarity)
+{
+	node_t n;
+	n.type = NodeRidged;
+	n.frequency = frequency;
+	n.gainOffset = gainOffset;
+	n.octaves = octaves;
+	n.ridgeOffset = ridgeOffset;
+	n.lacunarity = lacunarity;
+	return addNode(n);
+}
+
+int HeightGraph::worley(const float frequency, const float gainOffset, const int octaves, const float lacunarity)
+{
+	node_t n;
+	n.type = NodeWorley;
+	n.frequency = frequency;
+	n.gainOffset = gainOffset;
+	n.octaves = octaves;
+	n.lacunarity = lacunarity;
+	return addNode(n);
+}
+
+int HeightGraph::fbm(const float frequency, const float gainOffset, const int octaves, const float lacunarity)
+{
+	node_t n;
+	n.type = NodeFbm;
+	n.frequency = frequency;
+	n.gainOffset = gainOffset;
+	n.octaves = octaves;
+	n.lacunarity = lacunarity;
+	return addNode(n);
+}
+
+int HeightGraph::constant(const float value)
+{
+	node_t n;
+	n.type = NodeConstant;
+	n.a = value;
+	return addNode(n);
+}
+
+static HeightGraph::node_t BinaryNode(const HeightGraph::NodeType type, const int a, const int b)
+{
+	HeightGraph::node_t n;
+	n.type = type;
+	n.inputs[0] = a;
+	n.inputs[1] = b;
+	return n;
+}
+
+int HeightGraph::add(const int a, const int b) { return addNode(BinaryNode(NodeAdd, a, b)); }
+int HeightGraph::sub(const int a, const int b) { return addNode(BinaryNode(NodeSub, a, b)); }
+int HeightGraph::mul(const int a, const int b) { return addNode(BinaryNode(NodeMul, a, b)); }
+int HeightGraph::min(const int a, const int b) { return addNode(BinaryNode(NodeMin, a, b)); }
+int HeightGraph::max(const int a, const int b) { return addNode(BinaryNode(NodeMax, a, b)); }
+
+int HeightGraph::lerp(const int a, const int b, const int t)
+{
+	node_t n = BinaryNode(NodeLerp, a, b);
+	n.inputs[2] = t;
+	return addNode(n);
+}
+
+int HeightGraph::remap(const int input, const float mul, const float add)
+{
+	node_t n;
+	n.type = NodeRemap;
+	n.inputs[0] = input;
+	n.a = mul;
+	n.b = add;
+	return addNode(n);
+}
+
+int HeightGraph::abs(const int input)
+{
+	node_t n;
+	n.type = NodeAbs;
+	n.inputs[0] = input;
+	return addNode(n);
+}
+
+int HeightGraph::clamp(const int input, const float lo, const float hi)
+{
+	node_t n;
+	n.type = NodeClamp;
+	n.inputs[0] = input;
+	n.a = lo;
+	n.b = hi;
+	return addNode(n);
+}
+
+int HeightGraph::addNode(const node_t &node)
+{
+	m_compiled = false;
+	m_nodes.push_back(node);
+	// The last added node is the output until told otherwise
+	m_output = static_cast<int>(m_nodes.size()) - 1;
+	return m_output;
+}
+
+void HeightGraph::setOutput(const int node)
+{
+	m_compiled = false;
+	m_output = node;
+}
+
+bool HeightGraph::parse(const std::string &text)
+{
+	*this = HeightGraph();
+
+	std::map<std::string, int> names;
+	std::istringstream lines(text);
+	std::string line;
+	int lineNumber = 0;
+	bool outputSet = false;
+
+	while (std::getline(lines, line)) {
+		++lineNumber;
+		const size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+
+		std::istringstream tokens(line);
+		std::vector<std::string> words;
+		std::string word;
+		while (tokens >> word)
+			words.push_back(word);
+		if (words.empty())
+			continue;
+
+		const std::string where = "line " + std::to_string(lineNumber) + ": ";
+		if (words[0] == "output") {
+			if (words.size() != 2 || !names.count(words[1]))
+				return fail(where + "output expects a defined node name");
+			m_output = names[words[1]];
+			outputSet = true;
+			continue;
+		}
+		if (words.size() < 3 || words[1] != "=")
+			return fail(where + "expected <name> = <op> ...");
+		if (names.count(words[0]))
+			return fail(where + "node '" + words[0] + "' is already defined");
+
+		node_t n;
+		int type = 0;
+		while (type < NodeTypeCount && words[2] != NODE_TYPE_NAMES[type])
+			++type;
+		if (type == NodeTypeCount)
+			return fail(where + "unknown op '" + words[2] + "'");
+		n.type = static_cast<NodeType>(type);
+		// Remap defaults to identity, clamp to the unit range
+		if (n.type == NodeRemap)
+			n.a = 1.0f;
+		else if (n.type == NodeClamp)
+			n.b = 1.0f;
+
+		int inputs = 0;
+		for (size_t i = 3; i < words.size(); ++i) {
+			const size_t eq = words[i].find('=');
+			if (eq == std::string::npos) {
+				if (inputs >= NodeInputCount(n.type) || !names.count(words[i]))
+					return fail(where + "unexpected input '" + words[i] + "'");
+				n.inputs[inputs++] = names[words[i]];
+				continue;
+			}
+			const std::string key = words[i].substr(0, eq);
+			const std::string valueText = words[i].substr(eq + 1);
+			char *end = nullptr;
+			const float value = strtof(valueText.c_str(), &end);
+			if (valueText.empty() || *end != '\0')
+				return fail(where + "bad value for '" + key + "'");
+
+			if (!NodeHasParameter(n.type, key))
+				return fail(where + "'" + words[2] + "' has no parameter '" + key + "'");
+			if (key == "octaves" && !(value >= 0.0f && value <= GRAPH_MAX_OCTAVES && value == std::floor(value)))
+				return fail(where + "octaves must be a whole number from 0 to " + std::to_string(GRAPH_MAX_OCTAVES));
+
+			if (key == "frequency") n.frequency = value;
+			else if (key == "gain_offset") n.gainOffset = value;
+			else if (key == "lacunarity") n.lacunarity = value;
+			else if (key == "ridge_offset") n.ridgeOffset = value;
+			else if (key == "octaves") n.octaves = static_cast<int>(value);
+			else if (key == "value" || key == "mul" || key == "min") n.a = value;
+			else if (key == "add" || key == "max") n.b = value;
+		}
+		if (inputs != NodeInputCount(n.type))
+			return fail(where + "'" + words[2] + "' expects " + std::to_string(NodeInputCount(n.type)) + " inputs");
+
+		names[words[0]] = addNode(n);
+	}
+	if (m_nodes.empty())
+		return fail("empty graph");
+	if (!outputSet)
+		m_output = static_cast<int>(m_nodes.size()) - 1;
+	return true;
+}
+
+std::string HeightGraph::toString() const
+{
+	std::string text;
+	for (size_t i = 0; i < m_nodes.size(); ++i) {
+		const node_t &n = m_nodes[i];
+		text += "n" + std::to_string(i) + " = " + NODE_TYPE_NAMES[n.type];
+		for (int k = 0; k < NodeInputCount(n.type); ++k)
+			text += " n" + std::to_string(n.inputs[k]);
+
+		if (IsSource(n.type) && n.type != NodeConstant) {
+			text += " frequency=" + FloatToString(n.frequency);
+			text += " gain_offset=" + FloatToString(n.gainOffset);
+			text += " octaves=" + std::to_string(n.octaves);
+			text += " lacunarity=" + FloatToString(n.lacunarity);
+			if (n.type == NodeRidged)
+				text += " ridge_offset=" + FloatToString(n.ridgeOffset);
+		}
+		else if (n.type == NodeConstant) {
+			text += " value=" + FloatToString(n.a);
+		}
+		else if (n.type == NodeRemap) {
+			text += " mul=" + FloatToString(n.a) + " add=" + FloatToString(n.b);
+		}
+		else if (n.type == NodeClamp) {
+			text += " min=" + FloatToString(n.a) + " max=" + FloatToString(n.b);
+		}
+		text += "\n";
+	}
+	if (m_output >= 0)
+		text += "output n" + std::to_string(m_output) + "\n";
+	return text;
+}
+
+bool HeightGraph::compile()
+{
+	m_compiled = false;
+	m_program.clear();
+	m_registerCount = 0;
+	m_outputRegister = -1;
+	m_fastPath = FastPathNone;
+	m_fastPathMask = 0;
+
+	const int nodeCount = static_cast<int>(m_nodes.size());
+	if (m_output < 0 || m_output >= nodeCount)
+		return fail("graph has no output");
+
+	// Inputs always reference earlier nodes, so ascending ids is a topological order
+	for (int i = 0; i < nodeCount; ++i) {
+		const node_t &n = m_nodes[i];
+		if (n.type < 0 || n.type >= NodeTypeCount)
+			return fail("node " + std::to_string(i) + " has an invalid type");
+		for (int k = 0; k < NodeInputCount(n.type); ++k) {
+			if (n.inputs[k] < 0 || n.inputs[k] >= i)
+				return fail("node " + std::to_string(i) + " has an invalid input");
+		}
+		if (n.octaves < 0 || n.octaves > GRAPH_MAX_OCTAVES)
+			return fail("node " + std::to_string(i) + " has an invalid octave count");
+	}
+
+	// Mark the nodes the output depends on, and the last instruction reading each
+	std::vector<bool> live(nodeCount, false);
+	std::vector<int> lastUse(nodeCount, -1);
+	live[m_output] = true;
+	for (int i = m_output; i >= 0; --i) {
+		if (!live[i])
+			continue;
+		const node_t &n = m_nodes[i];
+		for (int k = 0; k < NodeInputCount(n.type); ++k) {
+			live[n.inputs[k]] = true;
+			lastUse[n.inputs[k]] = std::max(lastUse[n.inputs[k]], i);
+		}
+	}
+
+	// Linear scan register allocation, a register is released after its last reader
+	std::vector<int> nodeRegister(nodeCount, -1);
+	std::vector<int> freeRegisters;
+	for (int i = 0; i <= m_output; ++i) {
+		if (!live[i])
+			continue;
+		const node_t &n = m_nodes[i];
+		instruction_t ins;
+		ins.node = n;
+		ins.src[0] = ins.src[1] = ins.src[2] = -1;
+		for (int k = 0; k < NodeInputCount(n.type); ++k)
+			ins.src[k] = nodeRegister[n.inputs[k]];
+		for (int k = 0; k < NodeInputCount(n.type); ++k) {
+			const int input = n.inputs[k];
+			if (lastUse[input] == i && nodeRegister[input] >= 0) {
+				freeRegisters.push_back(nodeRegister[input]);
+				nodeRegister[input] = -1;
+			}
+		}
+		if (freeRegisters.empty()) {
+			ins.dst = m_registerCount++;
+		}
+		else {
+			ins.dst = freeRegisters.back();
+			freeRegisters.pop_back();
+		}
+		nodeRegister[i] = ins.dst;
+		m_program.push_back(ins);
+	}
+	m_outputRegister = nodeRegister[m_output];
+
+	detectFastPath();
+	m_compiled = true;
+	return true;
+}
+
+void HeightGraph::detectFastPath()
+{
+	// Matches [clamp 0..1] mul(mul(remap(iq), remap(ridged)), remap(worley)) and its ordered subsets
+	int node = m_output;
+	if (m_nodes[node].type == NodeClamp && m_nodes[node].a == 0.0f && m_nodes[node].b == 1.0f)
+		node = m_nodes[node].inputs[0];
+
+	std::vector<int> terms;
+	while (m_nodes[node].type == NodeMul) {
+		terms.push_back(m_nodes[node].inputs[1]);
+		node = m_nodes[node].inputs[0];
+	}
+	terms.push_back(node);
+
+	int mask = 0;
+	int previousLayer = -1;
+	node_t layers[3];
+	// terms are collected right to left
+	for (auto i = terms.rbegin(); i != terms.rend(); ++i) {
+		const node_t &remap = m_nodes[*i];
+		if (remap.type != NodeRemap)
+			return;
+		const node_t &source = m_nodes[remap.inputs[0]];
+		if (source.type != NodeIq && source.type != NodeRidged && source.type != NodeWorley)
+			return;
+		if (source.type <= previousLayer)
+			return;
+		previousLayer = source.type;
+		layers[source.type] = source;
+		layers[source.type].a = remap.a;
+		layers[source.type].b = remap.b;
+		mask |= 1 << source.type;
+	}
+	m_fastPath = FastPathLayerProduct;
+	m_fastPathMask = mask;
+	for (int i = 0; i < 3; ++i)
+		m_fastPathLayers[i] = layers[i];
+}
+
+const char *HeightGraph::NodeTypeName(const NodeType type)
+{
+	return type >= 0 && type < NodeTypeCount ? NODE_TYPE_NAMES[type] : "";
+}
+
+int HeightGraph::NodeInputCount(const NodeType type)
+{
+	return type >= 0 && type < NodeTypeCount ? NODE_INPUT_COUNT[type] : 0;
+}
+
+bool HeightGraph::IsSource(const NodeType type)
+{
+	return type <= NodeConstant;
+}
+
+bool HeightGraph::fail(const std::string &error)
+{
+	m_error = error;
+	m_compiled = false;
+	return false;
+}
@@ -0,0 +1,176 @@
+/****************************************************************
+* Name:       heightgraph.h
+* Purpose:    Declarative noise layer graph for the height map generator
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_GRAPH_H
+#define HEIGHT_GRAPH_H
+
+#include <vector>
+#include <string>
+
+// A graph of noise sources, combine operators, remaps and clamps that replaces the built-in
+// terrain formula. Graphs are built in code or parsed from text, and lowered by compile() into
+// a linear register program the generator runs tile by tile, without full size buffers.
+//
+// Text format, one node per line, '#' starts a comment:
+//   base   = iq
+//   ridges = ridged gain_offset=0.1
+//   cells  = worley gain_offset=0.2
+//   a      = remap base mul=0.5
+//   b      = remap ridges mul=0.5 add=0.5
+//   c      = remap cells mul=0.5 add=0.5
+//   ab     = mul a b
+//   out    = mul ab c
+//   output out
+//
+// Noise sources take frequency, gain_offset, octaves (0 - 255) and lacunarity, ridged also ridge_offset.
+// const takes value, remap mul and add, clamp min and max. Other parameters are parse errors
+class HeightGraph
+{
+public:
+	enum NodeType : short {
+		// Sources, sampled at the pixel position
+		NodeIq = 0,		// Simplex::iqMatfBmEx
+		NodeRidged,		// Simplex::ridgedMF
+		NodeWorley,		// Simplex::worleyfBm
+		NodeFbm,		// Simplex::fBm
+		NodeConstant,	// a
+		// Combine
+		NodeAdd,
+		NodeSub,
+		NodeMul,
+		NodeMin,
+		NodeMax,
+		NodeLerp,		// mix(input 0, input 1, input 2)
+		// Remap
+		NodeRemap,		// input * a + b
+		NodeAbs,
+		NodeClamp,		// clamp(input, a, b)
+		NodeTypeCount
+	};
+
+	// Specialized kernels for common graph shapes, selected by compile()
+	enum FastPath : short {
+		FastPathNone = 0,
+		// Product of remapped iq, ridged and worley layers, in that order, any subset
+		FastPathLayerProduct
+	};
+
+	typedef struct node_t {
+		node_t() : type(NodeConstant), frequency(1.0f), gainOffset(0.0f), lacunarity(2.0f),
+			ridgeOffset(1.0f), octaves(0), a(0.0f), b(0.0f) {
+			inputs[0] = inputs[1] = inputs[2] = -1;
+		}
+		NodeType type;
+		int inputs[3];
+		// Sources. Gain is relative to height_map_param_t::gain, 0 octaves uses height_map_param_t::octaves
+		float frequency;
+		float gainOffset;
+		float lacunarity;
+		float ridgeOffset;
+		int octaves;
+		// Constant, remap and clamp operands
+		float a;
+		float b;
+	}node_t;
+
+	typedef struct instruction_t {
+		node_t node;
+		int dst;
+		int src[3];
+	}instruction_t;
+
+	HeightGraph();
+
+	// The built-in terrain formula expressed as a graph
+	static HeightGraph Terrain(const float ridgedGainOffset = 0.1f, const float worleyGainOffset = 0.2f);
+
+	// Builders, return the node id
+	int iq(const float frequency = 1.0f, const float gainOffset = 0.0f, const int octaves = 0);
+	int ridged(const float frequency = 1.0f, const float gainOffset = 0.0f, const int octaves = 0,
+			   const float ridgeOffset = 1.0f, const float lacunarity = 2.0f);
+	int worley(const float frequency = 1.0f, const float gainOffset = 0.0f, const int octaves = 0,
+			   const float lacunarity = 2.0f);
+	int fbm(const float frequency = 1.0f, const float gainOffset = 0.0f, const int octaves = 0,
+			const float lacunarity = 2.0f);
+	int constant(const float value);
+	int add(const int a, const int b);
+	int sub(const int a, const int b);
+	int mul(const int a, const int b);
+	int min(const int a, const int b);
+	int max(const int a, const int b);
+	int lerp(const int a, const int b, const int t);
+	int remap(const int input, const float mul, const float add = 0.0f);
+	int abs(const int input);
+	int clamp(const int input, const float lo = 0.0f, const float hi = 1.0f);
+	int addNode(const node_t &node);
+	void setOutput(const int node);
+
+	// Replaces the graph with the text description, see the format above
+	bool parse(const std::string &text);
+	// Text description that parses back into the same graph
+	std::string toString() const;
+
+	// Validates and lowers the graph into the register program
+	bool compile();
+
+	inline const std::vector<node_t> &nodes() const {
+		return m_nodes;
+	}
+	inline int output() const {
+		return m_output;
+	}
+	inline bool compiled() const {
+		return m_compiled;
+	}
+	inline const std::vector<instruction_t> &program() const {
+		return m_program;
+	}
+	inline int registerCount() const {
+		return m_registerCount;
+	}
+	inline int outputRegister() const {
+		return m_outputRegister;
+	}
+	inline FastPath fastPath() const {
+		return m_fastPath;
+	}
+	// Fast path operands, indexed by NodeIq, NodeRidged and NodeWorley. The remap is stored in a and b of the layer
+	inline bool fastPathHasLayer(const int layer) const {
+		return (m_fastPathMask & (1 << layer)) != 0;
+	}
+	inline const node_t &fastPathLayer(const int layer) const {
+		return m_fastPathLayers[layer];
+	}
+	inline const std::string &error() const {
+		return m_error;
+	}
+
+	static const char *NodeTypeName(const NodeType type);
+	static int NodeInputCount(const NodeType type);
+	static bool IsSource(const NodeType type);
+
+private:
+	bool fail(const std::string &error);
+	void detectFastPath();
+
+	std::vector<node_t> m_nodes;
+	int m_output;
+
+	bool m_compiled;
+	std::vector<instruction_t> m_program;
+	int m_registerCount;
+	int m_outputRegister;
+	FastPath m_fastPath;
+	int m_fastPathMask;
+	node_t m_fastPathLayers[3];
+	std::string m_error;
+};
+
+#endif
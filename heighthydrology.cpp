@@ -0,0 +1,495 @@
+/****************************************************************
+* Name:       heighthydrology.cpp
+* Purpose:    Depression filling, flow directions and flow accumulation
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heighthydrology.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+
+
+// Pixels per side of a flood tile
+static const int HYDROLOGY_TILE = 256;
+
+// Region labels. Local labels of a tile start at LABEL_FIRST
+static const int LABEL_NONE = 0;
+static const int LABEL_SEA = 1;
+static const int LABEL_FIRST = 2;
+
+// Unresolved direction while looking for the way out of flats
+static const unsigned char FLOW_UNRESOLVED = 0xff;
+
+// Neighbour offsets in FlowDirection order, FlowEast first
+static const int FLOW_DX[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int FLOW_DY[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+typedef std::priority_queue<std::pair<float, int>, std::vector<std::pair<float, int> >,
+							std::greater<std::pair<float, int> > > flood_queue_t;
+
+// Lowest height water crosses between two regions
+typedef struct spill_t {
+	int a;
+	int b;
+	float height;
+}spill_t;
+
+typedef struct flood_tile_t {
+	int x0, y0;
+	int width, height;
+	// Local labels LABEL_FIRST to LABEL_FIRST + labelCount, global id of LABEL_FIRST
+	int labelCount;
+	int labelBase;
+	// Between local labels
+	std::vector<spill_t> spills;
+}flood_tile_t;
+
+// Runs rows(first, end) for bands of rows on up to threads threads
+template<typename Rows>
+static void ForRowBands(const int resolution, const int threads, const Rows &rows)
+{
+	if (threads == 1) {
+		rows(0, resolution);
+		return;
+	}
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t) {
+		const int first = resolution * t / threads;
+		const int end = resolution * (t + 1) / threads;
+		workers.push_back(std::thread([&rows, first, end]() { rows(first, end); }));
+	}
+	for (auto & worker : workers)
+		worker.join();
+}
+
+// Priority flood of one tile from its border and its sea pixels. filled holds the heights and is
+// raised in place, labels get the local region of every pixel
+static void FloodTile(flood_tile_t &tile, const int resolution, const float seaLevel, float *filled, int *labels,
+					  std::vector<unsigned char> &closed)
+{
+	const int width = tile.width, height = tile.height;
+	closed.assign(size_t(width) * height, 0);
+	flood_queue_t queue;
+	// Pixels raised to the level they were reached at drain in order of arrival, no sorting needed
+	std::queue<int> pit;
+	std::unordered_map<uint64_t, float> spills;
+	int nextLabel = LABEL_FIRST;
+
+	const size_t origin = size_t(tile.x0) + size_t(tile.y0) * size_t(resolution);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const int local = x + y * width;
+			const size_t i = origin + size_t(x) + size_t(y) * size_t(resolution);
+			const bool border = x == 0 || y == 0 || x == width - 1 || y == height - 1;
+			const int gx = tile.x0 + x, gy = tile.y0 + y;
+			const bool mapEdge = gx == 0 || gy == 0 || gx == resolution - 1 || gy == resolution - 1;
+			labels[i] = LABEL_NONE;
+			// The sea raises no land, its pixels flood in any order
+			if (filled[i] <= seaLevel) {
+				labels[i] = LABEL_SEA;
+				closed[local] = 1;
+				pit.push(local);
+				continue;
+			}
+			if (mapEdge)
+				labels[i] = LABEL_SEA;
+			else if (!border)
+				continue;
+			closed[local] = 1;
+			queue.push(std::make_pair(filled[i], local));
+		}
+	}
+
+	while (!pit.empty() || !queue.empty()) {
+		int local;
+		if (!pit.empty()) {
+			local = pit.front();
+			pit.pop();
+		}
+		else {
+			local = queue.top().second;
+			queue.pop();
+		}
+		const int x = local % width, y = local / width;
+		const size_t i = origin + size_t(x) + size_t(y) * size_t(resolution);
+		if (labels[i] == LABEL_NONE)
+			labels[i] = nextLabel++;
+		const int label = labels[i];
+
+		for (int d = 0; d < 8; ++d) {
+			const int nx = x + FLOW_DX[d], ny = y + FLOW_DY[d];
+			if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+				continue;
+			const int neighbour = nx + ny * width;
+			const size_t n = i + ptrdiff_t(FLOW_DX[d]) + ptrdiff_t(FLOW_DY[d]) * resolution;
+			if (labels[n] == LABEL_NONE)
+				labels[n] = label;
+			else if (labels[n] != label) {
+				const int a = std::min(label, labels[n]), b = std::max(label, labels[n]);
+				const uint64_t key = (uint64_t(a) << 32) | uint64_t(b);
+				const float spill = std::max(filled[i], filled[n]);
+				auto found = spills.find(key);
+				if (found == spills.end())
+					spills[key] = spill;
+				else
+					found->second = std::min(found->second, spill);
+			}
+			if (closed[neighbour])
+				continue;
+			closed[neighbour] = 1;
+			if (filled[n] <= filled[i]) {
+				filled[n] = filled[i];
+				pit.push(neighbour);
+			}
+			else
+				queue.push(std::make_pair(filled[n], neighbour));
+		}
+	}
+
+	tile.labelCount = nextLabel - LABEL_FIRST;
+	tile.spills.clear();
+	tile.spills.reserve(spills.size());
+	for (auto & spill : spills) {
+		spill_t s;
+		s.a = int(spill.first >> 32);
+		s.b = int(spill.first & 0xffffffffu);
+		s.height = spill.second;
+		tile.spills.push_back(s);
+	}
+	// Unordered map iteration order is not portable, the spill graph is
+	std::sort(tile.spills.begin(), tile.spills.end(), [](const spill_t &l, const spill_t &r) {
+		return l.a != r.a ? l.a < r.a : l.b < r.b;
+	});
+}
+
+static int HydrologyThreads(const int threadCount, const int resolution)
+{
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	return std::max(1, std::min(threads, resolution));
+}
+
+HeightHydrology::HeightHydrology() : m_resolution(0), m_seaLevel(0.0f)
+{
+}
+
+bool HeightHydrology::build(HeightGenerator &generator, const float seaLevel, const int threadCount)
+{
+	return build(generator.generatedSamples(), generator.generatedSampleFormat(), generator.generatedParam().resolution,
+				 seaLevel, threadCount);
+}
+
+bool HeightHydrology::build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+							const float seaLevel, const int threadCount)
+{
+	clear();
+	if (!samples || resolution < 2 || !HeightGenerator::SampleFormatBytes(format))
+		return false;
+
+	m_resolution = resolution;
+	m_seaLevel = seaLevel;
+	const size_t pixels = size_t(resolution) * size_t(resolution);
+	m_heights.resize(pixels);
+	const int threads = HydrologyThreads(threadCount, resolution);
+	ForRowBands(resolution, threads, [&](const int first, const int end) {
+		for (size_t i = size_t(first) * resolution; i < size_t(end) * resolution; ++i)
+			m_heights[i] = HeightGenerator::SampleHeight(format, samples, i);
+	});
+
+	fillPits(threads);
+	findDirections(threads);
+	accumulateFlow(threads);
+	return true;
+}
+
+void HeightHydrology::clear()
+{
+	m_heights.clear();
+	m_filled.clear();
+	m_directions.clear();
+	m_accumulation.clear();
+	m_resolution = 0;
+}
+
+int HeightHydrology::DirectionX(const FlowDirection direction)
+{
+	return direction == FlowNone ? 0 : FLOW_DX[direction - 1];
+}
+
+int HeightHydrology::DirectionY(const FlowDirection direction)
+{
+	return direction == FlowNone ? 0 : FLOW_DY[direction - 1];
+}
+
+void HeightHydrology::fillPits(const int threads)
+{
+	const int resolution = m_resolution;
+	const size_t pixels = size_t(resolution) * size_t(resolution);
+	m_filled = m_heights;
+	std::vector<int> labels(pixels);
+
+	std::vector<flood_tile_t> tiles;
+	for (int y0 = 0; y0 < resolution; y0 += HYDROLOGY_TILE) {
+		for (int x0 = 0; x0 < resolution; x0 += HYDROLOGY_TILE) {
+			flood_tile_t tile;
+			tile.x0 = x0;
+			tile.y0 = y0;
+			tile.width = std::min(HYDROLOGY_TILE, resolution - x0);
+			tile.height = std::min(HYDROLOGY_TILE, resolution - y0);
+			tile.labelCount = 0;
+			tile.labelBase = 0;
+			tiles.push_back(tile);
+		}
+	}
+
+	// Tiles flood independently, threads take the next one
+	std::atomic<int> next(0);
+	auto flood = [&]() {
+		std::vector<unsigned char> closed;
+		for (int t = next++; t < (int)tiles.size(); t = next++)
+			FloodTile(tiles[t], resolution, m_seaLevel, m_filled.data(), labels.data(), closed);
+	};
+	const int workers = std::min(threads, (int)tiles.size());
+	std::vector<std::thread> pool;
+	for (int t = 1; t < workers; ++t)
+		pool.push_back(std::thread(flood));
+	flood();
+	for (auto & worker : pool)
+		worker.join();
+
+	// Global labels, the sea is shared
+	int labelCount = LABEL_FIRST;
+	for (auto & tile : tiles) {
+		tile.labelBase = labelCount;
+		labelCount += tile.labelCount;
+	}
+	std::vector<spill_t> spills;
+	for (const auto & tile : tiles) {
+		for (const auto & spill : tile.spills) {
+			spill_t s = spill;
+			s.a = s.a >= LABEL_FIRST ? s.a - LABEL_FIRST + tile.labelBase : s.a;
+			s.b = s.b >= LABEL_FIRST ? s.b - LABEL_FIRST + tile.labelBase : s.b;
+			spills.push_back(s);
+		}
+	}
+	const int tilesPerRow = (resolution + HYDROLOGY_TILE - 1) / HYDROLOGY_TILE;
+	ForRowBands(resolution, threads, [&](const int first, const int end) {
+		for (int y = first; y < end; ++y) {
+			const flood_tile_t *row = &tiles[size_t(y / HYDROLOGY_TILE) * tilesPerRow];
+			for (int x = 0; x < resolution; ++x) {
+				int &label = labels[index(x, y)];
+				if (label >= LABEL_FIRST)
+					label += row[x / HYDROLOGY_TILE].labelBase - LABEL_FIRST;
+			}
+		}
+	});
+
+	// Spills across tile borders, pixel pairs of 8 neighbours in different tiles
+	auto border = [&](const size_t a, const size_t b) {
+		if (labels[a] == labels[b])
+			return;
+		spill_t s;
+		s.a = labels[a];
+		s.b = labels[b];
+		s.height = std::max(m_filled[a], m_filled[b]);
+		spills.push_back(s);
+	};
+	for (int edge = HYDROLOGY_TILE; edge < resolution; edge += HYDROLOGY_TILE) {
+		for (int n = 0; n < resolution; ++n) {
+			for (int d = -1; d <= 1; ++d) {
+				if (n + d < 0 || n + d >= resolution)
+					continue;
+				border(index(edge - 1, n), index(edge, n + d));
+				border(index(n, edge - 1), index(n + d, edge));
+			}
+		}
+	}
+
+	// Water level of every region, the lowest of the highest spills on the ways to the sea
+	std::vector<int> offsets(size_t(labelCount) + 1, 0);
+	for (const auto & spill : spills) {
+		++offsets[spill.a + 1];
+		++offsets[spill.b + 1];
+	}
+	for (int l = 0; l < labelCount; ++l)
+		offsets[l + 1] += offsets[l];
+	std::vector<std::pair<int, float> > edges(offsets[labelCount]);
+	{
+		std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+		for (const auto & spill : spills) {
+			edges[fill[spill.a]++] = std::make_pair(spill.b, spill.height);
+			edges[fill[spill.b]++] = std::make_pair(spill.a, spill.height);
+		}
+	}
+	const float infinity = std::numeric_limits<float>::infinity();
+	std::vector<float> levels(labelCount, infinity);
+	levels[LABEL_SEA] = -infinity;
+	flood_queue_t queue;
+	queue.push(std::make_pair(-infinity, LABEL_SEA));
+	while (!queue.empty()) {
+		const float level = queue.top().first;
+		const int label = queue.top().second;
+		queue.pop();
+		if (level > levels[label])
+			continue;
+		for (int e = offsets[label]; e < offsets[label + 1]; ++e) {
+			const float reach = std::max(level, edges[e].second);
+			if (reach < levels[edges[e].first]) {
+				levels[edges[e].first] = reach;
+				queue.push(std::make_pair(reach, edges[e].first));
+			}
+		}
+	}
+
+	ForRowBands(resolution, threads, [&](const int first, const int end) {
+		for (size_t i = size_t(first) * resolution; i < size_t(end) * resolution; ++i) {
+			const float level = levels[labels[i]];
+			if (level != infinity)
+				m_filled[i] = std::max(m_filled[i], level);
+		}
+	});
+}
+
+void HeightHydrology::findDirections(const int threads)
+{
+	const int resolution = m_resolution;
+	const float *filled = m_filled.data();
+	m_directions.assign(size_t(resolution) * size_t(resolution), FlowNone);
+	unsigned char *directions = m_directions.data();
+
+	// Steepest descent, diagonal drops over sqrt(2)
+	ForRowBands(resolution, threads, [&](const int first, const int end) {
+		for (int y = std::max(first, 1); y < std::min(end, resolution - 1); ++y) {
+			for (int x = 1; x < resolution - 1; ++x) {
+				const size_t i = index(x, y);
+				if (filled[i] <= m_seaLevel)
+					continue;
+				float steepest = 0.0f;
+				unsigned char direction = FLOW_UNRESOLVED;
+				for (int d = 0; d < 8; ++d) {
+					const float drop = (filled[i] - filled[index(x + FLOW_DX[d], y + FLOW_DY[d])]) * (d & 1 ? 0.70710678f : 1.0f);
+					if (drop > steepest) {
+						steepest = drop;
+						direction = (unsigned char)(d + 1);
+					}
+				}
+				directions[i] = direction;
+			}
+		}
+	});
+
+	// Flats drain to the neighbour of the same height they were reached from, breadth first from the
+	// flat pixels next to a way out
+	std::vector<size_t> front;
+	for (int y = 1; y < resolution - 1; ++y) {
+		for (int x = 1; x < resolution - 1; ++x) {
+			const size_t i = index(x, y);
+			if (directions[i] != FLOW_UNRESOLVED)
+				continue;
+			for (int d = 0; d < 8; ++d) {
+				const size_t n = index(x + FLOW_DX[d], y + FLOW_DY[d]);
+				if (directions[n] != FLOW_UNRESOLVED && filled[n] == filled[i]) {
+					front.push_back(i);
+					break;
+				}
+			}
+		}
+	}
+	std::vector<unsigned char> seeds(front.size());
+	for (size_t f = 0; f < front.size(); ++f) {
+		const int x = int(front[f] % resolution), y = int(front[f] / resolution);
+		for (int d = 0; d < 8; ++d) {
+			const size_t n = index(x + FLOW_DX[d], y + FLOW_DY[d]);
+			if (directions[n] != FLOW_UNRESOLVED && filled[n] == filled[front[f]]) {
+				seeds[f] = (unsigned char)(d + 1);
+				break;
+			}
+		}
+	}
+	for (size_t f = 0; f < front.size(); ++f)
+		directions[front[f]] = seeds[f];
+
+	for (size_t f = 0; f < front.size(); ++f) {
+		const int x = int(front[f] % resolution), y = int(front[f] / resolution);
+		for (int d = 0; d < 8; ++d) {
+			const int nx = x + FLOW_DX[d], ny = y + FLOW_DY[d];
+			const size_t n = index(nx, ny);
+			if (directions[n] != FLOW_UNRESOLVED || filled[n] != filled[front[f]])
+				continue;
+			// Back towards this pixel
+			directions[n] = (unsigned char)((d + 4) % 8 + 1);
+			front.push_back(n);
+		}
+	}
+
+	// Only a pit the fill missed stays unresolved
+	for (size_t i = 0; i < m_directions.size(); ++i) {
+		if (directions[i] == FLOW_UNRESOLVED)
+			directions[i] = FlowNone;
+	}
+}
+
+void HeightHydrology::accumulateFlow(const int threads)
+{
+	const int resolution = m_resolution;
+	const size_t pixels = size_t(resolution) * size_t(resolution);
+	const unsigned char *directions = m_directions.data();
+	std::vector<std::atomic<unsigned int> > donors(pixels);
+	std::vector<std::atomic<unsigned int> > accumulation(pixels);
+
+	auto receiver = [&](const size_t i) {
+		const int d = directions[i] - 1;
+		return i + ptrdiff_t(FLOW_DX[d]) + ptrdiff_t(FLOW_DY[d]) * resolution;
+	};
+
+	ForRowBands(resolution, threads, [&](const int first, const int end) {
+		for (size_t i = size_t(first) * resolution; i < size_t(end) * resolution; ++i) {
+			accumulation[i].store(1, std::memory_order_relaxed);
+			if (directions[i] != FlowNone)
+				donors[receiver(i)].fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+
+	// Every pixel without donors starts a walk downstream. The walk hands its count to the receiver
+	// and goes on only from the last donor to arrive, whose count is then complete. Every pixel is
+	// passed once and integer sums do not depend on the order. Sources are found from the directions,
+	// the donor counts change under the walks
+	ForRowBands(resolution, threads, [&](const int first, const int end) {
+		for (int y = first; y < end; ++y) {
+			for (int x = 0; x < resolution; ++x) {
+				bool source = true;
+				for (int d = 0; d < 8 && source; ++d) {
+					const int nx = x + FLOW_DX[d], ny = y + FLOW_DY[d];
+					if (nx >= 0 && ny >= 0 && nx < resolution && ny < resolution)
+						source = directions[index(nx, ny)] != (d + 4) % 8 + 1;
+				}
+				if (!source)
+					continue;
+				size_t i = index(x, y);
+				while (directions[i] != FlowNone) {
+					const size_t r = receiver(i);
+					accumulation[r].fetch_add(accumulation[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+					if (donors[r].fetch_sub(1, std::memory_order_acq_rel) != 1)
+						break;
+					i = r;
+				}
+			}
+		}
+	});
+
+	m_accumulation.resize(pixels);
+	ForRowBands(resolution, threads, [&](const int first, const int end) {
+		for (size_t i = size_t(first) * resolution; i < size_t(end) * resolution; ++i)
+			m_accumulation[i] = accumulation[i].load(std::memory_order_relaxed);
+	});
+}
@@ -0,0 +1,105 @@
+/****************************************************************
+* Name:       heighthydrology.h
+* Purpose:    Depression filling, flow directions and flow accumulation
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_HYDROLOGY_H
+#define HEIGHT_HYDROLOGY_H
+
+#include <vector>
+
+#include "heightgenerator.h"
+
+// Drainage of a height map, for placing rivers and lakes. Water leaves the map at its edge and at the
+// sea, every pixel at or below the sea level.
+//
+// Filling raises every pit to the level where it spills (priority flood). Tiles are flooded in
+// parallel from their own borders, each flood labels the regions it grows from the border and the
+// lowest spill height between two regions. The labels of all tiles form a small graph, one flood over
+// it gives each region its water level and a last parallel pass raises the pixels to it. The result
+// equals a priority flood over the whole map.
+//
+// Flow directions are D8, to the steepest lower neighbour, on flat ground (lakes) towards the nearest
+// way out. Accumulation counts the pixels draining through each pixel, itself included.
+class HeightHydrology
+{
+public:
+	// D8 directions, clockwise from east. FlowNone: the water leaves the map here
+	enum FlowDirection : unsigned char {
+		FlowNone = 0,
+		FlowEast,
+		FlowSouthEast,
+		FlowSouth,
+		FlowSouthWest,
+		FlowWest,
+		FlowNorthWest,
+		FlowNorth,
+		FlowNorthEast
+	};
+
+	HeightHydrology();
+
+	// Builds from the generated samples, any sample format, on up to threadCount threads, 0 uses every
+	// hardware thread
+	bool build(HeightGenerator &generator, const float seaLevel = 0.0f, const int threadCount = 0);
+	bool build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+			   const float seaLevel = 0.0f, const int threadCount = 0);
+	void clear();
+
+	inline bool built() const {
+		return m_resolution > 1;
+	}
+	inline int resolution() const {
+		return m_resolution;
+	}
+	// Row major, resolution x resolution
+	inline const float *filledHeights() const {
+		return m_filled.data();
+	}
+	inline const unsigned char *flowDirections() const {
+		return m_directions.data();
+	}
+	inline const unsigned int *flowAccumulation() const {
+		return m_accumulation.data();
+	}
+	inline float filledHeight(const int x, const int y) const {
+		return m_filled[index(x, y)];
+	}
+	inline FlowDirection flowDirection(const int x, const int y) const {
+		return FlowDirection(m_directions[index(x, y)]);
+	}
+	inline unsigned int accumulation(const int x, const int y) const {
+		return m_accumulation[index(x, y)];
+	}
+	// Depth of the lake at x, y, 0 where the water does not stand
+	inline float lakeDepth(const int x, const int y) const {
+		return m_filled[index(x, y)] - m_heights[index(x, y)];
+	}
+
+	// Pixel offset of a direction
+	static int DirectionX(const FlowDirection direction);
+	static int DirectionY(const FlowDirection direction);
+
+private:
+	void fillPits(const int threads);
+	void findDirections(const int threads);
+	void accumulateFlow(const int threads);
+
+	inline size_t index(const int x, const int y) const {
+		return size_t(x) + size_t(y) * size_t(m_resolution);
+	}
+
+	std::vector<float> m_heights;
+	std::vector<float> m_filled;
+	std::vector<unsigned char> m_directions;
+	std::vector<unsigned int> m_accumulation;
+	int m_resolution;
+	float m_seaLevel;
+};
+
+#endif
@@ -0,0 +1,263 @@
+/****************************************************************
+* Name:       heightmesh.cpp
+* Purpose:    Error bounded triangle meshes of a height map
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heightmesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+
+static const unsigned char HEIGHT_MESH_FILE_VERSION = 1;
+static const char HEIGHT_MESH_FILE_MAGIC[3] = { 'H','M','F' };
+
+// Triangles of a level and above per thread, smaller levels run on fewer threads
+static const int MESH_MIN_BAND = 4096;
+
+// Runs part(first, end) for count items split into bands, one band per thread
+template<typename Part>
+static void ForBands(const int count, const int threads, const Part &part)
+{
+	if (threads == 1) {
+		part(0, count);
+		return;
+	}
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t) {
+		const int first = count * t / threads;
+		const int end = count * (t + 1) / threads;
+		workers.push_back(std::thread([&part, first, end]() { part(first, end); }));
+	}
+	for (auto & worker : workers)
+		worker.join();
+}
+
+// Corners of triangle id, c is the right angle and a - b the hypotenuse. The lowest bit picks one of the
+// two root triangles, every bit above the child of the previous triangle, the highest set bit ends
+static inline void DecodeTriangle(unsigned int id, const int size, int &ax, int &ay, int &bx, int &by, int &cx, int &cy)
+{
+	if (id & 1) {
+		ax = 0; ay = 0;
+		bx = size; by = size;
+		cx = size; cy = 0;
+	}
+	else {
+		ax = size; ay = size;
+		bx = 0; by = 0;
+		cx = 0; cy = size;
+	}
+	while ((id >>= 1) > 1) {
+		const int mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+		if (id & 1) {
+			bx = ax; by = ay;
+			ax = cx; ay = cy;
+		}
+		else {
+			ax = bx; ay = by;
+			bx = cx; by = cy;
+		}
+		cx = mx;
+		cy = my;
+	}
+}
+
+// Visits the triangles depth levels below triangle a, b, c in id order of their subtrees
+template<typename Visit>
+static void ForDescendants(const int ax, const int ay, const int bx, const int by, const int cx, const int cy,
+						   const int depth, const Visit &visit)
+{
+	if (depth == 0) {
+		visit(ax, ay, bx, by, cx, cy);
+		return;
+	}
+	const int mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+	ForDescendants(cx, cy, ax, ay, mx, my, depth - 1, visit);
+	ForDescendants(bx, by, cx, cy, mx, my, depth - 1, visit);
+}
+
+HeightMesh::HeightMesh() : m_resolution(0), m_originX(0), m_originY(0), m_size(0)
+{
+}
+
+bool HeightMesh::build(HeightGenerator &generator, const int threadCount)
+{
+	return build(generator.generatedSamples(), generator.generatedSampleFormat(), generator.generatedParam().resolution,
+				 threadCount);
+}
+
+bool HeightMesh::build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+					   const int threadCount)
+{
+	int size = 1;
+	while (size < resolution - 1)
+		size *= 2;
+	return build(samples, format, resolution, 0, 0, size, threadCount);
+}
+
+bool HeightMesh::build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+					   const int x, const int y, const int size, const int threadCount)
+{
+	clear();
+	if (!samples || resolution < 2 || !HeightGenerator::SampleFormatBytes(format) || size < 1 || size > (1 << 15) ||
+		(size & (size - 1)) || x < 0 || y < 0 || x >= resolution - 1 || y >= resolution - 1)
+		return false;
+
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, size + 1));
+
+	m_resolution = resolution;
+	m_originX = x;
+	m_originY = y;
+	m_size = size;
+	const int grid = size + 1;
+	m_heights.resize(size_t(grid) * size_t(grid));
+	m_errors.assign(m_heights.size(), 0.0f);
+	ForBands(grid, threads, [&](const int first, const int end) {
+		for (int gy = first; gy < end; ++gy) {
+			const size_t row = size_t(std::min(y + gy, resolution - 1)) * size_t(resolution);
+			float *out = &m_heights[size_t(gy) * size_t(grid)];
+			for (int gx = 0; gx < grid; ++gx)
+				out[gx] = HeightGenerator::SampleHeight(format, samples, row + size_t(std::min(x + gx, resolution - 1)));
+		}
+	});
+
+	// Finest level first, level L holds the 2^(L + 1) triangles L halvings below the roots. Two
+	// triangles of a level share a hypotenuse midpoint, only the one with the lower a writes it and
+	// takes the children of both, so a level has no write conflicts
+	int levels = 0;
+	while ((1 << levels) < size)
+		++levels;
+	levels *= 2;
+	const float *heights = m_heights.data();
+	float *errors = m_errors.data();
+	for (int level = levels - 1; level >= 0; --level) {
+		const bool parent = level < levels - 1;
+		auto visit = [&](const int ax, const int ay, const int bx, const int by, const int cx, const int cy) {
+			// Right angle of the neighbour across the hypotenuse
+			const int dx = ax + bx - cx, dy = ay + by - cy;
+			const bool neighbour = dx >= 0 && dx <= size && dy >= 0 && dy <= size;
+			if (neighbour && (ay > by || (ay == by && ax > bx)))
+				return;
+
+			const int mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+			const size_t middle = size_t(mx) + size_t(my) * size_t(grid);
+			const float interpolated = (heights[size_t(ax) + size_t(ay) * size_t(grid)] +
+										heights[size_t(bx) + size_t(by) * size_t(grid)]) * 0.5f;
+			float error = std::fabs(interpolated - heights[middle]);
+			if (parent) {
+				error = std::max(error, errors[size_t((ax + cx) >> 1) + size_t((ay + cy) >> 1) * size_t(grid)]);
+				error = std::max(error, errors[size_t((bx + cx) >> 1) + size_t((by + cy) >> 1) * size_t(grid)]);
+				if (neighbour) {
+					error = std::max(error, errors[size_t((ax + dx) >> 1) + size_t((ay + dy) >> 1) * size_t(grid)]);
+					error = std::max(error, errors[size_t((bx + dx) >> 1) + size_t((by + dy) >> 1) * size_t(grid)]);
+				}
+			}
+			errors[middle] = error;
+		};
+
+		// Bands of subtrees rooted a few levels down, each walked depth first to the level
+		const int bands = std::max(1, std::min(threads, (2 << level) / MESH_MIN_BAND));
+		int top = 0;
+		while (top < level && (2 << top) < bands * 8)
+			++top;
+		const unsigned int topFirst = 2u << top;
+		ForBands(int(topFirst), bands, [&](const int first, const int end) {
+			for (int k = first; k < end; ++k) {
+				int ax, ay, bx, by, cx, cy;
+				DecodeTriangle(topFirst + unsigned(k), size, ax, ay, bx, by, cx, cy);
+				ForDescendants(ax, ay, bx, by, cx, cy, level - top, visit);
+			}
+		});
+	}
+
+	m_vertexMap.assign(m_heights.size(), -1);
+	return true;
+}
+
+void HeightMesh::clear()
+{
+	m_heights.clear();
+	m_errors.clear();
+	m_vertexMap.clear();
+	m_touched.clear();
+	m_resolution = 0;
+	m_originX = 0;
+	m_originY = 0;
+	m_size = 0;
+}
+
+unsigned int HeightMesh::vertex(const int x, const int y, mesh_t &mesh) const
+{
+	const size_t index = size_t(x) + size_t(y) * size_t(m_size + 1);
+	if (m_vertexMap[index] < 0) {
+		m_vertexMap[index] = int(mesh.vertexCount());
+		m_touched.push_back(int(index));
+		mesh.positions.push_back(float(m_originX + x));
+		mesh.positions.push_back(float(m_originY + y));
+		mesh.positions.push_back(m_heights[index]);
+	}
+	return unsigned(m_vertexMap[index]);
+}
+
+void HeightMesh::countTriangle(const int ax, const int ay, const int bx, const int by, const int cx, const int cy,
+							   const float maxError, mesh_t &mesh) const
+{
+	const int mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+	if (std::abs(ax - cx) + std::abs(ay - cy) > 1 && m_errors[size_t(mx) + size_t(my) * size_t(m_size + 1)] > maxError) {
+		countTriangle(cx, cy, ax, ay, mx, my, maxError, mesh);
+		countTriangle(bx, by, cx, cy, mx, my, maxError, mesh);
+		return;
+	}
+	// Past the last pixel of a map smaller than the grid
+	const int last = m_resolution - 1;
+	if (m_originX + std::min(std::min(ax, bx), cx) >= last || m_originY + std::min(std::min(ay, by), cy) >= last)
+		return;
+	const unsigned int a = vertex(ax, ay, mesh), b = vertex(bx, by, mesh), c = vertex(cx, cy, mesh);
+	mesh.indices.push_back(a);
+	mesh.indices.push_back(c);
+	mesh.indices.push_back(b);
+}
+
+bool HeightMesh::extract(const float maxError, mesh_t &mesh) const
+{
+	mesh.positions.clear();
+	mesh.indices.clear();
+	if (!built())
+		return false;
+
+	countTriangle(0, 0, m_size, m_size, m_size, 0, maxError, mesh);
+	countTriangle(m_size, m_size, 0, 0, 0, m_size, maxError, mesh);
+
+	for (const int index : m_touched)
+		m_vertexMap[index] = -1;
+	m_touched.clear();
+	return true;
+}
+
+bool HeightMesh::extract(const float maxError, const std::string &path) const
+{
+	mesh_t mesh;
+	if (!extract(maxError, mesh))
+		return false;
+
+	FILE *fp = fopen(path.c_str(), "wb");
+	if (!fp)
+		return false;
+	const unsigned int vertexCount = (unsigned int)mesh.vertexCount();
+	const unsigned int indexCount = (unsigned int)mesh.indices.size();
+	int errors = fwrite(&HEIGHT_MESH_FILE_VERSION, sizeof(HEIGHT_MESH_FILE_VERSION), 1, fp) != 1;
+	if (!errors) errors += fwrite(&HEIGHT_MESH_FILE_MAGIC, sizeof(HEIGHT_MESH_FILE_MAGIC), 1, fp) != 1;
+	if (!errors) errors += fwrite(&vertexCount, sizeof(vertexCount), 1, fp) != 1;
+	if (!errors) errors += fwrite(&indexCount, sizeof(indexCount), 1, fp) != 1;
+	if (!errors) errors += fwrite(mesh.positions.data(), sizeof(float), mesh.positions.size(), fp) != mesh.positions.size();
+	if (!errors) errors += fwrite(mesh.indices.data(), sizeof(unsigned int), mesh.indices.size(), fp) != mesh.indices.size();
+	fclose(fp);
+	return !errors;
+}
@@ -0,0 +1,103 @@
+/****************************************************************
+* Name:       heightmesh.h
+* Purpose:    Error bounded triangle meshes of a height map
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_MESH_H
+#define HEIGHT_MESH_H
+
+#include <string>
+#include <vector>
+
+#include "heightgenerator.h"
+
+// Right triangulated irregular network (RTIN). The map is covered by a grid of 2^k + 1 vertices, split
+// into two right triangles that are halved recursively along their hypotenuse. build() stores for every
+// vertex the largest height error of the triangles that would drop it, each level of the hierarchy in
+// one parallel pass from the finest up. extract() then descends only into triangles whose error is above
+// the threshold, so its time is proportional to the triangles emitted. Neighbours share hypotenuses and
+// errors, the mesh is crack free for any threshold.
+//
+// The grid covers maps of 2^k + 1 pixels exactly. Smaller maps repeat their edge samples up to the grid
+// and drop the triangles past the last pixel, triangles across it reach up to the grid edge
+class HeightMesh
+{
+public:
+	typedef struct mesh_t {
+		// x, y in pixels, height in 0 - 1 per vertex
+		std::vector<float> positions;
+		// Three per triangle, counter clockwise in x, y
+		std::vector<unsigned int> indices;
+		inline size_t vertexCount() const {
+			return positions.size() / 3;
+		}
+		inline size_t triangleCount() const {
+			return indices.size() / 3;
+		}
+	}mesh_t;
+
+	HeightMesh();
+
+	// Builds the error hierarchy from the generated samples, any sample format, on up to threadCount
+	// threads, 0 uses every hardware thread
+	bool build(HeightGenerator &generator, const int threadCount = 0);
+	bool build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+			   const int threadCount = 0);
+	// Region of size cells from pixel x, y, size a power of two. Samples past the map repeat its edge,
+	// mesh positions stay in map pixels
+	bool build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+			   const int x, const int y, const int size, const int threadCount = 0);
+	void clear();
+
+	// Mesh that drops only vertices within maxError (0 - 1 units) of the edge they split, 0 drops only
+	// collinear vertices. Not safe to call concurrently on one instance
+	bool extract(const float maxError, mesh_t &mesh) const;
+	// Writes the extracted mesh to path: version, magic, vertex count, index count, positions, indices
+	bool extract(const float maxError, const std::string &path) const;
+
+	inline bool built() const {
+		return m_resolution > 0;
+	}
+	inline int resolution() const {
+		return m_resolution;
+	}
+	inline int originX() const {
+		return m_originX;
+	}
+	inline int originY() const {
+		return m_originY;
+	}
+	// Grid vertices per side, 2^k + 1
+	inline int gridSize() const {
+		return m_size + 1;
+	}
+	// Error of the two root triangles, a threshold at or above it extracts two triangles
+	inline float rootError() const {
+		return m_errors.empty() ? 0.0f : m_errors[size_t(m_size / 2) * size_t(m_size + 1) + size_t(m_size / 2)];
+	}
+
+private:
+	void countTriangle(const int ax, const int ay, const int bx, const int by, const int cx, const int cy,
+					   const float maxError, mesh_t &mesh) const;
+	unsigned int vertex(const int x, const int y, mesh_t &mesh) const;
+
+	// Grid heights and errors, (m_size + 1)^2
+	std::vector<float> m_heights;
+	std::vector<float> m_errors;
+	// Mesh vertex of each grid vertex during extract(), -1 when not emitted
+	mutable std::vector<int> m_vertexMap;
+	mutable std::vector<int> m_touched;
+	int m_resolution;
+	// Map pixel of grid vertex 0, 0
+	int m_originX;
+	int m_originY;
+	// Grid cells per side, a power of two
+	int m_size;
+};
+
+#endif
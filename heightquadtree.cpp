@@ -0,0 +1,265 @@
+/****************************************************************
+* Name:       heightquadtree.cpp
+* Purpose:    Min/max quadtree over a height map for ray casts
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heightquadtree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+
+// Parametric range of a ray inside the slab [lo, hi] of one axis
+static inline bool ClipSlab(const double origin, const double direction, const double lo, const double hi,
+							double &tMin, double &tMax)
+{
+	if (direction == 0.0)
+		return origin >= lo && origin <= hi;
+	double t0 = (lo - origin) / direction;
+	double t1 = (hi - origin) / direction;
+	if (t0 > t1)
+		std::swap(t0, t1);
+	tMin = std::max(tMin, t0);
+	tMax = std::min(tMax, t1);
+	return tMin <= tMax;
+}
+
+HeightQuadTree::HeightQuadTree() : m_resolution(0), m_pixelsPerUnit(1.0f), m_heightScale(1.0f)
+{
+}
+
+bool HeightQuadTree::build(HeightGenerator &generator)
+{
+	return build(generator.generatedSamples(), generator.generatedSampleFormat(), generator.generatedParam().resolution);
+}
+
+bool HeightQuadTree::build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution)
+{
+	clear();
+	if (!samples || resolution < 2 || !HeightGenerator::SampleFormatBytes(format))
+		return false;
+
+	m_resolution = resolution;
+	const size_t pixels = size_t(resolution) * size_t(resolution);
+	m_heights.resize(pixels);
+	for (size_t i = 0; i < pixels; ++i)
+		m_heights[i] = HeightGenerator::SampleHeight(format, samples, i);
+
+	// Level 0, the range of a bilinear cell is the range of its corners
+	level_t cells;
+	cells.size = resolution - 1;
+	cells.range.resize(size_t(cells.size) * size_t(cells.size) * 2);
+	for (int y = 0; y < cells.size; ++y) {
+		for (int x = 0; x < cells.size; ++x) {
+			const float h00 = height(x, y), h10 = height(x + 1, y);
+			const float h01 = height(x, y + 1), h11 = height(x + 1, y + 1);
+			float *range = &cells.range[(size_t(x) + size_t(y) * size_t(cells.size)) * 2];
+			range[0] = std::min(std::min(h00, h10), std::min(h01, h11));
+			range[1] = std::max(std::max(h00, h10), std::max(h01, h11));
+		}
+	}
+	m_levels.push_back(std::move(cells));
+
+	while (m_levels.back().size > 1) {
+		const level_t &below = m_levels.back();
+		level_t level;
+		level.size = (below.size + 1) / 2;
+		level.range.resize(size_t(level.size) * size_t(level.size) * 2);
+		for (int y = 0; y < level.size; ++y) {
+			for (int x = 0; x < level.size; ++x) {
+				float lo = 1e30f, hi = -1e30f;
+				for (int cy = y * 2; cy < std::min(y * 2 + 2, below.size); ++cy) {
+					for (int cx = x * 2; cx < std::min(x * 2 + 2, below.size); ++cx) {
+						const float *child = &below.range[(size_t(cx) + size_t(cy) * size_t(below.size)) * 2];
+						lo = std::min(lo, child[0]);
+						hi = std::max(hi, child[1]);
+					}
+				}
+				level.range[(size_t(x) + size_t(y) * size_t(level.size)) * 2] = lo;
+				level.range[(size_t(x) + size_t(y) * size_t(level.size)) * 2 + 1] = hi;
+			}
+		}
+		m_levels.push_back(std::move(level));
+	}
+	return true;
+}
+
+void HeightQuadTree::clear()
+{
+	m_heights.clear();
+	m_levels.clear();
+	m_resolution = 0;
+}
+
+void HeightQuadTree::setScale(const float unitsPerPixel, const float heightScale)
+{
+	m_pixelsPerUnit = unitsPerPixel > 0.0f ? 1.0f / unitsPerPixel : 1.0f;
+	m_heightScale = heightScale != 0.0f ? heightScale : 1.0f;
+}
+
+bool HeightQuadTree::intersect(const ray_t &ray, ray_hit_t &hit) const
+{
+	hit = ray_hit_t();
+	if (!built())
+		return false;
+
+	const double origin[3] = { double(ray.origin[0]) * m_pixelsPerUnit, double(ray.origin[1]) * m_pixelsPerUnit,
+							   double(ray.origin[2]) / m_heightScale };
+	const double direction[3] = { double(ray.direction[0]) * m_pixelsPerUnit, double(ray.direction[1]) * m_pixelsPerUnit,
+								  double(ray.direction[2]) / m_heightScale };
+
+	// Map bounds, anything below the surface counts as inside
+	const int top = levelCount() - 1;
+	const double last = double(m_resolution - 1);
+	double tStart = 0.0, tEnd = ray.maxDistance;
+	if (!ClipSlab(origin[0], direction[0], 0.0, last, tStart, tEnd) ||
+		!ClipSlab(origin[1], direction[1], 0.0, last, tStart, tEnd) ||
+		!ClipSlab(origin[2], direction[2], -1e30, nodeMax(top, 0, 0), tStart, tEnd))
+		return false;
+
+	// Step used to look up the node past a boundary, a millionth of a pixel along the major axis
+	const double major = std::max(std::fabs(direction[0]), std::fabs(direction[1]));
+	const double probe = major > 0.0 ? 1e-6 / major : 0.0;
+
+	int level = top;
+	double t = tStart;
+	while (true) {
+		const double tProbe = std::min(t + probe, tEnd);
+		const int cx = std::min(std::max((int)(origin[0] + direction[0] * tProbe), 0), m_resolution - 2);
+		const int cy = std::min(std::max((int)(origin[1] + direction[1] * tProbe), 0), m_resolution - 2);
+		const int nx = cx >> level;
+		const int ny = cy >> level;
+
+		// Where the ray leaves the node
+		double tExit = tEnd;
+		if (direction[0] > 0.0)
+			tExit = std::min(tExit, (std::min(double((nx + 1) << level), last) - origin[0]) / direction[0]);
+		else if (direction[0] < 0.0)
+			tExit = std::min(tExit, (double(nx << level) - origin[0]) / direction[0]);
+		if (direction[1] > 0.0)
+			tExit = std::min(tExit, (std::min(double((ny + 1) << level), last) - origin[1]) / direction[1]);
+		else if (direction[1] < 0.0)
+			tExit = std::min(tExit, (double(ny << level) - origin[1]) / direction[1]);
+		tExit = std::max(tExit, tProbe);
+
+		// Lowest point of the ray inside the node
+		const double zLow = std::min(origin[2] + direction[2] * t, origin[2] + direction[2] * tExit);
+		if (zLow > nodeMax(level, nx, ny)) {
+			if (tExit >= tEnd)
+				return false;
+			t = tExit;
+			level = std::min(level + 1, top);
+			continue;
+		}
+		if (level > 0) {
+			--level;
+			continue;
+		}
+
+		double tHit;
+		if (intersectCell(cx, cy, origin, direction, t, tExit, tHit)) {
+			hit.hit = true;
+			hit.distance = (float)tHit;
+			for (int i = 0; i < 3; ++i)
+				hit.position[i] = ray.origin[i] + ray.direction[i] * hit.distance;
+			return true;
+		}
+		if (tExit >= tEnd)
+			return false;
+		t = tExit;
+		level = std::min(level + 1, top);
+	}
+}
+
+void HeightQuadTree::intersect(const ray_t *rays, const int count, ray_hit_t *hits, const int threadCount) const
+{
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, count));
+	if (threads == 1) {
+		for (int i = 0; i < count; ++i)
+			intersect(rays[i], hits[i]);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	const int perThread = (count + threads - 1) / threads;
+	for (int begin = 0; begin < count; begin += perThread) {
+		const int end = std::min(begin + perThread, count);
+		workers.push_back(std::thread([this, rays, hits, begin, end]() {
+			for (int i = begin; i < end; ++i)
+				intersect(rays[i], hits[i]);
+		}));
+	}
+	for (auto & worker : workers)
+		worker.join();
+}
+
+bool HeightQuadTree::lineOfSight(const float *from, const float *to) const
+{
+	ray_t ray;
+	for (int i = 0; i < 3; ++i) {
+		ray.origin[i] = from[i];
+		ray.direction[i] = to[i] - from[i];
+	}
+	ray.maxDistance = 1.0f;
+	ray_hit_t hit;
+	return !intersect(ray, hit);
+}
+
+bool HeightQuadTree::intersectCell(const int x, const int y, const double *origin, const double *direction,
+								   const double tEnter, const double tExit, double &t) const
+{
+	// h(u, v) = a + b u + c v + e u v over the cell, along the ray u = u0 + du s, v = v0 + dv s
+	const double h00 = height(x, y), h10 = height(x + 1, y);
+	const double h01 = height(x, y + 1), h11 = height(x + 1, y + 1);
+	const double a = h00, b = h10 - h00, c = h01 - h00, e = h00 - h10 - h01 + h11;
+	const double u0 = origin[0] + direction[0] * tEnter - x;
+	const double v0 = origin[1] + direction[1] * tEnter - y;
+	const double z0 = origin[2] + direction[2] * tEnter;
+	const double du = direction[0], dv = direction[1], dz = direction[2];
+
+	// f(s) = ray height - surface height = C + B s + A s^2, the first sign change is the hit
+	const double C = z0 - (a + b * u0 + c * v0 + e * u0 * v0);
+	const double B = dz - (b * du + c * dv + e * (u0 * dv + v0 * du));
+	const double A = -e * du * dv;
+	const double length = tExit - tEnter;
+
+	if (C <= 0.0) {
+		t = tEnter;
+		return true;
+	}
+
+	double s = -1.0;
+	if (std::fabs(A) < 1e-12) {
+		if (B < 0.0)
+			s = -C / B;
+	}
+	else {
+		const double discriminant = B * B - 4.0 * A * C;
+		if (discriminant >= 0.0) {
+			// Stable roots
+			const double q = -0.5 * (B + (B >= 0.0 ? 1.0 : -1.0) * std::sqrt(discriminant));
+			const double r0 = q / A;
+			const double r1 = q != 0.0 ? C / q : -1.0;
+			if (r0 >= 0.0)
+				s = r0;
+			if (r1 >= 0.0 && (s < 0.0 || r1 < s))
+				s = r1;
+		}
+	}
+	if (s >= 0.0 && s <= length) {
+		t = tEnter + s;
+		return true;
+	}
+	// Rounding at a grazing exit
+	if (C + (B + A * length) * length <= 0.0) {
+		t = tExit;
+		return true;
+	}
+	return false;
+}
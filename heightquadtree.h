@@ -0,0 +1,106 @@
+/****************************************************************
+* Name:       heightquadtree.h
+* Purpose:    Min/max quadtree over a height map for ray casts
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_QUAD_TREE_H
+#define HEIGHT_QUAD_TREE_H
+
+#include <vector>
+
+#include "heightgenerator.h"
+
+// Implicit min/max quadtree (maximum mipmap) for ray casting and line of sight. The surface is the
+// bilinear interpolation of the samples, level 0 holds the height range of each cell between four
+// samples and every level above halves the resolution. Rays skip whole nodes they pass above and
+// descend only where they may touch the surface, the final test is exact against the bilinear cell.
+//
+// World space: x, y along the map axes, z up. A sample of 1.0 is heightScale high
+class HeightQuadTree
+{
+public:
+	typedef struct ray_t {
+		ray_t() : maxDistance(1e30f) {
+			origin[0] = origin[1] = origin[2] = 0.0f;
+			direction[0] = direction[1] = 0.0f;
+			direction[2] = -1.0f;
+		}
+		float origin[3];
+		// Need not be normalized, distances are in multiples of it
+		float direction[3];
+		float maxDistance;
+	}ray_t;
+
+	typedef struct ray_hit_t {
+		ray_hit_t() : hit(false), distance(0.0f) {
+			position[0] = position[1] = position[2] = 0.0f;
+		}
+		bool hit;
+		float distance;
+		float position[3];
+	}ray_hit_t;
+
+	HeightQuadTree();
+
+	// Builds from the generated samples, any sample format
+	bool build(HeightGenerator &generator);
+	bool build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution);
+	void clear();
+
+	// World units per height map pixel and the world height of a 1.0 sample
+	void setScale(const float unitsPerPixel, const float heightScale);
+
+	// First surface hit along the ray, a ray starting below the surface hits at distance 0
+	bool intersect(const ray_t &ray, ray_hit_t &hit) const;
+	// Traces count rays on up to threadCount threads, 0 uses every hardware thread
+	void intersect(const ray_t *rays, const int count, ray_hit_t *hits, const int threadCount = 0) const;
+	// True when the segment between the two points does not touch the surface
+	bool lineOfSight(const float *from, const float *to) const;
+
+	inline bool built() const {
+		return m_resolution > 1;
+	}
+	inline int resolution() const {
+		return m_resolution;
+	}
+	inline int levelCount() const {
+		return static_cast<int>(m_levels.size());
+	}
+	// Height range in 0 - 1 of node x, y at level, level 0 nodes are cells between four samples
+	inline float nodeMin(const int level, const int x, const int y) const {
+		return m_levels[level].range[(size_t(x) + size_t(y) * size_t(m_levels[level].size)) * 2];
+	}
+	inline float nodeMax(const int level, const int x, const int y) const {
+		return m_levels[level].range[(size_t(x) + size_t(y) * size_t(m_levels[level].size)) * 2 + 1];
+	}
+
+private:
+	typedef struct level_t {
+		level_t() : size(0) {}
+		// Nodes per side
+		int size;
+		// min, max per node, row major
+		std::vector<float> range;
+	}level_t;
+
+	// Traversal runs in map space (pixels, 0 - 1 heights) and double precision
+	bool intersectCell(const int x, const int y, const double *origin, const double *direction,
+					   const double tEnter, const double tExit, double &t) const;
+	inline float height(const int x, const int y) const {
+		return m_heights[size_t(x) + size_t(y) * size_t(m_resolution)];
+	}
+
+	std::vector<float> m_heights;
+	std::vector<level_t> m_levels;
+	int m_resolution;
+
+	float m_pixelsPerUnit;
+	float m_heightScale;
+};
+
+#endif
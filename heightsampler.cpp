@@ -0,0 +1,226 @@
+/****************************************************************
+* Name:       heightsampler.cpp
+* Purpose:    Batched filtered height queries over a generated height map
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heightsampler.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
+
+// Queries per batch, the lane arrays of a batch stay in registers or L1
+static const int SAMPLE_BATCH = 16;
+
+// Catmull-Rom weights of the 4 texels around t and their derivatives
+static inline void CatmullRomWeights(const float t, float *w, float *dw)
+{
+	w[0] = ((-t + 2.0f) * t - 1.0f) * t * 0.5f;
+	w[1] = ((3.0f * t - 5.0f) * t * t + 2.0f) * 0.5f;
+	w[2] = ((-3.0f * t + 4.0f) * t + 1.0f) * t * 0.5f;
+	w[3] = (t - 1.0f) * t * t * 0.5f;
+	dw[0] = ((-3.0f * t + 4.0f) * t - 1.0f) * 0.5f;
+	dw[1] = (9.0f * t - 10.0f) * t * 0.5f;
+	dw[2] = ((-9.0f * t + 8.0f) * t + 1.0f) * 0.5f;
+	dw[3] = (3.0f * t - 2.0f) * t * 0.5f;
+}
+
+HeightSampler::HeightSampler() : m_texelOffset(0), m_resolution(0), m_blocksPerRow(0),
+	m_pixelsPerUnit(1.0f), m_heightScale(1.0f)
+{
+}
+
+bool HeightSampler::build(HeightGenerator &generator)
+{
+	return build(generator.generatedSamples(), generator.generatedSampleFormat(), generator.generatedParam().resolution);
+}
+
+bool HeightSampler::build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution)
+{
+	clear();
+	if (!samples || resolution <= 0 || !HeightGenerator::SampleFormatBytes(format))
+		return false;
+
+	// Texel offsets are int
+	const size_t blocksPerRow = (size_t(resolution) + 3) / 4;
+	const size_t blockFloats = blocksPerRow * blocksPerRow * 16;
+	if (blockFloats > size_t(INT_MAX))
+		return false;
+
+	m_resolution = resolution;
+	m_blocksPerRow = int(blocksPerRow);
+	m_storage.assign(blockFloats + 15, 0.0f);
+	const uintptr_t address = reinterpret_cast<uintptr_t>(m_storage.data());
+	m_texelOffset = ((64 - (address & 63)) & 63) / sizeof(float);
+
+	float *blocks = m_storage.data() + m_texelOffset;
+	const size_t pixels = size_t(resolution) * size_t(resolution);
+	for (size_t i = 0; i < pixels; ++i) {
+		const int x = int(i % size_t(resolution));
+		const int y = int(i / size_t(resolution));
+		blocks[texelIndex(x, y)] = HeightGenerator::SampleHeight(format, samples, i);
+	}
+	return true;
+}
+
+void HeightSampler::clear()
+{
+	m_storage.clear();
+	m_texelOffset = 0;
+	m_resolution = 0;
+	m_blocksPerRow = 0;
+}
+
+void HeightSampler::setScale(const float unitsPerPixel, const float heightScale)
+{
+	m_pixelsPerUnit = unitsPerPixel > 0.0f ? 1.0f / unitsPerPixel : 1.0f;
+	m_heightScale = heightScale;
+}
+
+bool HeightSampler::sample(const float *positions, const int count, float *heights, float *gradients,
+						   const Filter filter) const
+{
+	if (!built() || !positions || !heights)
+		return false;
+
+	const float maxCoord = float(m_resolution - 1);
+	int ix[SAMPLE_BATCH], iy[SAMPLE_BATCH];
+	float fx[SAMPLE_BATCH], fy[SAMPLE_BATCH];
+
+	for (int begin = 0; begin < count; begin += SAMPLE_BATCH) {
+		const int batch = std::min(count - begin, SAMPLE_BATCH);
+		const float *position = positions + size_t(begin) * 2;
+
+		// Pixel space, clamped to the edge. Non negative, so truncation is floor
+		for (int k = 0; k < batch; ++k) {
+			const float x = std::min(std::max(position[k * 2] * m_pixelsPerUnit, 0.0f), maxCoord);
+			const float y = std::min(std::max(position[k * 2 + 1] * m_pixelsPerUnit, 0.0f), maxCoord);
+			ix[k] = (int)x;
+			iy[k] = (int)y;
+			fx[k] = x - (float)ix[k];
+			fy[k] = y - (float)iy[k];
+		}
+
+		float *batchGradients = gradients ? gradients + size_t(begin) * 2 : nullptr;
+		if (filter == FilterBicubic)
+			sampleBicubic(batch, ix, iy, fx, fy, heights + begin, batchGradients);
+		else
+			sampleBilinear(batch, ix, iy, fx, fy, heights + begin, batchGradients);
+	}
+	return true;
+}
+
+float HeightSampler::heightAt(const float x, const float y, const Filter filter) const
+{
+	const float position[2] = { x, y };
+	float height = 0.0f;
+	sample(position, 1, &height, nullptr, filter);
+	return height;
+}
+
+void HeightSampler::sampleBilinear(const int count, const int *ix, const int *iy, const float *fx, const float *fy,
+								   float *heights, float *gradients) const
+{
+	const float *blocks = texels();
+	const int last = m_resolution - 1;
+	float h00[SAMPLE_BATCH], h10[SAMPLE_BATCH], h01[SAMPLE_BATCH], h11[SAMPLE_BATCH];
+
+	int x0[SAMPLE_BATCH], x1[SAMPLE_BATCH], y0[SAMPLE_BATCH], y1[SAMPLE_BATCH];
+	for (int k = 0; k < count; ++k) {
+		x0[k] = columnOffset(ix[k]);
+		x1[k] = columnOffset(std::min(ix[k] + 1, last));
+		y0[k] = rowOffset(iy[k]);
+		y1[k] = rowOffset(std::min(iy[k] + 1, last));
+	}
+	for (int k = 0; k < count; ++k) {
+		h00[k] = blocks[x0[k] + y0[k]];
+		h10[k] = blocks[x1[k] + y0[k]];
+		h01[k] = blocks[x0[k] + y1[k]];
+		h11[k] = blocks[x1[k] + y1[k]];
+	}
+
+	for (int k = 0; k < count; ++k) {
+		const float top = h00[k] + (h10[k] - h00[k]) * fx[k];
+		const float bottom = h01[k] + (h11[k] - h01[k]) * fx[k];
+		heights[k] = (top + (bottom - top) * fy[k]) * m_heightScale;
+	}
+
+	if (gradients) {
+		const float scale = m_heightScale * m_pixelsPerUnit;
+		for (int k = 0; k < count; ++k) {
+			const float dxTop = h10[k] - h00[k];
+			const float dxBottom = h11[k] - h01[k];
+			const float dyLeft = h01[k] - h00[k];
+			const float dyRight = h11[k] - h10[k];
+			gradients[k * 2] = (dxTop + (dxBottom - dxTop) * fy[k]) * scale;
+			gradients[k * 2 + 1] = (dyLeft + (dyRight - dyLeft) * fx[k]) * scale;
+		}
+	}
+}
+
+void HeightSampler::sampleBicubic(const int count, const int *ix, const int *iy, const float *fx, const float *fy,
+								  float *heights, float *gradients) const
+{
+	const float *blocks = texels();
+	const int last = m_resolution - 1;
+	// Footprint texel t of every lane at h[t][lane], t = row * 4 + column
+	float h[16][SAMPLE_BATCH];
+
+	int columns[4][SAMPLE_BATCH], rows[4][SAMPLE_BATCH];
+	for (int i = 0; i < 4; ++i) {
+		for (int k = 0; k < count; ++k) {
+			columns[i][k] = columnOffset(std::min(std::max(ix[k] + i - 1, 0), last));
+			rows[i][k] = rowOffset(std::min(std::max(iy[k] + i - 1, 0), last));
+		}
+	}
+	for (int row = 0; row < 4; ++row) {
+		for (int column = 0; column < 4; ++column) {
+			for (int k = 0; k < count; ++k)
+				h[row * 4 + column][k] = blocks[rows[row][k] + columns[column][k]];
+		}
+	}
+
+	float wx[4][SAMPLE_BATCH], wy[4][SAMPLE_BATCH], dwx[4][SAMPLE_BATCH], dwy[4][SAMPLE_BATCH];
+	for (int k = 0; k < count; ++k) {
+		float w[4], dw[4];
+		CatmullRomWeights(fx[k], w, dw);
+		for (int i = 0; i < 4; ++i) {
+			wx[i][k] = w[i];
+			dwx[i][k] = dw[i];
+		}
+		CatmullRomWeights(fy[k], w, dw);
+		for (int i = 0; i < 4; ++i) {
+			wy[i][k] = w[i];
+			dwy[i][k] = dw[i];
+		}
+	}
+
+	float height[SAMPLE_BATCH] = {}, dx[SAMPLE_BATCH] = {}, dy[SAMPLE_BATCH] = {};
+	for (int row = 0; row < 4; ++row) {
+		for (int k = 0; k < count; ++k) {
+			float rowHeight = 0.0f, rowDx = 0.0f;
+			for (int column = 0; column < 4; ++column) {
+				rowHeight += h[row * 4 + column][k] * wx[column][k];
+				rowDx += h[row * 4 + column][k] * dwx[column][k];
+			}
+			height[k] += rowHeight * wy[row][k];
+			dx[k] += rowDx * wy[row][k];
+			dy[k] += rowHeight * dwy[row][k];
+		}
+	}
+
+	for (int k = 0; k < count; ++k)
+		heights[k] = height[k] * m_heightScale;
+	if (gradients) {
+		const float scale = m_heightScale * m_pixelsPerUnit;
+		for (int k = 0; k < count; ++k) {
+			gradients[k * 2] = dx[k] * scale;
+			gradients[k * 2 + 1] = dy[k] * scale;
+		}
+	}
+}
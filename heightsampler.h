@@ -0,0 +1,83 @@
+/****************************************************************
+* Name:       heightsampler.h
+* Purpose:    Batched filtered height queries over a generated height map
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_SAMPLER_H
+#define HEIGHT_SAMPLER_H
+
+#include <vector>
+
+#include "heightgenerator.h"
+
+// Filtered height and gradient queries for physics and collision. The heights are copied once into
+// blocks of 4 x 4 floats, one 64 byte cache line each, so the texels of a bilinear footprint mostly
+// share a line. Queries run in fixed size batches laid out lane by lane, the coordinate and filter
+// math of a batch vectorizes, only the texel fetches are gathers.
+class HeightSampler
+{
+public:
+	enum Filter : short {
+		FilterBilinear = 0,
+		// Catmull-Rom, 4 x 4 texels
+		FilterBicubic
+	};
+
+	HeightSampler();
+
+	// Copies the generated samples, any sample format
+	bool build(HeightGenerator &generator);
+	bool build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution);
+	void clear();
+
+	// World units per height map pixel and the world height of a 1.0 sample
+	void setScale(const float unitsPerPixel, const float heightScale);
+
+	// positions holds count x, y pairs in world units, positions outside the map are clamped to the edge.
+	// gradients, when given, receives count dh/dx, dh/dy pairs in world units
+	bool sample(const float *positions, const int count, float *heights, float *gradients = nullptr,
+				const Filter filter = FilterBilinear) const;
+	float heightAt(const float x, const float y, const Filter filter = FilterBilinear) const;
+
+	inline bool built() const {
+		return m_resolution > 0;
+	}
+	inline int resolution() const {
+		return m_resolution;
+	}
+
+private:
+	// The block layout index splits into a column and a row part
+	inline int columnOffset(const int x) const {
+		return ((x >> 2) << 4) + (x & 3);
+	}
+	inline int rowOffset(const int y) const {
+		return (y >> 2) * (m_blocksPerRow << 4) + ((y & 3) << 2);
+	}
+	inline size_t texelIndex(const int x, const int y) const {
+		return size_t(columnOffset(x)) + size_t(rowOffset(y));
+	}
+	inline const float *texels() const {
+		return m_storage.data() + m_texelOffset;
+	}
+	void sampleBilinear(const int count, const int *ix, const int *iy, const float *fx, const float *fy,
+						float *heights, float *gradients) const;
+	void sampleBicubic(const int count, const int *ix, const int *iy, const float *fx, const float *fy,
+					   float *heights, float *gradients) const;
+
+	// Blocks start m_texelOffset floats into m_storage, on a 64 byte boundary
+	std::vector<float> m_storage;
+	size_t m_texelOffset;
+	int m_resolution;
+	int m_blocksPerRow;
+
+	float m_pixelsPerUnit;
+	float m_heightScale;
+};
+
+#endif
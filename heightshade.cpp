@@ -0,0 +1,204 @@
+/****************************************************************
+* Name:       heightshade.cpp
+* Purpose:    Baked hillshade and horizon based ambient occlusion
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heightshade.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+
+static const float SHADE_PI = 3.14159265358979f;
+
+// Runs part(first, end) for count items split into bands, one band per thread
+template<typename Part>
+static void ForBands(const int count, const int threads, const Part &part)
+{
+	if (threads == 1) {
+		part(0, count);
+		return;
+	}
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; ++t) {
+		const int first = count * t / threads;
+		const int end = count * (t + 1) / threads;
+		workers.push_back(std::thread([&part, first, end]() { part(first, end); }));
+	}
+	for (auto & worker : workers)
+		worker.join();
+}
+
+// count light values in 0 - 1 to samples of format
+static void StoreLight(const HeightGenerator::SampleFormat format, const float *light, const int count, unsigned char *out)
+{
+	for (int k = 0; k < count; ++k) {
+		const float v = std::min(std::max(light[k], 0.0f), 1.0f);
+		switch (format) {
+		case HeightGenerator::SampleFormatUInt16:
+			reinterpret_cast<unsigned short *>(out)[k] = (unsigned short)(v * 65535.0f + 0.5f);
+			break;
+		case HeightGenerator::SampleFormatUInt8:
+			out[k] = (unsigned char)(v * 255.0f + 0.5f);
+			break;
+		case HeightGenerator::SampleFormatFloat32:
+			reinterpret_cast<float *>(out)[k] = v;
+			break;
+		case HeightGenerator::SampleFormatFloat16:
+			reinterpret_cast<unsigned short *>(out)[k] = HeightGenerator::FloatToHalf(v);
+			break;
+		}
+	}
+}
+
+HeightShade::HeightShade() : m_resolution(0)
+{
+}
+
+bool HeightShade::build(HeightGenerator &generator, const shade_param_t &params, const int threadCount)
+{
+	return build(generator.generatedSamples(), generator.generatedSampleFormat(), generator.generatedParam().resolution,
+				 params, threadCount);
+}
+
+bool HeightShade::build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+						const shade_param_t &params, const int threadCount)
+{
+	clear();
+	if (!samples || resolution < 2 || !HeightGenerator::SampleFormatBytes(format) ||
+		!HeightGenerator::SampleFormatBytes(params.format) || params.occlusionDirections < 0)
+		return false;
+
+	m_resolution = resolution;
+	m_params = params;
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, resolution));
+
+	// Heights in pixels
+	const size_t stride = size_t(resolution);
+	std::vector<float> heights(stride * stride);
+	ForBands(resolution, threads, [&](const int first, const int end) {
+		for (size_t i = size_t(first) * stride; i < size_t(end) * stride; ++i)
+			heights[i] = HeightGenerator::SampleHeight(format, samples, i) * params.heightScale;
+	});
+
+	bakeHillshade(heights, threads);
+	if (params.occlusionDirections > 0)
+		bakeOcclusion(heights, threads);
+	return true;
+}
+
+void HeightShade::clear()
+{
+	m_hillshade.clear();
+	m_occlusion.clear();
+	m_resolution = 0;
+}
+
+void HeightShade::bakeHillshade(const std::vector<float> &heights, const int threads)
+{
+	const int resolution = m_resolution;
+	const size_t stride = size_t(resolution);
+	const int bytes = HeightGenerator::SampleFormatBytes(m_params.format);
+	m_hillshade.resize(stride * stride * bytes);
+
+	// x east, y south, z up
+	const float azimuth = m_params.sunAzimuth * SHADE_PI / 180.0f;
+	const float elevation = m_params.sunElevation * SHADE_PI / 180.0f;
+	const float sun[3] = { std::cos(elevation) * std::sin(azimuth), -std::cos(elevation) * std::cos(azimuth),
+						   std::sin(elevation) };
+
+	ForBands(resolution, threads, [&](const int first, const int end) {
+		std::vector<float> light(resolution);
+		for (int y = first; y < end; ++y) {
+			const float *row = &heights[size_t(y) * stride];
+			const float *up = &heights[size_t(std::max(y - 1, 0)) * stride];
+			const float *down = &heights[size_t(std::min(y + 1, resolution - 1)) * stride];
+			// One sided at the edges
+			const float dyScale = y > 0 && y < resolution - 1 ? 0.5f : 1.0f;
+			for (int x = 0; x < resolution; ++x) {
+				const int left = std::max(x - 1, 0), right = std::min(x + 1, resolution - 1);
+				const float dx = (row[right] - row[left]) / float(right - left);
+				const float dy = (down[x] - up[x]) * dyScale;
+				// Normal (-dx, -dy, 1)
+				const float lambert = (-dx * sun[0] - dy * sun[1] + sun[2]) / std::sqrt(dx * dx + dy * dy + 1.0f);
+				light[x] = std::max(lambert, 0.0f);
+			}
+			StoreLight(m_params.format, light.data(), resolution, &m_hillshade[size_t(y) * stride * bytes]);
+		}
+	});
+}
+
+void HeightShade::bakeOcclusion(const std::vector<float> &heights, const int threads)
+{
+	const int resolution = m_resolution;
+	const size_t stride = size_t(resolution);
+	const int directions = m_params.occlusionDirections;
+	std::vector<float> sky(stride * stride, 0.0f);
+	std::vector<int> offsets(resolution);
+
+	for (int d = 0; d < directions; ++d) {
+		const float angle = 2.0f * SHADE_PI * (float(d) + 0.5f) / float(directions);
+		const float cx = std::cos(angle), cy = std::sin(angle);
+		// Lines step one pixel along the major axis, minor offsets rounded per step
+		const bool majorX = std::fabs(cx) >= std::fabs(cy);
+		const float major = majorX ? cx : cy;
+		const float slope = (majorX ? cy : cx) / std::fabs(major);
+		const float step = std::sqrt(1.0f + slope * slope);
+		for (int k = 0; k < resolution; ++k)
+			offsets[k] = (int)std::floor(float(k) * slope + 0.5f);
+		const int spread = std::abs(offsets[resolution - 1]);
+		const int lines = resolution + spread;
+		const int lineFirst = offsets[resolution - 1] > 0 ? -spread : 0;
+
+		ForBands(lines, threads, [&](const int first, const int end) {
+			// Upper convex hull of the terrain behind, distance along the line and height
+			std::vector<float> hullT(resolution), hullH(resolution);
+			for (int line = first; line < end; ++line) {
+				const int c = lineFirst + line;
+				int top = -1;
+				for (int k = 0; k < resolution; ++k) {
+					const int along = major > 0.0f ? k : resolution - 1 - k;
+					const int across = c + offsets[k];
+					if (across < 0 || across >= resolution)
+						continue;
+					const size_t i = majorX ? size_t(along) + size_t(across) * stride : size_t(across) + size_t(along) * stride;
+					const float t = float(k) * step;
+					const float h = heights[i];
+
+					// Drop hull points hidden behind the next one as seen from here
+					while (top >= 1 && (hullH[top] - h) * (t - hullT[top - 1]) <= (hullH[top - 1] - h) * (t - hullT[top]))
+						--top;
+					float visible = 1.0f;
+					if (top >= 0) {
+						// 1 - sin of the horizon elevation, the horizon is never below the flat
+						const float rise = std::max(hullH[top] - h, 0.0f);
+						const float run = t - hullT[top];
+						visible = 1.0f - rise / std::sqrt(rise * rise + run * run);
+					}
+					sky[i] += visible;
+					++top;
+					hullT[top] = t;
+					hullH[top] = h;
+				}
+			}
+		});
+	}
+
+	const int bytes = HeightGenerator::SampleFormatBytes(m_params.format);
+	m_occlusion.resize(stride * stride * bytes);
+	ForBands(resolution, threads, [&](const int first, const int end) {
+		std::vector<float> light(resolution);
+		for (int y = first; y < end; ++y) {
+			const float *row = &sky[size_t(y) * stride];
+			for (int x = 0; x < resolution; ++x)
+				light[x] = row[x] / float(directions);
+			StoreLight(m_params.format, light.data(), resolution, &m_occlusion[size_t(y) * stride * bytes]);
+		}
+	});
+}
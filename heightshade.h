@@ -0,0 +1,80 @@
+/****************************************************************
+* Name:       heightshade.h
+* Purpose:    Baked hillshade and horizon based ambient occlusion
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_SHADE_H
+#define HEIGHT_SHADE_H
+
+#include <vector>
+
+#include "heightgenerator.h"
+
+// Lightmaps of a height map, for tools and thumbnails without a renderer.
+//
+// Hillshade is the Lambert term of the sun on the surface normal. Ambient occlusion is the share of
+// the sky seen from every pixel: for each of a number of azimuths the map is swept along parallel
+// lines, each line keeps the upper convex hull of the terrain behind the current pixel, the horizon
+// is on that hull and every pixel is pushed and popped once, so a direction costs O(pixels).
+// Lines are independent and run on separate threads.
+//
+// Lightmaps are row major like the samples, 1 is fully lit
+class HeightShade
+{
+public:
+	typedef struct shade_param_t {
+		shade_param_t() : heightScale(256.0f), sunAzimuth(315.0f), sunElevation(45.0f), occlusionDirections(16),
+			format(HeightGenerator::SampleFormatUInt8) {}
+		// Height of a 1.0 sample in pixels
+		float heightScale;
+		// Degrees, azimuth clockwise from north (-y), elevation above the horizon
+		float sunAzimuth;
+		float sunElevation;
+		// Horizon sweeps, 0 skips ambient occlusion
+		int occlusionDirections;
+		// Lightmap sample format, UInt8 or UInt16 for 8 or 16 bit lightmaps
+		HeightGenerator::SampleFormat format;
+	}shade_param_t;
+
+	HeightShade();
+
+	// Bakes from the generated samples, any sample format, on up to threadCount threads, 0 uses every
+	// hardware thread
+	bool build(HeightGenerator &generator, const shade_param_t &params = shade_param_t(), const int threadCount = 0);
+	bool build(const void *samples, const HeightGenerator::SampleFormat format, const int resolution,
+			   const shade_param_t &params = shade_param_t(), const int threadCount = 0);
+	void clear();
+
+	inline bool built() const {
+		return m_resolution > 0;
+	}
+	inline int resolution() const {
+		return m_resolution;
+	}
+	inline HeightGenerator::SampleFormat format() const {
+		return m_params.format;
+	}
+	// Samples in format(), null when not baked
+	inline const void *hillshade() const {
+		return m_hillshade.empty() ? nullptr : m_hillshade.data();
+	}
+	inline const void *ambientOcclusion() const {
+		return m_occlusion.empty() ? nullptr : m_occlusion.data();
+	}
+
+private:
+	void bakeHillshade(const std::vector<float> &heights, const int threads);
+	void bakeOcclusion(const std::vector<float> &heights, const int threads);
+
+	std::vector<unsigned char> m_hillshade;
+	std::vector<unsigned char> m_occlusion;
+	shade_param_t m_params;
+	int m_resolution;
+};
+
+#endif
@@ -0,0 +1,322 @@
+/****************************************************************
+* Name:       heighttilecache.cpp
+* Purpose:    Byte bounded LRU cache of generated tiles with a disk level
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heighttilecache.h"
+#include "heightgraph.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+
+// Bump whenever the generator writes different samples for the same inputs, keys of older tiles stop matching
+static const unsigned int TILE_CACHE_ALGORITHM_VERSION = 2;
+static const int TILE_CACHE_SHARDS = 16;
+static const size_t TILE_CACHE_DEFAULT_BYTES = size_t(256) << 20;
+static const unsigned char TILE_CACHE_FILE_VERSION = 1;
+static const char TILE_CACHE_FILE_MAGIC[3] = { 'H','T','C' };
+
+static const unsigned long long FNV_OFFSET = 14695981039346656037ULL;
+static const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+struct HeightTileCache::shard_t {
+	shard_t() : bytes(0), maxBytes(0) {}
+	typedef struct entry_t {
+		TileHandle tile;
+		// Position in recent
+		std::list<unsigned long long>::iterator recent;
+	}entry_t;
+
+	std::mutex lock;
+	std::unordered_map<unsigned long long, entry_t> entries;
+	// Keys, most recently used first
+	std::list<unsigned long long> recent;
+	size_t bytes;
+	size_t maxBytes;
+};
+
+// FNV-1a of the little endian bytes of value, the same on every platform
+static inline unsigned long long HashU32(unsigned long long hash, const unsigned int value)
+{
+	for (int b = 0; b < 4; ++b)
+		hash = (hash ^ ((value >> (8 * b)) & 0xff)) * FNV_PRIME;
+	return hash;
+}
+
+static inline unsigned long long HashFloat(const unsigned long long hash, const float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return HashU32(hash, bits);
+}
+
+HeightTileCache::HeightTileCache() : m_hits(0), m_diskHits(0), m_misses(0), m_evictions(0), m_diskWrites(0)
+{
+	for (int s = 0; s < TILE_CACHE_SHARDS; ++s)
+		m_shards.push_back(std::unique_ptr<shard_t>(new shard_t()));
+	for (auto & shard : m_shards)
+		shard->maxBytes = TILE_CACHE_DEFAULT_BYTES / TILE_CACHE_SHARDS;
+}
+
+HeightTileCache::~HeightTileCache()
+{
+}
+
+bool HeightTileCache::configure(const size_t maxBytes, const std::string &directory)
+{
+	clear();
+	m_hits = 0;
+	m_diskHits = 0;
+	m_misses = 0;
+	m_evictions = 0;
+	m_diskWrites = 0;
+	for (auto & shard : m_shards)
+		shard->maxBytes = maxBytes / TILE_CACHE_SHARDS;
+
+	m_directory = directory;
+	if (!m_directory.empty() && m_directory.back() != '/' && m_directory.back() != '\\')
+		m_directory += '/';
+	if (!m_directory.empty()) {
+		// The directory has to take files
+		const std::string probe = m_directory + ".probe";
+		FILE *fp = fopen(probe.c_str(), "wb");
+		if (!fp) {
+			m_directory.clear();
+			return false;
+		}
+		fclose(fp);
+		remove(probe.c_str());
+	}
+	return true;
+}
+
+void HeightTileCache::clear()
+{
+	for (auto & shard : m_shards) {
+		std::lock_guard<std::mutex> lock(shard->lock);
+		shard->entries.clear();
+		shard->recent.clear();
+		shard->bytes = 0;
+	}
+}
+
+unsigned long long HeightTileCache::ParamsKey(const unsigned int seed, const HeightGenerator::height_map_param_t &params)
+{
+	unsigned long long hash = HashU32(FNV_OFFSET, TILE_CACHE_ALGORITHM_VERSION);
+	hash = HashU32(hash, seed);
+	hash = HashFloat(hash, params.gain);
+	hash = HashU32(hash, (unsigned int)params.octaves);
+	hash = HashFloat(hash, params.scale);
+	hash = HashFloat(hash, params.ridgedGainOffset);
+	hash = HashFloat(hash, params.worleyGainOffset);
+	hash = HashFloat(hash, params.warpStrength);
+	hash = HashFloat(hash, params.warpFrequency);
+	hash = HashU32(hash, (unsigned int)params.warpOctaves);
+	hash = HashU32(hash, (unsigned int)params.sampleFormat);
+	hash = HashU32(hash, params.graph ? 1 : 0);
+	if (params.graph) {
+		const std::vector<HeightGraph::node_t> &nodes = params.graph->nodes();
+		hash = HashU32(hash, (unsigned int)nodes.size());
+		hash = HashU32(hash, (unsigned int)params.graph->output());
+		for (const HeightGraph::node_t &node : nodes) {
+			hash = HashU32(hash, (unsigned int)node.type);
+			for (int i = 0; i < 3; ++i)
+				hash = HashU32(hash, (unsigned int)node.inputs[i]);
+			hash = HashFloat(hash, node.frequency);
+			hash = HashFloat(hash, node.gainOffset);
+			hash = HashFloat(hash, node.lacunarity);
+			hash = HashFloat(hash, node.ridgeOffset);
+			hash = HashU32(hash, (unsigned int)node.octaves);
+			hash = HashFloat(hash, node.a);
+			hash = HashFloat(hash, node.b);
+		}
+	}
+	return hash;
+}
+
+unsigned long long HeightTileCache::Key(const unsigned long long paramsKey, const int x, const int y, const int width,
+										const int height)
+{
+	unsigned long long hash = HashU32(paramsKey, (unsigned int)x);
+	hash = HashU32(hash, (unsigned int)y);
+	hash = HashU32(hash, (unsigned int)width);
+	hash = HashU32(hash, (unsigned int)height);
+	// SplitMix64 finalizer, FNV leaves the high bits that pick the shard poorly mixed
+	hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+	return hash ^ (hash >> 31);
+}
+
+unsigned long long HeightTileCache::Key(const unsigned int seed, const HeightGenerator::height_map_param_t &params,
+										const int x, const int y, const int width, const int height)
+{
+	return Key(ParamsKey(seed, params), x, y, width, height);
+}
+
+HeightTileCache::shard_t &HeightTileCache::shard(const unsigned long long key) const
+{
+	return *m_shards[size_t(key >> 60) % TILE_CACHE_SHARDS];
+}
+
+std::string HeightTileCache::path(const unsigned long long key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.tile", key);
+	return m_directory + name;
+}
+
+HeightTileCache::TileHandle HeightTileCache::find(const unsigned long long key)
+{
+	shard_t &s = shard(key);
+	{
+		std::lock_guard<std::mutex> lock(s.lock);
+		auto entry = s.entries.find(key);
+		if (entry != s.entries.end()) {
+			s.recent.splice(s.recent.begin(), s.recent, entry->second.recent);
+			++m_hits;
+			return entry->second.tile;
+		}
+	}
+
+	TileHandle tile = m_directory.empty() ? TileHandle() : load(key);
+	if (!tile) {
+		++m_misses;
+		return tile;
+	}
+	++m_diskHits;
+	return remember(key, tile);
+}
+
+void HeightTileCache::insert(const unsigned long long key, const TileHandle &tile)
+{
+	if (!tile || remember(key, tile) != tile)
+		return;
+	if (!m_directory.empty() && store(key, *tile))
+		++m_diskWrites;
+}
+
+HeightTileCache::TileHandle HeightTileCache::remember(const unsigned long long key, const TileHandle &tile)
+{
+	shard_t &s = shard(key);
+	std::lock_guard<std::mutex> lock(s.lock);
+	auto entry = s.entries.find(key);
+	if (entry != s.entries.end()) {
+		s.recent.splice(s.recent.begin(), s.recent, entry->second.recent);
+		return entry->second.tile;
+	}
+	s.recent.push_front(key);
+	shard_t::entry_t &added = s.entries[key];
+	added.tile = tile;
+	added.recent = s.recent.begin();
+	s.bytes += tile->samples.size();
+
+	// The newest tile stays even when it alone is over the bound
+	while (s.bytes > s.maxBytes && s.recent.size() > 1) {
+		auto evicted = s.entries.find(s.recent.back());
+		s.bytes -= evicted->second.tile->samples.size();
+		s.entries.erase(evicted);
+		s.recent.pop_back();
+		++m_evictions;
+	}
+	return tile;
+}
+
+HeightTileCache::TileHandle HeightTileCache::load(const unsigned long long key) const
+{
+	FILE *fp = fopen(path(key).c_str(), "rb");
+	if (!fp)
+		return TileHandle();
+
+	std::shared_ptr<tile_t> tile(new tile_t());
+	unsigned char version = 0;
+	char magic[3] = { 0, 0, 0 };
+	unsigned long long fileKey = 0, bytes = 0;
+	short format = 0;
+	int errors = fread(&version, sizeof(version), 1, fp) != 1;
+	if (!errors) errors += fread(magic, sizeof(magic), 1, fp) != 1;
+	if (!errors) errors += fread(&fileKey, sizeof(fileKey), 1, fp) != 1;
+	if (!errors) errors += fread(&tile->x, sizeof(tile->x), 1, fp) != 1;
+	if (!errors) errors += fread(&tile->y, sizeof(tile->y), 1, fp) != 1;
+	if (!errors) errors += fread(&tile->width, sizeof(tile->width), 1, fp) != 1;
+	if (!errors) errors += fread(&tile->height, sizeof(tile->height), 1, fp) != 1;
+	if (!errors) errors += fread(&format, sizeof(format), 1, fp) != 1;
+	if (!errors) errors += fread(&bytes, sizeof(bytes), 1, fp) != 1;
+	tile->format = (HeightGenerator::SampleFormat)format;
+	if (!errors && (version != TILE_CACHE_FILE_VERSION || memcmp(magic, TILE_CACHE_FILE_MAGIC, sizeof(magic)) ||
+		fileKey != key || tile->width <= 0 || tile->height <= 0 || !HeightGenerator::SampleFormatBytes(tile->format) ||
+		bytes != (unsigned long long)tile->width * (unsigned long long)tile->height * HeightGenerator::SampleFormatBytes(tile->format)))
+		errors++;
+	if (!errors) {
+		tile->samples.resize(size_t(bytes));
+		errors += fread(tile->samples.data(), tile->samples.size(), 1, fp) != 1;
+	}
+	fclose(fp);
+	return errors ? TileHandle() : tile;
+}
+
+bool HeightTileCache::store(const unsigned long long key, const tile_t &tile) const
+{
+	const std::string target = path(key);
+	FILE *fp = fopen(target.c_str(), "rb");
+	if (fp) {
+		// Written by an earlier run or another process
+		fclose(fp);
+		return false;
+	}
+
+	// Written under a name of its own and renamed, readers never see a partial tile
+	const unsigned long long unique = (unsigned long long)std::chrono::steady_clock::now().time_since_epoch().count() ^
+									  (unsigned long long)std::hash<std::thread::id>()(std::this_thread::get_id());
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%016llx.tmp", unique);
+	const std::string temporary = target + suffix;
+	fp = fopen(temporary.c_str(), "wb");
+	if (!fp)
+		return false;
+
+	const short format = (short)tile.format;
+	const unsigned long long bytes = tile.samples.size();
+	int errors = fwrite(&TILE_CACHE_FILE_VERSION, sizeof(TILE_CACHE_FILE_VERSION), 1, fp) != 1;
+	if (!errors) errors += fwrite(TILE_CACHE_FILE_MAGIC, sizeof(TILE_CACHE_FILE_MAGIC), 1, fp) != 1;
+	if (!errors) errors += fwrite(&key, sizeof(key), 1, fp) != 1;
+	if (!errors) errors += fwrite(&tile.x, sizeof(tile.x), 1, fp) != 1;
+	if (!errors) errors += fwrite(&tile.y, sizeof(tile.y), 1, fp) != 1;
+	if (!errors) errors += fwrite(&tile.width, sizeof(tile.width), 1, fp) != 1;
+	if (!errors) errors += fwrite(&tile.height, sizeof(tile.height), 1, fp) != 1;
+	if (!errors) errors += fwrite(&format, sizeof(format), 1, fp) != 1;
+	if (!errors) errors += fwrite(&bytes, sizeof(bytes), 1, fp) != 1;
+	if (!errors && bytes) errors += fwrite(tile.samples.data(), tile.samples.size(), 1, fp) != 1;
+	errors += fclose(fp) != 0;
+	if (errors || rename(temporary.c_str(), target.c_str()) != 0) {
+		remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+HeightTileCache::stats_t HeightTileCache::stats() const
+{
+	stats_t stats;
+	stats.hits = m_hits;
+	stats.diskHits = m_diskHits;
+	stats.misses = m_misses;
+	stats.evictions = m_evictions;
+	stats.diskWrites = m_diskWrites;
+	for (auto & shard : m_shards) {
+		std::lock_guard<std::mutex> lock(shard->lock);
+		stats.residentTiles += shard->recent.size();
+		stats.residentBytes += shard->bytes;
+	}
+	return stats;
+}
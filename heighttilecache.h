@@ -0,0 +1,113 @@
+/****************************************************************
+* Name:       heighttilecache.h
+* Purpose:    Byte bounded LRU cache of generated tiles with a disk level
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_TILE_CACHE_H
+#define HEIGHT_TILE_CACHE_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "heightgenerator.h"
+
+// Generated tiles keyed by a 64 bit hash of everything that decides their samples: the generator
+// algorithm version, the seed, the params that reach HeightGenerator::generateRegion() (the graph by
+// its nodes, not its address) and the pixel rectangle. The resolution is not part of the key, the same
+// rectangle of two map sizes is the same tile.
+//
+// The memory level is split into shards by key, each with its own lock, LRU list and share of the byte
+// bound, so lookups from many threads rarely meet. With a directory the cache also has a disk level:
+// every inserted tile is written once to <directory>/<key in hex>.tile, a memory miss looks there before
+// the caller generates. The files are named by content and never go stale, tiles are reused across runs
+// and processes. The disk level is not bounded, delete the files to trim it.
+//
+// Every call is safe from any thread, except configure() and clear() which must not overlap other calls
+class HeightTileCache
+{
+public:
+	typedef struct tile_t {
+		tile_t() : x(0), y(0), width(0), height(0), format(HeightGenerator::SampleFormatUInt16) {}
+		// Pixel of the top left sample in the map
+		int x;
+		int y;
+		// Pixels, tiles on the right and bottom edge of the map may be smaller
+		int width;
+		int height;
+		HeightGenerator::SampleFormat format;
+		// Row major samples, width apart
+		std::vector<unsigned char> samples;
+	}tile_t;
+	typedef std::shared_ptr<const tile_t> TileHandle;
+
+	typedef struct stats_t {
+		stats_t() : hits(0), diskHits(0), misses(0), evictions(0), diskWrites(0), residentTiles(0), residentBytes(0) {}
+		// Found in memory
+		unsigned long long hits;
+		// Found on disk after a memory miss, also loaded into memory
+		unsigned long long diskHits;
+		// Found nowhere, generated by the caller
+		unsigned long long misses;
+		// Dropped from memory to stay within the bound
+		unsigned long long evictions;
+		unsigned long long diskWrites;
+		size_t residentTiles;
+		size_t residentBytes;
+	}stats_t;
+
+	// 256 MB in memory, no disk level
+	HeightTileCache();
+	~HeightTileCache();
+
+	// maxBytes bounds the samples kept in memory. An empty directory keeps the cache in memory only,
+	// otherwise it has to exist. Drops the tiles in memory and resets the counters
+	bool configure(const size_t maxBytes, const std::string &directory = "");
+	// Drops the tiles in memory, the disk level is kept
+	void clear();
+
+	// Key of the samples generateRegion() writes for seed, params and the pixel rectangle. Key() of
+	// ParamsKey() equals the full form and saves hashing a graph per tile
+	static unsigned long long ParamsKey(const unsigned int seed, const HeightGenerator::height_map_param_t &params);
+	static unsigned long long Key(const unsigned long long paramsKey, const int x, const int y, const int width,
+								  const int height);
+	static unsigned long long Key(const unsigned int seed, const HeightGenerator::height_map_param_t &params,
+								  const int x, const int y, const int width, const int height);
+
+	// Tile of key from memory, then disk. Null on a miss
+	TileHandle find(const unsigned long long key);
+	// Adds a tile, and writes it to the disk level. A tile already cached under key is kept
+	void insert(const unsigned long long key, const TileHandle &tile);
+
+	stats_t stats() const;
+	inline const std::string &directory() const {
+		return m_directory;
+	}
+
+private:
+	struct shard_t;
+
+	shard_t &shard(const unsigned long long key) const;
+	std::string path(const unsigned long long key) const;
+	TileHandle load(const unsigned long long key) const;
+	bool store(const unsigned long long key, const tile_t &tile) const;
+	// Adds to the memory level, returns the tile cached under key
+	TileHandle remember(const unsigned long long key, const TileHandle &tile);
+
+	std::vector<std::unique_ptr<shard_t> > m_shards;
+	std::string m_directory;
+
+	std::atomic<unsigned long long> m_hits;
+	std::atomic<unsigned long long> m_diskHits;
+	std::atomic<unsigned long long> m_misses;
+	std::atomic<unsigned long long> m_evictions;
+	std::atomic<unsigned long long> m_diskWrites;
+};
+
+#endif
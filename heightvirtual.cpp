@@ -0,0 +1,235 @@
+/****************************************************************
+* Name:       heightvirtual.cpp
+* Purpose:    Virtual height map of lazily generated tiles
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+#include "heightvirtual.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+
+// Page table entries at most, 24 bytes each
+static const size_t VIRTUAL_MAX_PAGES = size_t(1) << 24;
+
+HeightVirtualMap::HeightVirtualMap() : m_seed(0), m_cache(nullptr), m_paramsKey(0), m_tileSize(0), m_tilesPerSide(0), m_maxResidentBytes(0),
+	m_residentBytes(0)
+{
+}
+
+bool HeightVirtualMap::configure(const unsigned int seed, const HeightGenerator::height_map_param_t &params,
+								 const int tileSize, const size_t maxResidentBytes, HeightTileCache *cache)
+{
+	clear();
+	if (params.resolution < 1 || tileSize < 1 || !HeightGenerator::SampleFormatBytes(params.sampleFormat))
+		return false;
+	const int tilesPerSide = (params.resolution - 1) / tileSize + 1;
+	if (size_t(tilesPerSide) * size_t(tilesPerSide) > VIRTUAL_MAX_PAGES)
+		return false;
+
+	HeightGenerator::height_map_param_t hmp = params;
+	if (hmp.graph) {
+		m_graph = *hmp.graph;
+		if (!m_graph.compile())
+			return false;
+		hmp.graph = &m_graph;
+	}
+	hmp.normalOutput = HeightGenerator::NormalOutputNone;
+	hmp.channels = nullptr;
+	hmp.channelCount = 0;
+	hmp.erosion = nullptr;
+
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_seed = seed;
+	m_params = hmp;
+	m_cache = cache;
+	m_paramsKey = HeightTileCache::ParamsKey(seed, hmp);
+	m_tileSize = tileSize;
+	m_tilesPerSide = tilesPerSide;
+	m_maxResidentBytes = maxResidentBytes;
+	m_pages.resize(size_t(tilesPerSide) * size_t(tilesPerSide));
+	return true;
+}
+
+void HeightVirtualMap::clear()
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_pages.clear();
+	m_recent.clear();
+	m_residentBytes = 0;
+	m_tilesPerSide = 0;
+	m_tileSize = 0;
+	m_params = HeightGenerator::height_map_param_t();
+	m_cache = nullptr;
+	m_graph = HeightGraph();
+}
+
+HeightVirtualMap::TileHandle HeightVirtualMap::generateTile(const int tx, const int ty) const
+{
+	std::shared_ptr<tile_t> tile(new tile_t());
+	tile->x = tx * m_tileSize;
+	tile->y = ty * m_tileSize;
+	tile->width = std::min(m_tileSize, m_params.resolution - tx * m_tileSize);
+	tile->height = std::min(m_tileSize, m_params.resolution - ty * m_tileSize);
+	tile->format = m_params.sampleFormat;
+	tile->samples.resize(size_t(tile->width) * size_t(tile->height) * HeightGenerator::SampleFormatBytes(m_params.sampleFormat));
+	HeightGenerator::generateRegion(m_seed, m_params, tx * m_tileSize, ty * m_tileSize, tile->width, tile->height,
+									tile->samples.data());
+	return tile;
+}
+
+void HeightVirtualMap::touch(const int page)
+{
+	m_recent.splice(m_recent.begin(), m_recent, m_pages[page].recent);
+}
+
+void HeightVirtualMap::evict()
+{
+	// The newest tile stays even when it alone is over the bound
+	while (m_residentBytes > m_maxResidentBytes && m_recent.size() > 1) {
+		page_t &page = m_pages[m_recent.back()];
+		m_residentBytes -= page.tile->samples.size();
+		page.tile.reset();
+		m_recent.pop_back();
+	}
+}
+
+HeightVirtualMap::TileHandle HeightVirtualMap::tile(const int tx, const int ty)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (tx < 0 || ty < 0 || tx >= m_tilesPerSide || ty >= m_tilesPerSide)
+			return TileHandle();
+		const int page = tx + ty * m_tilesPerSide;
+		if (m_pages[page].tile) {
+			touch(page);
+			return m_pages[page].tile;
+		}
+	}
+
+	// Threads missing the same tile both generate it, the first one in is kept
+	TileHandle generated;
+	if (m_cache) {
+		const int x = tx * m_tileSize, y = ty * m_tileSize;
+		const unsigned long long key = HeightTileCache::Key(m_paramsKey, x, y, std::min(m_tileSize, m_params.resolution - x),
+															std::min(m_tileSize, m_params.resolution - y));
+		generated = m_cache->find(key);
+		if (!generated) {
+			generated = generateTile(tx, ty);
+			m_cache->insert(key, generated);
+		}
+	}
+	else {
+		generated = generateTile(tx, ty);
+	}
+	std::lock_guard<std::mutex> lock(m_lock);
+	const int page = tx + ty * m_tilesPerSide;
+	if (m_pages[page].tile) {
+		touch(page);
+		return m_pages[page].tile;
+	}
+	m_pages[page].tile = generated;
+	m_recent.push_front(page);
+	m_pages[page].recent = m_recent.begin();
+	m_residentBytes += generated->samples.size();
+	evict();
+	return generated;
+}
+
+HeightVirtualMap::TileHandle HeightVirtualMap::residentTile(const int tx, const int ty) const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (tx < 0 || ty < 0 || tx >= m_tilesPerSide || ty >= m_tilesPerSide)
+		return TileHandle();
+	return m_pages[tx + ty * m_tilesPerSide].tile;
+}
+
+float HeightVirtualMap::height(const int x, const int y)
+{
+	if (x < 0 || y < 0 || x >= m_params.resolution || y >= m_params.resolution || !m_tileSize)
+		return 0.0f;
+	const TileHandle handle = tile(x / m_tileSize, y / m_tileSize);
+	if (!handle)
+		return 0.0f;
+	const size_t index = size_t(x - handle->x) + size_t(y - handle->y) * size_t(handle->width);
+	return HeightGenerator::SampleHeight(m_params.sampleFormat, handle->samples.data(), index);
+}
+
+bool HeightVirtualMap::region(const int x, const int y, const int width, const int height, void *samples)
+{
+	if (!samples || !m_tileSize || width <= 0 || height <= 0 || x < 0 || y < 0 ||
+		x > m_params.resolution - width || y > m_params.resolution - height)
+		return false;
+
+	const int bytes = HeightGenerator::SampleFormatBytes(m_params.sampleFormat);
+	unsigned char *out = static_cast<unsigned char *>(samples);
+	for (int ty = y / m_tileSize; ty <= (y + height - 1) / m_tileSize; ++ty) {
+		for (int tx = x / m_tileSize; tx <= (x + width - 1) / m_tileSize; ++tx) {
+			const TileHandle handle = tile(tx, ty);
+			if (!handle)
+				return false;
+			// Overlap of the tile and the rectangle in map pixels
+			const int x0 = std::max(x, tx * m_tileSize), x1 = std::min(x + width, tx * m_tileSize + handle->width);
+			const int y0 = std::max(y, ty * m_tileSize), y1 = std::min(y + height, ty * m_tileSize + handle->height);
+			for (int py = y0; py < y1; ++py) {
+				const size_t from = size_t(x0 - tx * m_tileSize) + size_t(py - ty * m_tileSize) * size_t(handle->width);
+				const size_t to = size_t(x0 - x) + size_t(py - y) * size_t(width);
+				memcpy(out + to * bytes, handle->samples.data() + from * bytes, size_t(x1 - x0) * bytes);
+			}
+		}
+	}
+	return true;
+}
+
+void HeightVirtualMap::prefetch(const int x, const int y, const int width, const int height, const int threadCount)
+{
+	if (!m_tileSize || width <= 0 || height <= 0)
+		return;
+	const int tx0 = std::max(x, 0) / m_tileSize, ty0 = std::max(y, 0) / m_tileSize;
+	const int tx1 = std::min(x + width - 1, m_params.resolution - 1) / m_tileSize;
+	const int ty1 = std::min(y + height - 1, m_params.resolution - 1) / m_tileSize;
+	if (tx1 < tx0 || ty1 < ty0)
+		return;
+
+	std::vector<int> missing;
+	for (int ty = ty0; ty <= ty1; ++ty) {
+		for (int tx = tx0; tx <= tx1; ++tx) {
+			if (!residentTile(tx, ty))
+				missing.push_back(tx + ty * m_tilesPerSide);
+		}
+	}
+
+	// Threads take the next missing tile
+	const int tilesPerSide = m_tilesPerSide;
+	std::atomic<int> next(0);
+	auto generate = [&]() {
+		for (int t = next++; t < (int)missing.size(); t = next++)
+			tile(missing[t] % tilesPerSide, missing[t] / tilesPerSide);
+	};
+	int threads = threadCount > 0 ? threadCount : (int)std::thread::hardware_concurrency();
+	threads = std::max(1, std::min(threads, (int)missing.size()));
+	std::vector<std::thread> pool;
+	for (int t = 1; t < threads; ++t)
+		pool.push_back(std::thread(generate));
+	generate();
+	for (auto & worker : pool)
+		worker.join();
+}
+
+size_t HeightVirtualMap::residentTiles() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_recent.size();
+}
+
+size_t HeightVirtualMap::residentBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_residentBytes;
+}
@@ -0,0 +1,104 @@
+/****************************************************************
+* Name:       heightvirtual.h
+* Purpose:    Virtual height map of lazily generated tiles
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+
+#ifndef HEIGHT_VIRTUAL_H
+#define HEIGHT_VIRTUAL_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "heightgenerator.h"
+#include "heightgraph.h"
+#include "heighttilecache.h"
+
+// A height map of any resolution (64k x 64k and up) that costs nothing until it is read. The map is
+// split into square tiles behind a page table, a tile is generated (HeightGenerator::generateRegion)
+// the first time it is touched. Resident tiles are bounded by bytes, the least recently used ones are
+// evicted and regenerated when touched again.
+//
+// Tiles are handed out as shared handles, a tile stays valid while a handle to it is held even after
+// it was evicted. Reads are safe from any thread and tiles generate outside the lock, configure() and
+// clear() must not overlap other calls
+class HeightVirtualMap
+{
+public:
+	typedef HeightTileCache::tile_t tile_t;
+	typedef HeightTileCache::TileHandle TileHandle;
+
+	HeightVirtualMap();
+
+	// params.resolution is the size of the whole map, a graph is copied. Erosion, normals and channels
+	// are not applied, see generateRegion(). tileSize is in pixels, maxResidentBytes bounds the samples of
+	// the tiles kept resident. A cache, not owned, is asked before a tile is generated and is given
+	// every generated tile, so maps with the same inputs share their tiles. Drops every tile
+	bool configure(const unsigned int seed, const HeightGenerator::height_map_param_t &params,
+				   const int tileSize = 256, const size_t maxResidentBytes = size_t(256) << 20,
+				   HeightTileCache *cache = nullptr);
+	void clear();
+
+	// Tile tx, ty, generated first if it is not resident. Null outside the map
+	TileHandle tile(const int tx, const int ty);
+	// Null unless resident, never generates
+	TileHandle residentTile(const int tx, const int ty) const;
+	// Height in 0 - 1 of pixel x, y, 0 outside the map
+	float height(const int x, const int y);
+	// Copies the width x height pixels from x, y to samples, row major in the sample format
+	bool region(const int x, const int y, const int width, const int height, void *samples);
+	// Generates the missing tiles under a pixel rectangle on up to threadCount threads, 0 uses every
+	// hardware thread. Tiles beyond the resident bound are evicted again
+	void prefetch(const int x, const int y, const int width, const int height, const int threadCount = 0);
+
+	inline int resolution() const {
+		return m_params.resolution;
+	}
+	inline int tileSize() const {
+		return m_tileSize;
+	}
+	inline int tilesPerSide() const {
+		return m_tilesPerSide;
+	}
+	inline HeightGenerator::SampleFormat sampleFormat() const {
+		return m_params.sampleFormat;
+	}
+	size_t residentTiles() const;
+	size_t residentBytes() const;
+
+private:
+	typedef struct page_t {
+		TileHandle tile;
+		// Position in m_recent while resident
+		std::list<int>::iterator recent;
+	}page_t;
+
+	TileHandle generateTile(const int tx, const int ty) const;
+	// Under m_lock
+	void touch(const int page);
+	void evict();
+
+	unsigned int m_seed;
+	HeightGenerator::height_map_param_t m_params;
+	// Compiled copy of the graph in m_params
+	HeightGraph m_graph;
+	HeightTileCache *m_cache;
+	unsigned long long m_paramsKey;
+	int m_tileSize;
+	int m_tilesPerSide;
+	size_t m_maxResidentBytes;
+
+	mutable std::mutex m_lock;
+	std::vector<page_t> m_pages;
+	// Resident pages, most recently used first
+	std::list<int> m_recent;
+	size_t m_residentBytes;
+};
+
+#endif
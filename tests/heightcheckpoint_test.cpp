@@ -0,0 +1,177 @@
+/****************************************************************
+* Name:       heightcheckpoint_test.cpp
+* Purpose:    Resume and journal failure tests of checkpointed generation
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer, POSIX (link)
+****************************************************************/
+
+// Build from the repository root with every library source except usage.cpp, GLM on the include path:
+// g++ -std=c++11 -O2 -I. tests/heightcheckpoint_test.cpp $(ls *.cpp | grep -v usage.cpp) -pthread
+
+#include "heightgenerator.h"
+#include "heightgraph.h"
+
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			++failures; \
+		} \
+	} while (0)
+
+static const char *JOURNAL_PATH = "heightcheckpoint_test.journal";
+static const char *KEPT_PATH = "heightcheckpoint_test.kept";
+static const int RESOLUTION = 256;
+static const int ROWS = 64;
+// Header of the journal: version, magic and key
+static const long JOURNAL_HEADER = 1 + 3 + 8;
+
+static std::vector<unsigned char> ReadFile(const char *path)
+{
+	std::vector<unsigned char> bytes;
+	FILE *fp = fopen(path, "rb");
+	if (!fp)
+		return bytes;
+	fseek(fp, 0, SEEK_END);
+	bytes.resize(size_t(ftell(fp)));
+	fseek(fp, 0, SEEK_SET);
+	if (!bytes.empty() && fread(bytes.data(), bytes.size(), 1, fp) != 1)
+		bytes.clear();
+	fclose(fp);
+	return bytes;
+}
+
+static bool WriteFile(const char *path, const std::vector<unsigned char> &bytes)
+{
+	FILE *fp = fopen(path, "wb");
+	if (!fp)
+		return false;
+	const bool written = bytes.empty() || fwrite(bytes.data(), bytes.size(), 1, fp) == 1;
+	return fclose(fp) == 0 && written;
+}
+
+// The journal of a whole run. generate() removes the journal when it succeeds, a second name for the
+// file keeps its records
+static std::vector<unsigned char> FullJournal(const unsigned int seed, const HeightGenerator::height_map_param_t &params)
+{
+	remove(JOURNAL_PATH);
+	remove(KEPT_PATH);
+	std::vector<unsigned char> journal;
+	if (!WriteFile(JOURNAL_PATH, journal) || link(JOURNAL_PATH, KEPT_PATH) != 0)
+		return journal;
+	HeightGenerator generator;
+	generator.setCheckpoint(JOURNAL_PATH, ROWS);
+	if (generator.generate(seed, params) && access(JOURNAL_PATH, F_OK) != 0)
+		journal = ReadFile(KEPT_PATH);
+	remove(KEPT_PATH);
+	return journal;
+}
+
+static bool SameOutput(HeightGenerator &a, HeightGenerator &b, const HeightGenerator::height_map_param_t &params)
+{
+	const size_t pixels = size_t(params.resolution) * size_t(params.resolution);
+	const size_t bytes = HeightGenerator::SampleFormatBytes(params.sampleFormat);
+	// The tests only ask for 16 bit normals
+	const size_t normalBytes = params.normalOutput == HeightGenerator::NormalOutputNone ? 0 : 4;
+	bool same = a.generatedPixels() == b.generatedPixels() && !memcmp(a.generatedSamples(), b.generatedSamples(), pixels * bytes);
+	if (normalBytes)
+		same = same && !memcmp(a.generatedNormalData(), b.generatedNormalData(), pixels * normalBytes);
+	if (params.channelCount)
+		same = same && !memcmp(a.generatedChannels(), b.generatedChannels(), pixels * bytes * params.channelCount);
+	return same;
+}
+
+// Resumes from journal, checks the resumed rows and that the output equals a run without a journal
+static void CheckResume(const unsigned int seed, const HeightGenerator::height_map_param_t &params,
+						const std::vector<unsigned char> &journal, const int resumedRows)
+{
+	HeightGenerator plain, resumed;
+	CHECK(plain.generate(seed, params));
+	CHECK(WriteFile(JOURNAL_PATH, journal));
+	resumed.setCheckpoint(JOURNAL_PATH, ROWS);
+	CHECK(resumed.generate(seed, params));
+	CHECK(resumed.checkpointResumedRows() == resumedRows);
+	CHECK(!resumed.checkpointFailed());
+	CHECK(SameOutput(plain, resumed, params));
+	CHECK(access(JOURNAL_PATH, F_OK) != 0);
+}
+
+// A torn last record is generated again, a record whose samples do not match its checksum ends the
+// journal there, a journal of other inputs is ignored
+static void TestResume(const HeightGenerator::height_map_param_t &params)
+{
+	const int bands = RESOLUTION / ROWS;
+	const std::vector<unsigned char> journal = FullJournal(5, params);
+	CHECK(journal.size() > size_t(JOURNAL_HEADER));
+	if (journal.size() <= size_t(JOURNAL_HEADER))
+		return;
+	const size_t record = (journal.size() - JOURNAL_HEADER) / bands;
+	CHECK(journal.size() == JOURNAL_HEADER + record * bands);
+
+	std::vector<unsigned char> torn(journal.begin(), journal.end() - record / 2);
+	CheckResume(5, params, torn, (bands - 1) * ROWS);
+
+	std::vector<unsigned char> corrupt = journal;
+	corrupt[JOURNAL_HEADER + record + record / 2] ^= 0x10;
+	CheckResume(5, params, corrupt, ROWS);
+
+	CheckResume(6, params, journal, 0);
+}
+
+// A journal that can not be written is reported, the map is generated anyway
+static void TestUnwritable()
+{
+	const HeightGenerator::height_map_param_t params(RESOLUTION, 0.33f, 8, 0.004f);
+	HeightGenerator plain, journaled;
+	CHECK(plain.generate(5, params));
+	journaled.setCheckpoint("missing_directory/heightcheckpoint_test.journal", ROWS);
+	CHECK(journaled.generate(5, params));
+	CHECK(journaled.checkpointFailed());
+	CHECK(journaled.checkpointResumedRows() == 0);
+	CHECK(SameOutput(plain, journaled, params));
+
+	journaled.setCheckpoint(JOURNAL_PATH, ROWS);
+	CHECK(journaled.generate(5, params));
+	CHECK(!journaled.checkpointFailed());
+}
+
+int main()
+{
+	HeightGenerator::height_map_param_t params(RESOLUTION, 0.33f, 8, 0.004f);
+	TestResume(params);
+
+	// Normals and planar channels are journaled with the samples
+	HeightGraph moisture = HeightGraph::Terrain(0.3f, 0.1f);
+	const HeightGenerator::channel_param_t channels[2] = {
+		HeightGenerator::channel_param_t(&moisture, 7),
+		HeightGenerator::channel_param_t(nullptr, 3)
+	};
+	params.normalOutput = HeightGenerator::NormalOutputOctahedral16;
+	params.channels = channels;
+	params.channelCount = 2;
+	TestResume(params);
+
+	// Float samples with interleaved channels
+	params.normalOutput = HeightGenerator::NormalOutputNone;
+	params.sampleFormat = HeightGenerator::SampleFormatFloat32;
+	params.channelLayout = HeightGenerator::ChannelLayoutInterleaved;
+	TestResume(params);
+
+	TestUnwritable();
+	remove(JOURNAL_PATH);
+	if (failures) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("heightcheckpoint tests passed\n");
+	return 0;
+}
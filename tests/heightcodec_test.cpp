@@ -0,0 +1,148 @@
+/****************************************************************
+* Name:       heightcodec_test.cpp
+* Purpose:    Round trip and corrupt stream tests of HeightCodec
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer
+****************************************************************/
+
+// Build from the repository root with every library source except usage.cpp, GLM on the include path:
+// g++ -std=c++11 -O2 -I. tests/heightcodec_test.cpp $(ls *.cpp | grep -v usage.cpp) -pthread
+
+#include "heightcodec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			++failures; \
+		} \
+	} while (0)
+
+static const int RESOLUTION = 150;
+
+// Hills with a flat sea, covering both run kinds and strips of different heights
+static std::vector<unsigned short> TestMap()
+{
+	std::vector<unsigned short> map(RESOLUTION * RESOLUTION);
+	for (int y = 0; y < RESOLUTION; ++y) {
+		for (int x = 0; x < RESOLUTION; ++x) {
+			const float h = 0.5f + 0.3f * std::sin(x * 0.07f) * std::cos(y * 0.05f) + 0.2f * std::sin((x + y) * 0.31f);
+			map[x + y * RESOLUTION] = h < 0.35f ? 0 : (unsigned short)(std::min(h, 1.0f) * 65535.0f);
+		}
+	}
+	return map;
+}
+
+static void TestRoundTrip()
+{
+	const std::vector<unsigned short> map = TestMap();
+	for (const int maxError : { 0, 3, 4095 }) {
+		std::vector<unsigned char> encoded;
+		CHECK(HeightCodec::Encode(map.data(), HeightGenerator::SampleFormatUInt16, RESOLUTION, maxError, encoded));
+		std::vector<unsigned short> decoded(map.size());
+		CHECK(HeightCodec::Decode(encoded.data(), encoded.size(), RESOLUTION, HeightGenerator::SampleFormatUInt16,
+								  decoded.data()));
+		int worst = 0;
+		for (size_t i = 0; i < map.size(); ++i)
+			worst = std::max(worst, std::abs(int(map[i]) - int(decoded[i])));
+		CHECK(worst <= maxError);
+	}
+}
+
+// Least significant bit first, as the codec writes
+static void PutBits(std::vector<unsigned char> &out, int &bit, const uint32_t value, const int width)
+{
+	for (int i = 0; i < width; ++i, ++bit) {
+		if (size_t(bit / 8) >= out.size())
+			out.push_back(0);
+		if ((value >> i) & 1)
+			out[bit / 8] |= (unsigned char)(1 << (bit % 8));
+	}
+}
+
+// One strip whose residuals are all the largest raw escape, far outside any 16 bit height. Multiplied
+// by the largest step they need more than 32 bits
+static void TestOversizedResiduals()
+{
+	const int resolution = 64;
+	std::vector<unsigned char> payload;
+	int bit = 0;
+	for (int run = 0; run < resolution * resolution / 64; ++run) {
+		PutBits(payload, bit, 0, 4);
+		for (int i = 0; i < 64; ++i) {
+			PutBits(payload, bit, 0, 24);
+			PutBits(payload, bit, 0xfffff, 20);
+		}
+	}
+	const uint32_t header[3] = { 4095, 1, uint32_t(payload.size()) };
+	std::vector<unsigned char> stream(sizeof(header));
+	memcpy(stream.data(), header, sizeof(header));
+	stream.insert(stream.end(), payload.begin(), payload.end());
+
+	std::vector<unsigned short> decoded(resolution * resolution);
+	CHECK(!HeightCodec::Decode(stream.data(), stream.size(), resolution, HeightGenerator::SampleFormatUInt16,
+							   decoded.data()));
+}
+
+static void TestTruncated()
+{
+	const std::vector<unsigned short> map = TestMap();
+	std::vector<unsigned char> encoded;
+	CHECK(HeightCodec::Encode(map.data(), HeightGenerator::SampleFormatUInt16, RESOLUTION, 0, encoded));
+	std::vector<unsigned short> decoded(map.size());
+	for (const size_t size : { size_t(0), size_t(4), size_t(12), encoded.size() / 2, encoded.size() - 1 })
+		CHECK(!HeightCodec::Decode(encoded.data(), size, RESOLUTION, HeightGenerator::SampleFormatUInt16, decoded.data()));
+}
+
+// Random bit flips in the payload either fail or decode to something, never crash or overflow (run under
+// -fsanitize=address,undefined to see the latter)
+static void TestBitFlips()
+{
+	const std::vector<unsigned short> map = TestMap();
+	std::vector<unsigned char> encoded;
+	CHECK(HeightCodec::Encode(map.data(), HeightGenerator::SampleFormatUInt16, RESOLUTION, 31, encoded));
+	const size_t payload = sizeof(uint32_t) * (2 + (RESOLUTION + 63) / 64);
+	std::mt19937 rng(7);
+	std::vector<float> decoded(map.size());
+	int rejected = 0;
+	for (int trial = 0; trial < 500; ++trial) {
+		std::vector<unsigned char> corrupt = encoded;
+		for (int flip = 0; flip < 8; ++flip)
+			corrupt[payload + rng() % (corrupt.size() - payload)] ^= (unsigned char)(1 << (rng() % 8));
+		if (!HeightCodec::Decode(corrupt.data(), corrupt.size(), RESOLUTION, HeightGenerator::SampleFormatFloat32,
+								 decoded.data())) {
+			++rejected;
+			continue;
+		}
+		for (const float h : decoded)
+			CHECK(h >= 0.0f && h <= 1.0f);
+	}
+	CHECK(rejected > 0);
+}
+
+int main()
+{
+	TestRoundTrip();
+	TestOversizedResiduals();
+	TestTruncated();
+	TestBitFlips();
+	if (failures) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("heightcodec tests passed\n");
+	return 0;
+}
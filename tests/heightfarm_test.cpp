@@ -0,0 +1,175 @@
+/****************************************************************
+* Name:       heightfarm_test.cpp
+* Purpose:    Worker loss, retry limit and timeout tests of HeightTileFarm
+* Author:     HeightmapGenerator contributors
+* Created:    2026 - October
+* Copyright:  Public Domain
+* Dependency: C++ 11 or newer, POSIX (fork, kill)
+****************************************************************/
+
+// Build from the repository root with every library source except usage.cpp, GLM on the include path:
+// g++ -std=c++11 -O2 -I. tests/heightfarm_test.cpp $(ls *.cpp | grep -v usage.cpp) -pthread
+
+#include "heightfarm.h"
+#include "heightgraph.h"
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			++failures; \
+		} \
+	} while (0)
+
+static const char *FARM_PATH = "heightfarm_test.htm";
+
+static pid_t StartWorker(const unsigned short port)
+{
+	const pid_t pid = fork();
+	if (!pid)
+		_exit(HeightTileFarm::Work("127.0.0.1", port) ? 0 : 1);
+	return pid;
+}
+
+// A worker that says hello as heightfarm.cpp does, takes a job and is killed before answering, so the
+// coordinator loses it while it holds a tile
+static pid_t StartDyingWorker(const unsigned short port)
+{
+	const pid_t pid = fork();
+	if (pid)
+		return pid;
+	const int socket = ::socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (socket < 0 || connect(socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+		_exit(1);
+	unsigned char hello[8 + 3 + 4];
+	const unsigned int header[2] = { 0, 3 + 4 }, version = 1;
+	memcpy(hello, header, sizeof(header));
+	memcpy(hello + 8, "HTF", 3);
+	memcpy(hello + 11, &version, sizeof(version));
+	unsigned int job[2];
+	if (send(socket, hello, sizeof(hello), 0) != (ssize_t)sizeof(hello) || recv(socket, job, sizeof(job), MSG_WAITALL) != (ssize_t)sizeof(job))
+		_exit(1);
+	kill(getpid(), SIGKILL);
+	_exit(1);
+}
+
+static bool Killed(const pid_t pid)
+{
+	int status = 0;
+	return waitpid(pid, &status, 0) == pid && WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL;
+}
+
+static bool Exited(const pid_t pid)
+{
+	int status = 0;
+	return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Three workers and one killed holding a tile. Every tile arrives once and equals generateRegion(),
+// edge tiles included
+static void TestLostWorker()
+{
+	HeightGraph graph = HeightGraph::Terrain(0.15f, 0.2f);
+	HeightGenerator::height_map_param_t params(300, 0.33f, 8, 0.006f);
+	params.graph = &graph;
+	const int tileSize = 128;
+
+	HeightTileFarm farm;
+	CHECK(farm.listen(0));
+	const pid_t dying = StartDyingWorker(farm.port());
+	bool ran = false;
+	std::thread coordinator([&]() { ran = farm.run(42, params, tileSize, FARM_PATH, 10, 4); });
+	// The others start once the first worker died with its tile
+	CHECK(Killed(dying));
+	std::vector<pid_t> workers;
+	for (int w = 0; w < 3; ++w)
+		workers.push_back(StartWorker(farm.port()));
+	coordinator.join();
+	for (const pid_t worker : workers)
+		CHECK(Exited(worker));
+
+	const HeightTileFarm::stats_t &stats = farm.stats();
+	CHECK(ran);
+	CHECK(stats.tiles == 9);
+	CHECK(stats.completed == 9);
+	CHECK(stats.workersConnected == 4);
+	CHECK(stats.workersLost == 1);
+	CHECK(stats.redispatched == 1);
+	CHECK(stats.dispatched == 10);
+
+	int resolution = 0, fileTileSize = 0;
+	HeightGenerator::SampleFormat format = HeightGenerator::SampleFormatFloat32;
+	CHECK(HeightTileFarm::ReadInfo(FARM_PATH, resolution, fileTileSize, format));
+	CHECK(resolution == 300 && fileTileSize == tileSize && format == HeightGenerator::SampleFormatUInt16);
+	for (int ty = 0; ty < 3; ++ty) {
+		for (int tx = 0; tx < 3; ++tx) {
+			HeightTileCache::tile_t tile;
+			CHECK(HeightTileFarm::ReadTile(FARM_PATH, tx, ty, tile));
+			std::vector<unsigned short> expected(size_t(tile.width) * size_t(tile.height));
+			CHECK(HeightGenerator::generateRegion(42, params, tile.x, tile.y, tile.width, tile.height, expected.data()));
+			CHECK(tile.samples.size() == expected.size() * sizeof(unsigned short) &&
+				  !memcmp(tile.samples.data(), expected.data(), tile.samples.size()));
+		}
+	}
+}
+
+// A tile may fail maxAttempts times, the first loss fails a run allowed one attempt
+static void TestMaxAttempts()
+{
+	const HeightGenerator::height_map_param_t params(256, 0.33f, 6, 0.006f);
+	HeightTileFarm farm;
+	CHECK(farm.listen(0));
+	const pid_t dying = StartDyingWorker(farm.port());
+	CHECK(!farm.run(7, params, 128, FARM_PATH, 10, 1));
+	CHECK(Killed(dying));
+	CHECK(farm.stats().workersLost == 1);
+	CHECK(farm.stats().completed == 0);
+	CHECK(farm.stats().redispatched == 0);
+}
+
+// Without any worker the run gives up after workerTimeout seconds
+static void TestNoWorker()
+{
+	const HeightGenerator::height_map_param_t params(256, 0.33f, 6, 0.006f);
+	HeightTileFarm farm;
+	CHECK(farm.listen(0));
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	CHECK(!farm.run(7, params, 128, FARM_PATH, 1));
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	CHECK(seconds >= 1.0 && seconds < 5.0);
+	CHECK(farm.stats().workersConnected == 0);
+	CHECK(farm.stats().dispatched == 0);
+}
+
+int main()
+{
+	TestLostWorker();
+	TestMaxAttempts();
+	TestNoWorker();
+	remove(FARM_PATH);
+	if (failures) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("heightfarm tests passed\n");
+	return 0;
+}
@@ -1,7 +1,10 @@
 void YourClass::LoadToGLTexture()
 {
     // Define in header: HeightGenerator m_hg;
-    m_hg.generate(HeightGenerator::GenSeed(), 1024, 0.36f, 14, 0.00055f, "", "height_sample.png");
+    // Float samples upload to GL_R32F as is
+    HeightGenerator::height_map_param_t params(1024, 0.36f, 14, 0.00055f);
+    params.sampleFormat = HeightGenerator::SampleFormatFloat32;
+    m_hg.generate(HeightGenerator::GenSeed(), params, "", "height_sample.png");
     
   
     
@@ -12,7 +15,7 @@ void YourClass::LoadToGLTexture()
     glBindTexture(GL_TEXTURE_2D, m_heightMap);
 
     glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0,
-        GL_LUMINANCE, GL_UNSIGNED_SHORT, m_hg.generatedData());
+        GL_RED, GL_FLOAT, m_hg.generatedSamples());
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -54,5 +57,229 @@ void Terrain::collision(const glm::vec3 &position)
 
 float Terrain::getHeightAt(const int x, const int y)
 {
-    return m_material.m_hg.generatedData()[(y * (int)m_terrainOption.heightMapResolution) + x] / 256.0f;
+    const float *heights = static_cast<const float *>(m_material.m_hg.generatedSamples());
+    return heights[(y * (int)m_terrainOption.heightMapResolution) + x] * 256.0f;
+}
+
+// Batched collision example, for many bodies per physics step:
+
+void Terrain::buildSampler()
+{
+    // Define in header: HeightSampler m_sampler;
+    m_sampler.build(m_material.m_hg);
+    m_sampler.setScale(m_terrainOption.resolutionScale, 256.0f * m_terrainOption.heightScale);
+}
+
+void Terrain::collision(const std::vector<glm::vec3> &positions, std::vector<float> &heights)
+{
+    // x, z pairs in world units
+    std::vector<float> queries(positions.size() * 2);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        queries[i * 2] = positions[i].x;
+        queries[i * 2 + 1] = positions[i].z;
+    }
+    heights.resize(positions.size());
+    m_sampler.sample(queries.data(), (int)positions.size(), heights.data());
+}
+
+// Biome example, height plus moisture and temperature in one pass:
+
+void Terrain::generateBiomeMaps(const unsigned int seed)
+{
+    // Define in header: HeightGraph m_moisture, m_temperature;
+    m_moisture.parse("base = fbm frequency=2 octaves=6\n"
+                     "out = remap base mul=0.5 add=0.5\n"
+                     "output out");
+    m_temperature.parse("base = iq frequency=0.5 octaves=4\n"
+                        "out = remap base mul=0.5 add=0.5\n"
+                        "output out");
+
+    // Moisture and temperature get their own seeds, RGBA8 style interleaving for the upload
+    HeightGenerator::channel_param_t channels[2] = {
+        HeightGenerator::channel_param_t(&m_moisture, 1),
+        HeightGenerator::channel_param_t(&m_temperature, 2)
+    };
+    HeightGenerator::height_map_param_t params(1024, 0.36f, 14, 0.00055f);
+    params.sampleFormat = HeightGenerator::SampleFormatUInt8;
+    params.channels = channels;
+    params.channelCount = 2;
+    params.channelLayout = HeightGenerator::ChannelLayoutInterleaved;
+    m_material.m_hg.generate(seed, params);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, 1024, 1024, 0,
+        GL_RG, GL_UNSIGNED_BYTE, m_material.m_hg.generatedChannels());
+}
+
+void Terrain::generateEroded(const unsigned int seed)
+{
+    // Define in header: HeightErosion m_erosion;
+    // Eroded on the float heights on every core, then stored as UInt16 with matching normals
+    HeightErosion::hydraulic_param_t hydraulic;
+    hydraulic.iterations = 300;
+    m_erosion.setHydraulic(hydraulic);
+    // Then scree below cliffs steeper than 60 degrees
+    HeightErosion::thermal_param_t thermal;
+    thermal.talus = 1.73f;
+    m_erosion.setThermal(thermal);
+
+    HeightGenerator::height_map_param_t params(4096, 0.36f, 14, 0.00055f / 4.0f);
+    params.normalOutput = HeightGenerator::NormalOutputOctahedral8;
+    params.erosion = &m_erosion;
+    m_material.m_hg.generate(seed, params);
+}
+
+void Terrain::placeRivers()
+{
+    // Define in header: HeightHydrology m_hydrology;
+    // Rivers where more than 2000 pixels drain through, lakes where the fill raised the ground
+    m_hydrology.build(m_material.m_hg);
+    const int resolution = m_hydrology.resolution();
+    for (int y = 0; y < resolution; ++y) {
+        for (int x = 0; x < resolution; ++x) {
+            if (m_hydrology.lakeDepth(x, y) > 0.0f)
+                addLake(x, y, m_hydrology.filledHeight(x, y));
+            else if (m_hydrology.accumulation(x, y) > 2000)
+                addRiver(x, y, m_hydrology.flowDirection(x, y));
+        }
+    }
+}
+
+void Terrain::placeSpawns()
+{
+    // Define in header: HeightDistance m_coast;
+    // Spawn points between 20 and 60 pixels inland
+    m_coast.build(m_material.m_hg);
+    const int resolution = m_coast.resolution();
+    for (int y = 0; y < resolution; y += 16) {
+        for (int x = 0; x < resolution; x += 16) {
+            const float distance = m_coast.distance(x, y);
+            if (distance >= 20.0f && distance <= 60.0f)
+                addSpawn(x, y);
+        }
+    }
+}
+
+void Terrain::bakeLightmaps()
+{
+    // Define in header: HeightShade m_shade;
+    // 16 bit hillshade and ambient occlusion for the minimap and the terrain shader
+    HeightShade::shade_param_t params;
+    params.sunAzimuth = 300.0f;
+    params.occlusionDirections = 32;
+    params.format = HeightGenerator::SampleFormatUInt16;
+    if (m_shade.build(m_material.m_hg, params))
+        m_material.setLightmaps(m_shade.hillshade(), m_shade.ambientOcclusion(), m_shade.resolution());
+}
+
+void Terrain::exportMesh()
+{
+    // Define in header: HeightMesh m_mesh;
+    // Render mesh within half a 16 bit step per 64 steps, 0.001 of the height range
+    if (!m_mesh.build(m_material.m_hg))
+        return;
+    HeightMesh::mesh_t mesh;
+    m_mesh.extract(0.001f, mesh);
+    m_renderer.uploadTerrain(mesh.positions.data(), mesh.vertexCount(), mesh.indices.data(), mesh.indices.size());
+    // Or straight to disk for the asset pipeline
+    m_mesh.extract(0.001f, "terrain.mesh");
+}
+
+void Terrain::bakeChunks()
+{
+    // Define in header: HeightChunks m_chunks;
+    // 64 cell chunks with 4 LODs, baked once; the streaming thread only uploads blobs
+    HeightChunks::chunk_param_t params;
+    params.skirtDepth = 4.0f / 256.0f;
+    if (!m_chunks.build(m_material.m_hg, params))
+        return;
+    for (int y = 0; y < m_chunks.chunksPerSide(); ++y) {
+        for (int x = 0; x < m_chunks.chunksPerSide(); ++x) {
+            const std::vector<unsigned char> &blob = m_chunks.blob(x, y);
+            HeightChunks::lod_view_t lod;
+            // Coarsest LOD first, finer ones when the camera gets close
+            if (HeightChunks::ReadLod(blob.data(), blob.size(), params.lodCount - 1, lod))
+                m_renderer.uploadChunk(x, y, lod.positions, lod.vertexCount, lod.indices, lod.indexCount);
+        }
+    }
+}
+
+void YourClass::LoadCompressedToGLTexture()
+{
+    // BC4 heights (RGTC1) and BC5 octahedral normals (RGTC2), a quarter of the 16 bit upload
+    HeightGenerator::height_map_param_t params(1024, 0.36f, 14, 0.00055f);
+    params.normalOutput = HeightGenerator::NormalOutputOctahedral8;
+    params.blockCompression = true;
+    m_hg.generate(HeightGenerator::GenSeed(), params);
+
+    const int resolution = m_hg.generatedParam().resolution;
+    glBindTexture(GL_TEXTURE_2D, m_heightMap);
+    glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RED_RGTC1, resolution, resolution, 0,
+        (GLsizei)HeightBlockCompression::BC4Bytes(resolution), m_hg.generatedHeightBC4());
+    glBindTexture(GL_TEXTURE_2D, m_normalMap);
+    glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RG_RGTC2, resolution, resolution, 0,
+        (GLsizei)HeightBlockCompression::BC5Bytes(resolution), m_hg.generatedNormalBC5());
+}
+
+void Server::sendTerrain(Client &client)
+{
+    // Heights within 8 16 bit steps (0.012% of the range), about 11x smaller than the raw samples
+    m_hg.saveGeneratedData("terrain_stream.hdf", 8);
+    client.sendFile("terrain_stream.hdf");
+    // Client side: loadGeneratedData() detects and decodes the encoding
+}
+
+void World::streamTerrain(const Camera &camera)
+{
+    // A 64k x 64k world, only the tiles read are generated, at most 256 MB stay resident
+    if (!m_world.resolution()) {
+        HeightGenerator::height_map_param_t params(65536, 0.36f, 14, 0.00055f / 64.0f);
+        m_world.configure(m_seed, params, 256);
+    }
+    // Warm the tiles around the camera on every core, then read them
+    m_world.prefetch(camera.x - 1024, camera.y - 1024, 2048, 2048);
+    const float ground = m_world.height(camera.x, camera.y);
+    HeightVirtualMap::TileHandle tile = m_world.tile(camera.x / 256, camera.y / 256);
+    uploadTile(tile->x, tile->y, tile->width, tile->height, tile->samples.data());
+}
+
+void Editor::openWorld(const HeightGenerator::height_map_param_t &params)
+{
+    // Tiles generated once are reused by every view of the same inputs, and by the next run from disk
+    static HeightTileCache cache;
+    static bool configured = cache.configure(size_t(512) << 20, "tile_cache");
+    m_view.configure(m_seed, params, 256, size_t(64) << 20, configured ? &cache : nullptr);
+
+    const HeightTileCache::stats_t stats = cache.stats();
+    log("tiles: %llu hits, %llu from disk, %llu generated, %llu evicted", stats.hits, stats.diskHits,
+        stats.misses, stats.evictions);
+}
+
+int main(int argc, char **argv)
+{
+    // farm --worker <coordinator host> <port>: generates tiles until the coordinator is done
+    if (argc == 4 && std::string(argv[1]) == "--worker")
+        return HeightTileFarm::Work(argv[2], (unsigned short)atoi(argv[3])) ? 0 : 1;
+
+    // farm: bakes a 32k map on every worker started against the printed port, here or on other hosts
+    HeightTileFarm farm;
+    if (!farm.listen(7300))
+        return 1;
+    printf("start workers with: farm --worker <this host> %d\n", farm.port());
+    HeightGenerator::height_map_param_t params(32768, 0.36f, 20, 0.00055f / 32.0f);
+    const bool baked = farm.run(1234, params, 512, "world.htm");
+    printf("%d tiles, %d redispatched after %d lost workers\n", farm.stats().tiles, farm.stats().redispatched,
+        farm.stats().workersLost);
+    return baked ? 0 : 1;
+}
+
+void YourClass::BakeLargeMap()
+{
+    // A crash or preemption loses at most the band of 256 rows being generated, rerunning the same
+    // call resumes from the journal
+    m_hg.setCheckpoint("large_map.journal", 256);
+    HeightGenerator::height_map_param_t params(32768, 0.36f, 20, 0.00055f / 32.0f);
+    m_hg.generate(1234, params, "large_map.hdf");
+    printf("%d rows resumed from the journal\n", m_hg.checkpointResumedRows());
+    if (m_hg.checkpointFailed())
+        printf("large_map.journal could not be written, a crash during this run would have started over\n");
 }